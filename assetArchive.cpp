@@ -0,0 +1,212 @@
+#include "assetArchive.hpp"
+#include "utilities.hpp"
+#include <stdexcept>
+#include <algorithm>
+#include <fstream>
+#include <cstring>
+
+#ifdef _WIN32
+    #define WIN32_LEAN_AND_MEAN
+    #define NOMINMAX
+    #include <windows.h>
+#else
+    #include <sys/mman.h>
+    #include <sys/stat.h>
+    #include <fcntl.h>
+    #include <unistd.h>
+#endif
+
+namespace {
+    uint64_t hashName(const std::string& name) {
+        return Utilities::hashBytes(name.data(), name.size());
+    }
+}
+
+AssetArchive::AssetArchive(const std::string& filename) {
+    #ifdef _WIN32
+        auto file = CreateFileA(filename.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_FLAG_RANDOM_ACCESS, nullptr);
+        if (file == INVALID_HANDLE_VALUE)
+            throw std::runtime_error("Failed to open " + filename + ".");
+
+        auto fileSize = LARGE_INTEGER{};
+        GetFileSizeEx(file, &fileSize);
+        size_ = static_cast<size_t>(fileSize.QuadPart);
+
+        // the mapping keeps the file open on its own
+        mapping_ = size_ > 0 ? CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr) : nullptr;
+        CloseHandle(file);
+        if (!mapping_)
+            throw std::runtime_error("Failed to map " + filename + ".");
+
+        data_ = static_cast<const uint8_t*>(MapViewOfFile(mapping_, FILE_MAP_READ, 0, 0, 0));
+        if (!data_) {
+            CloseHandle(mapping_);
+            throw std::runtime_error("Failed to map " + filename + ".");
+        }
+    #else
+        auto file = open(filename.c_str(), O_RDONLY);
+        if (file < 0)
+            throw std::runtime_error("Failed to open " + filename + ".");
+
+        struct stat status;
+        if (fstat(file, &status) != 0 || status.st_size == 0) {
+            close(file);
+            throw std::runtime_error("Failed to map " + filename + ".");
+        }
+        size_ = static_cast<size_t>(status.st_size);
+
+        // the mapping keeps the file open on its own
+        auto mapped = mmap(nullptr, size_, PROT_READ, MAP_PRIVATE, file, 0);
+        close(file);
+        if (mapped == MAP_FAILED)
+            throw std::runtime_error("Failed to map " + filename + ".");
+        data_ = static_cast<const uint8_t*>(mapped);
+    #endif
+
+    // everything the index points at is checked once here, so lookups and reads need no checks
+    auto header = AssetArchiveHeader{};
+    auto valid = size_ >= sizeof(header);
+    if (valid) {
+        memcpy(&header, data_, sizeof(header));
+        valid = header.magic == magic && header.version == version &&
+            header.indexOffset % alignof(AssetArchiveEntry) == 0 &&
+            header.indexOffset <= size_ && header.entryCount <= (size_ - header.indexOffset) / sizeof(AssetArchiveEntry) &&
+            header.namesOffset <= size_ && header.namesSize <= size_ - header.namesOffset;
+    }
+
+    if (valid) {
+        entries_ = reinterpret_cast<const AssetArchiveEntry*>(data_ + header.indexOffset);
+        entryCount_ = header.entryCount;
+        names_ = reinterpret_cast<const char*>(data_ + header.namesOffset);
+
+        for (uint32_t i = 0; i < entryCount_ && valid; i++) {
+            const auto& entry = entries_[i];
+            valid = entry.offset <= size_ && entry.size <= size_ - entry.offset &&
+                entry.nameOffset <= header.namesSize && entry.nameLength <= header.namesSize - entry.nameOffset &&
+                (entry.compression == AssetCompression::Lz4 || (entry.compression == AssetCompression::None && entry.size == entry.uncompressedSize));
+        }
+    }
+
+    if (!valid) {
+        unmap_();
+        throw std::runtime_error(filename + " is not an asset archive of version " + std::to_string(version) + ".");
+    }
+}
+
+AssetArchive::~AssetArchive() {
+    unmap_();
+}
+
+void AssetArchive::unmap_() {
+    #ifdef _WIN32
+        if (data_)
+            UnmapViewOfFile(data_);
+        if (mapping_)
+            CloseHandle(mapping_);
+    #else
+        if (data_)
+            munmap(const_cast<uint8_t*>(data_), size_);
+    #endif
+
+    data_ = nullptr;
+    mapping_ = nullptr;
+}
+
+const AssetArchiveEntry* AssetArchive::find(const std::string& name) const {
+    auto hash = hashName(name);
+    auto entry = std::lower_bound(entries_, entries_ + entryCount_, hash, [](const AssetArchiveEntry& entry, uint64_t hash) {
+        return entry.nameHash < hash;
+    });
+
+    // names sharing a hash sit next to each other
+    for (; entry != entries_ + entryCount_ && entry->nameHash == hash; entry++)
+        if (entry->nameLength == name.size() && memcmp(names_ + entry->nameOffset, name.data(), name.size()) == 0)
+            return entry;
+
+    return nullptr;
+}
+
+std::string AssetArchive::getName(const AssetArchiveEntry& entry) const {
+    return std::string(names_ + entry.nameOffset, entry.nameLength);
+}
+
+void AssetArchive::read(const AssetArchiveEntry& entry, void* destination) const {
+    if (entry.compression == AssetCompression::None) {
+        memcpy(destination, data_ + entry.offset, entry.size);
+        return;
+    }
+
+    if (!Utilities::lz4Decompress(data_ + entry.offset, entry.size, destination, entry.uncompressedSize))
+        throw std::runtime_error("Failed to decompress " + getName(entry) + ".");
+}
+
+void AssetArchive::write(const std::string& filename, const std::vector<PackedAsset>& assets) {
+    std::ofstream file(filename, std::ios::binary | std::ios::trunc);
+    if (!file.is_open())
+        throw std::runtime_error("Failed to open " + filename + " for writing.");
+
+    auto header = AssetArchiveHeader{};
+    header.magic = magic;
+    header.version = version;
+    header.entryCount = static_cast<uint32_t>(assets.size());
+    file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+
+    uint64_t offset = sizeof(header);
+    auto pad = [&](uint64_t alignment) {
+        static const char zeros[blobAlignment] = {};
+        auto padding = (alignment - offset % alignment) % alignment;
+        file.write(zeros, padding);
+        offset += padding;
+    };
+
+    std::vector<AssetArchiveEntry> entries;
+    std::string names;
+    for (const auto& asset : assets) {
+        pad(blobAlignment);
+
+        auto entry = AssetArchiveEntry{};
+        entry.nameHash = hashName(asset.name);
+        entry.nameOffset = static_cast<uint32_t>(names.size());
+        entry.nameLength = static_cast<uint32_t>(asset.name.size());
+        entry.type = asset.type;
+        entry.compression = AssetCompression::None;
+        entry.offset = offset;
+        entry.size = asset.data.size();
+        entry.uncompressedSize = asset.data.size();
+        names += asset.name;
+
+        std::vector<uint8_t> compressed;
+        if (asset.compress) {
+            compressed = Utilities::lz4Compress(asset.data.data(), asset.data.size());
+            if (compressed.size() <= asset.data.size() - asset.data.size() / 8) {
+                entry.compression = AssetCompression::Lz4;
+                entry.size = compressed.size();
+            }
+        }
+
+        auto bytes = entry.compression == AssetCompression::Lz4 ? compressed.data() : asset.data.data();
+        file.write(reinterpret_cast<const char*>(bytes), entry.size);
+        offset += entry.size;
+        entries.push_back(entry);
+    }
+
+    // stable, so equal hashes keep the packing order and lookups stay deterministic
+    std::stable_sort(entries.begin(), entries.end(), [](const AssetArchiveEntry& a, const AssetArchiveEntry& b) {
+        return a.nameHash < b.nameHash;
+    });
+
+    pad(alignof(AssetArchiveEntry));
+    header.indexOffset = offset;
+    file.write(reinterpret_cast<const char*>(entries.data()), entries.size() * sizeof(AssetArchiveEntry));
+    offset += entries.size() * sizeof(AssetArchiveEntry);
+
+    header.namesOffset = offset;
+    header.namesSize = names.size();
+    file.write(names.data(), names.size());
+
+    file.seekp(0);
+    file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+
+    if (!file)
+        throw std::runtime_error("Failed to write " + filename + ".");
+}
\ No newline at end of file
@@ -0,0 +1,90 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <cstdint>
+
+enum class AssetType : uint32_t {
+    Raw,
+    Shader,
+    Mesh,
+    Texture,
+};
+
+enum class AssetCompression : uint32_t {
+    None,
+    Lz4,
+};
+
+// on disk: the header, the blobs each aligned to blobAlignment, then the index sorted by name hash and the names
+struct AssetArchiveHeader {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t entryCount;
+    uint32_t padding;
+    uint64_t indexOffset;
+    uint64_t namesOffset;
+    uint64_t namesSize;
+};
+
+struct AssetArchiveEntry {
+    uint64_t nameHash;
+    uint32_t nameOffset;
+    uint32_t nameLength;
+    AssetType type;
+    AssetCompression compression;
+    uint64_t offset;
+    uint64_t size;
+    uint64_t uncompressedSize;
+};
+
+struct PackedAsset {
+    // forward slashes, relative to the working directory the engine runs from, such as shaders/shader.vert
+    std::string name;
+    AssetType type;
+    std::vector<uint8_t> data;
+    // stored LZ4 compressed when that saves at least an eighth, uncompressed assets are read in place
+    bool compress = false;
+};
+
+// one file holding every asset, mapped whole so reading an asset is a few page faults rather than an
+// open, read and close; uncompressed blobs are used straight from the mapping, aligned for any upload
+class AssetArchive {
+public:
+
+    static constexpr uint32_t magic = 0x4B415056; // "VPAK"
+    static constexpr uint32_t version = 1;
+    static constexpr uint64_t blobAlignment = 64;
+
+    // throws if the file cannot be mapped or is not an archive of this version
+    AssetArchive(const std::string& filename);
+    ~AssetArchive();
+
+    AssetArchive(const AssetArchive&) = delete;
+    AssetArchive& operator=(const AssetArchive&) = delete;
+
+    // null when the archive has no such asset
+    const AssetArchiveEntry* find(const std::string& name) const;
+    std::string getName(const AssetArchiveEntry& entry) const;
+    uint32_t size() const { return entryCount_; }
+
+    // the stored bytes in place, still compressed if the asset is, valid as long as the archive
+    const uint8_t* data(const AssetArchiveEntry& entry) const { return data_ + entry.offset; }
+    // writes the uncompressed asset to destination, such as a mapped staging buffer, with no copy in between
+    void read(const AssetArchiveEntry& entry, void* destination) const;
+
+    static void write(const std::string& filename, const std::vector<PackedAsset>& assets);
+
+private:
+
+    const uint8_t* data_ = nullptr;
+    size_t size_ = 0;
+    // the file mapping object on windows, unused elsewhere
+    void* mapping_ = nullptr;
+
+    const AssetArchiveEntry* entries_ = nullptr;
+    uint32_t entryCount_ = 0;
+    const char* names_ = nullptr;
+
+    void unmap_();
+};
\ No newline at end of file
@@ -0,0 +1,135 @@
+#include "benchmark.hpp"
+#include <algorithm>
+#include <fstream>
+#include <iostream>
+#include <iomanip>
+#include <cmath>
+
+namespace {
+    struct Stage {
+        const char* name;
+        double FrameTimings::* member;
+    };
+
+    const Stage stages[] = {
+        {"pacingSleep", &FrameTimings::pacingSleep},
+        {"fenceWait", &FrameTimings::fenceWait},
+        {"acquire", &FrameTimings::acquire},
+        {"record", &FrameTimings::record},
+        {"submit", &FrameTimings::submit},
+        {"present", &FrameTimings::present},
+        {"total", &FrameTimings::total},
+        {"latency", &FrameTimings::latency},
+    };
+}
+
+FrameBenchmark::FrameBenchmark(uint32_t warmupFrames, uint32_t measuredFrames)
+    : warmupFrames_(warmupFrames), measuredFrames_(measuredFrames) {
+    frames_.reserve(measuredFrames);
+}
+
+void FrameBenchmark::addFrame(const FrameTimings& timings) {
+    if (seenFrames_++ < warmupFrames_ || isDone())
+        return;
+
+    frames_.push_back(timings);
+}
+
+bool FrameBenchmark::isDone() const {
+    return frames_.size() >= measuredFrames_;
+}
+
+double FrameBenchmark::elapsedMilliseconds(std::chrono::steady_clock::time_point start, std::chrono::steady_clock::time_point end) {
+    return std::chrono::duration<double, std::milli>(end - start).count();
+}
+
+FrameBenchmark::Summary FrameBenchmark::summarize_(double FrameTimings::* stage) const {
+    auto summary = Summary{};
+    if (frames_.empty())
+        return summary;
+
+    std::vector<double> values;
+    values.reserve(frames_.size());
+    for (const auto& frame : frames_)
+        values.push_back(frame.*stage);
+
+    std::sort(values.begin(), values.end());
+
+    // nearest-rank percentiles
+    auto percentile = [&](double p) {
+        auto rank = static_cast<size_t>(std::ceil(p / 100.0 * values.size()));
+        return values[std::clamp<size_t>(rank, 1, values.size()) - 1];
+    };
+
+    for (auto value : values)
+        summary.mean += value;
+    summary.mean /= values.size();
+    summary.p50 = percentile(50);
+    summary.p95 = percentile(95);
+    summary.p99 = percentile(99);
+    summary.max = values.back();
+
+    return summary;
+}
+
+void FrameBenchmark::printSummary() const {
+    std::cout << "Benchmark: " << frames_.size() << " frames after " << warmupFrames_ << " warm-up frames (ms)" << std::endl;
+    std::cout << std::left << std::setw(12) << "stage"
+        << std::right << std::setw(10) << "mean" << std::setw(10) << "p50" << std::setw(10) << "p95"
+        << std::setw(10) << "p99" << std::setw(10) << "max" << std::endl;
+
+    std::cout << std::fixed << std::setprecision(3);
+    for (const auto& stage : stages) {
+        auto summary = summarize_(stage.member);
+        std::cout << std::left << std::setw(12) << stage.name
+            << std::right << std::setw(10) << summary.mean << std::setw(10) << summary.p50 << std::setw(10) << summary.p95
+            << std::setw(10) << summary.p99 << std::setw(10) << summary.max << std::endl;
+    }
+    std::cout.unsetf(std::ios::floatfield);
+}
+
+void FrameBenchmark::writeCsv(const std::string& filename) const {
+    std::ofstream file(filename);
+    if (!file.is_open())
+        throw std::runtime_error("Failed to open " + filename + " for writing.");
+
+    file << "frame";
+    for (const auto& stage : stages)
+        file << "," << stage.name;
+    file << "\n";
+
+    file << std::fixed << std::setprecision(6);
+    for (size_t i = 0; i < frames_.size(); i++) {
+        file << i;
+        for (const auto& stage : stages)
+            file << "," << frames_[i].*stage.member;
+        file << "\n";
+    }
+}
+
+void FrameBenchmark::writeJson(const std::string& filename) const {
+    std::ofstream file(filename);
+    if (!file.is_open())
+        throw std::runtime_error("Failed to open " + filename + " for writing.");
+
+    file << std::fixed << std::setprecision(6);
+    file << "{\n";
+    file << "  \"warmupFrames\": " << warmupFrames_ << ",\n";
+    file << "  \"frames\": " << frames_.size() << ",\n";
+    file << "  \"unit\": \"ms\",\n";
+    file << "  \"stages\": {\n";
+
+    for (size_t i = 0; i < std::size(stages); i++) {
+        auto summary = summarize_(stages[i].member);
+        file << "    \"" << stages[i].name << "\": { "
+            << "\"mean\": " << summary.mean << ", "
+            << "\"p50\": " << summary.p50 << ", "
+            << "\"p95\": " << summary.p95 << ", "
+            << "\"p99\": " << summary.p99 << ", "
+            << "\"max\": " << summary.max << " }"
+            << (i + 1 < std::size(stages) ? ",\n" : "\n");
+    }
+
+    file << "  }\n";
+    file << "}\n";
+}
\ No newline at end of file
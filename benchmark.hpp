@@ -0,0 +1,53 @@
+#pragma once
+
+#include <vector>
+#include <string>
+#include <chrono>
+#include <cstdint>
+
+// CPU time in milliseconds spent in each stage of GraphicsEngine::drawFrame
+struct FrameTimings {
+    // spent by the frame pacer before the frame sampled its input, not part of total
+    double pacingSleep = 0;
+    double fenceWait = 0;
+    double acquire = 0;
+    double record = 0;
+    double submit = 0;
+    double present = 0;
+    double total = 0;
+    // input sample to gpu completion of the newest finished frame, which lags the measured one
+    double latency = 0;
+};
+
+class FrameBenchmark {
+public:
+
+    FrameBenchmark(uint32_t warmupFrames, uint32_t measuredFrames);
+
+    // warm-up frames are counted but not kept
+    void addFrame(const FrameTimings& timings);
+    bool isDone() const;
+
+    void printSummary() const;
+    void writeCsv(const std::string& filename) const;
+    void writeJson(const std::string& filename) const;
+
+    static double elapsedMilliseconds(std::chrono::steady_clock::time_point start, std::chrono::steady_clock::time_point end);
+
+private:
+
+    struct Summary {
+        double mean = 0;
+        double p50 = 0;
+        double p95 = 0;
+        double p99 = 0;
+        double max = 0;
+    };
+
+    uint32_t warmupFrames_;
+    uint32_t measuredFrames_;
+    uint32_t seenFrames_ = 0;
+    std::vector<FrameTimings> frames_;
+
+    Summary summarize_(double FrameTimings::* stage) const;
+};
\ No newline at end of file
@@ -0,0 +1,270 @@
+#include "bindlessDescriptors.hpp"
+#include <stdexcept>
+#include <string>
+
+FrameDescriptorAllocator::FrameDescriptorAllocator(VkDevice device, uint32_t framesInFlight, std::vector<VkDescriptorPoolSize> poolSizes, uint32_t setsPerPool)
+    : device_(device), poolSizes_(std::move(poolSizes)), setsPerPool_(setsPerPool), frames_(framesInFlight) {}
+
+FrameDescriptorAllocator::~FrameDescriptorAllocator() {
+    for (auto& frame : frames_)
+        for (auto pool : frame.pools)
+            vkDestroyDescriptorPool(device_, pool, nullptr);
+}
+
+void FrameDescriptorAllocator::reset(uint32_t frame) {
+    auto& pools = frames_[frame];
+    for (size_t i = 0; i < pools.pools.size() && i <= pools.current; i++)
+        vkResetDescriptorPool(device_, pools.pools[i], 0);
+
+    pools.current = 0;
+}
+
+VkDescriptorSet FrameDescriptorAllocator::allocate(uint32_t frame, VkDescriptorSetLayout layout) {
+    auto& pools = frames_[frame];
+
+    while (true) {
+        auto freshPool = pools.current == pools.pools.size();
+        if (freshPool)
+            pools.pools.push_back(createPool_());
+
+        auto allocateInfo = VkDescriptorSetAllocateInfo{};
+        allocateInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+        allocateInfo.descriptorPool = pools.pools[pools.current];
+        allocateInfo.descriptorSetCount = 1;
+        allocateInfo.pSetLayouts = &layout;
+
+        VkDescriptorSet set;
+        auto result = vkAllocateDescriptorSets(device_, &allocateInfo, &set);
+        if (result == VK_SUCCESS)
+            return set;
+
+        // a pool that is full moves on to the next one, one that cannot even hold a single set never will
+        if (freshPool || (result != VK_ERROR_OUT_OF_POOL_MEMORY && result != VK_ERROR_FRAGMENTED_POOL))
+            throw std::runtime_error("Failed to allocate frame descriptor set.");
+
+        pools.current++;
+    }
+}
+
+VkDescriptorPool FrameDescriptorAllocator::createPool_() {
+    auto descriptorPoolInfo = VkDescriptorPoolCreateInfo{};
+    descriptorPoolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+    descriptorPoolInfo.maxSets = setsPerPool_;
+    descriptorPoolInfo.poolSizeCount = static_cast<uint32_t>(poolSizes_.size());
+    descriptorPoolInfo.pPoolSizes = poolSizes_.data();
+
+    VkDescriptorPool pool;
+    if (vkCreateDescriptorPool(device_, &descriptorPoolInfo, nullptr, &pool) != VK_SUCCESS)
+        throw std::runtime_error("Failed to create frame descriptor pool.");
+
+    return pool;
+}
+
+BindlessDescriptors::BindlessDescriptors(VkDevice device, bool descriptorIndexing, uint32_t textureCapacity, uint32_t bufferCapacity, uint32_t framesInFlight, Retire retire)
+    : device_(device), descriptorIndexing_(descriptorIndexing), textureCapacity_(textureCapacity), bufferCapacity_(bufferCapacity), retire_(std::move(retire)) {
+    VkDescriptorSetLayoutBinding bindings[2] = {};
+    bindings[0].binding = textureBinding;
+    bindings[0].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+    bindings[0].descriptorCount = textureCapacity_;
+    bindings[0].stageFlags = VK_SHADER_STAGE_ALL_GRAPHICS | VK_SHADER_STAGE_COMPUTE_BIT;
+
+    bindings[1].binding = bufferBinding;
+    bindings[1].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+    bindings[1].descriptorCount = bufferCapacity_;
+    bindings[1].stageFlags = VK_SHADER_STAGE_ALL_GRAPHICS | VK_SHADER_STAGE_COMPUTE_BIT;
+
+    // entries no frame uses may be missing, or rewritten while frames using others are in flight
+    const VkDescriptorBindingFlags bindingFlags[2] = {
+        VK_DESCRIPTOR_BINDING_PARTIALLY_BOUND_BIT | VK_DESCRIPTOR_BINDING_UPDATE_AFTER_BIND_BIT | VK_DESCRIPTOR_BINDING_UPDATE_UNUSED_WHILE_PENDING_BIT,
+        VK_DESCRIPTOR_BINDING_PARTIALLY_BOUND_BIT | VK_DESCRIPTOR_BINDING_UPDATE_AFTER_BIND_BIT | VK_DESCRIPTOR_BINDING_UPDATE_UNUSED_WHILE_PENDING_BIT,
+    };
+
+    auto bindingFlagsInfo = VkDescriptorSetLayoutBindingFlagsCreateInfo{};
+    bindingFlagsInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_BINDING_FLAGS_CREATE_INFO;
+    bindingFlagsInfo.bindingCount = 2;
+    bindingFlagsInfo.pBindingFlags = bindingFlags;
+
+    auto layoutInfo = VkDescriptorSetLayoutCreateInfo{};
+    layoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+    layoutInfo.bindingCount = 2;
+    layoutInfo.pBindings = bindings;
+    if (descriptorIndexing_) {
+        layoutInfo.pNext = &bindingFlagsInfo;
+        layoutInfo.flags = VK_DESCRIPTOR_SET_LAYOUT_CREATE_UPDATE_AFTER_BIND_POOL_BIT;
+    }
+
+    if (vkCreateDescriptorSetLayout(device_, &layoutInfo, nullptr, &layout_) != VK_SUCCESS)
+        throw std::runtime_error("Failed to create bindless descriptor set layout.");
+
+    std::vector<VkDescriptorPoolSize> poolSizes = {
+        {VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, textureCapacity_},
+        {VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, bufferCapacity_},
+    };
+
+    if (!descriptorIndexing_) {
+        // a set per frame and a few spare, the chain grows past that only if something else allocates from it
+        const uint32_t setsPerPool = 4;
+        for (auto& poolSize : poolSizes)
+            poolSize.descriptorCount *= setsPerPool;
+
+        frameAllocator_ = std::make_unique<FrameDescriptorAllocator>(device_, framesInFlight, poolSizes, setsPerPool);
+        return;
+    }
+
+    auto descriptorPoolInfo = VkDescriptorPoolCreateInfo{};
+    descriptorPoolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+    descriptorPoolInfo.flags = VK_DESCRIPTOR_POOL_CREATE_UPDATE_AFTER_BIND_BIT;
+    descriptorPoolInfo.maxSets = 1;
+    descriptorPoolInfo.poolSizeCount = static_cast<uint32_t>(poolSizes.size());
+    descriptorPoolInfo.pPoolSizes = poolSizes.data();
+
+    if (vkCreateDescriptorPool(device_, &descriptorPoolInfo, nullptr, &pool_) != VK_SUCCESS)
+        throw std::runtime_error("Failed to create bindless descriptor pool.");
+
+    auto allocateInfo = VkDescriptorSetAllocateInfo{};
+    allocateInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+    allocateInfo.descriptorPool = pool_;
+    allocateInfo.descriptorSetCount = 1;
+    allocateInfo.pSetLayouts = &layout_;
+
+    if (vkAllocateDescriptorSets(device_, &allocateInfo, &set_) != VK_SUCCESS)
+        throw std::runtime_error("Failed to allocate bindless descriptor set.");
+}
+
+BindlessDescriptors::~BindlessDescriptors() {
+    frameAllocator_.reset();
+    if (pool_ != VK_NULL_HANDLE)
+        vkDestroyDescriptorPool(device_, pool_, nullptr);
+    vkDestroyDescriptorSetLayout(device_, layout_, nullptr);
+}
+
+uint32_t BindlessDescriptors::addTexture(VkImageView view, VkSampler sampler) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto index = claim_(freeTextures_, textures_.size(), textureCapacity_, "texture");
+    if (index == textures_.size())
+        textures_.emplace_back();
+    textures_[index] = {sampler, view, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL};
+
+    if (descriptorIndexing_) {
+        auto write = VkWriteDescriptorSet{};
+        write.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+        write.dstSet = set_;
+        write.dstBinding = textureBinding;
+        write.dstArrayElement = index;
+        write.descriptorCount = 1;
+        write.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+        write.pImageInfo = &textures_[index];
+        vkUpdateDescriptorSets(device_, 1, &write, 0, nullptr);
+    }
+
+    return index;
+}
+
+uint32_t BindlessDescriptors::addBuffer(VkBuffer buffer, VkDeviceSize offset, VkDeviceSize range) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto index = claim_(freeBuffers_, buffers_.size(), bufferCapacity_, "buffer");
+    if (index == buffers_.size())
+        buffers_.emplace_back();
+    buffers_[index] = {buffer, offset, range};
+
+    if (descriptorIndexing_) {
+        auto write = VkWriteDescriptorSet{};
+        write.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+        write.dstSet = set_;
+        write.dstBinding = bufferBinding;
+        write.dstArrayElement = index;
+        write.descriptorCount = 1;
+        write.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+        write.pBufferInfo = &buffers_[index];
+        vkUpdateDescriptorSets(device_, 1, &write, 0, nullptr);
+    }
+
+    return index;
+}
+
+void BindlessDescriptors::removeTexture(uint32_t index) {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        textures_[index] = {};
+    }
+
+    // the descriptor is left in place, partially bound sets do not mind stale entries nobody reads
+    retire_([this, index] {
+        std::lock_guard<std::mutex> lock(mutex_);
+        freeTextures_.push_back(index);
+    });
+}
+
+void BindlessDescriptors::removeBuffer(uint32_t index) {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        buffers_[index] = {};
+    }
+
+    retire_([this, index] {
+        std::lock_guard<std::mutex> lock(mutex_);
+        freeBuffers_.push_back(index);
+    });
+}
+
+VkDescriptorSet BindlessDescriptors::beginFrame(uint32_t frame) {
+    if (descriptorIndexing_)
+        return set_;
+
+    frameAllocator_->reset(frame);
+    auto set = frameAllocator_->allocate(frame, layout_);
+
+    // without partially bound descriptors every array element must be valid, holes repeat entry 0
+    std::lock_guard<std::mutex> lock(mutex_);
+    std::vector<VkDescriptorImageInfo> textures;
+    std::vector<VkDescriptorBufferInfo> buffers;
+    std::vector<VkWriteDescriptorSet> writes;
+
+    if (!textures_.empty() && textures_[0].imageView != VK_NULL_HANDLE) {
+        textures.resize(textureCapacity_, textures_[0]);
+        for (size_t i = 0; i < textures_.size(); i++)
+            if (textures_[i].imageView != VK_NULL_HANDLE)
+                textures[i] = textures_[i];
+
+        auto write = VkWriteDescriptorSet{};
+        write.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+        write.dstSet = set;
+        write.dstBinding = textureBinding;
+        write.descriptorCount = textureCapacity_;
+        write.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+        write.pImageInfo = textures.data();
+        writes.push_back(write);
+    }
+
+    if (!buffers_.empty() && buffers_[0].buffer != VK_NULL_HANDLE) {
+        buffers.resize(bufferCapacity_, buffers_[0]);
+        for (size_t i = 0; i < buffers_.size(); i++)
+            if (buffers_[i].buffer != VK_NULL_HANDLE)
+                buffers[i] = buffers_[i];
+
+        auto write = VkWriteDescriptorSet{};
+        write.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+        write.dstSet = set;
+        write.dstBinding = bufferBinding;
+        write.descriptorCount = bufferCapacity_;
+        write.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+        write.pBufferInfo = buffers.data();
+        writes.push_back(write);
+    }
+
+    vkUpdateDescriptorSets(device_, static_cast<uint32_t>(writes.size()), writes.data(), 0, nullptr);
+    return set;
+}
+
+uint32_t BindlessDescriptors::claim_(std::vector<uint32_t>& freeIndices, size_t used, uint32_t capacity, const char* kind) {
+    if (!freeIndices.empty()) {
+        auto index = freeIndices.back();
+        freeIndices.pop_back();
+        return index;
+    }
+
+    if (used >= capacity)
+        throw std::runtime_error(std::string("Failed to add bindless ") + kind + ", the table is full.");
+
+    return static_cast<uint32_t>(used);
+}
\ No newline at end of file
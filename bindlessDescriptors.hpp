@@ -0,0 +1,90 @@
+#pragma once
+
+#include <vector>
+#include <memory>
+#include <mutex>
+#include <functional>
+#include <vulkan/vulkan.h>
+
+// hands out descriptor sets that live for one frame from a chain of pools per frame in flight,
+// the pools of a frame slot are reset wholesale instead of freeing sets one by one
+class FrameDescriptorAllocator {
+public:
+
+    FrameDescriptorAllocator(VkDevice device, uint32_t framesInFlight, std::vector<VkDescriptorPoolSize> poolSizes, uint32_t setsPerPool);
+    ~FrameDescriptorAllocator();
+
+    // frees every set allocated for the frame slot, whose last submission must have finished
+    void reset(uint32_t frame);
+    // grows the frame slot's chain by another pool when the current one runs out
+    VkDescriptorSet allocate(uint32_t frame, VkDescriptorSetLayout layout);
+
+private:
+
+    struct FramePools {
+        std::vector<VkDescriptorPool> pools;
+        size_t current = 0;
+    };
+
+    VkDevice device_;
+    std::vector<VkDescriptorPoolSize> poolSizes_;
+    uint32_t setsPerPool_;
+    std::vector<FramePools> frames_;
+
+    VkDescriptorPool createPool_();
+};
+
+// every sampled texture and storage buffer in one descriptor set, which shaders index into with indices
+// passed through push constants, so draws never bind descriptors of their own. with descriptor indexing
+// the set is update-after-bind, written as entries come and go and bound as is every frame; without it
+// the table is written into a fresh set from the frame's pools each frame, holes reading entry 0 instead
+class BindlessDescriptors {
+public:
+
+    using Retire = std::function<void(std::function<void()>)>;
+
+    static const uint32_t textureBinding = 0;
+    static const uint32_t bufferBinding = 1;
+
+    // the capacities become the array sizes of the layout, and the shaders' through specialization constants 0 and 1
+    BindlessDescriptors(VkDevice device, bool descriptorIndexing, uint32_t textureCapacity, uint32_t bufferCapacity, uint32_t framesInFlight, Retire retire);
+    ~BindlessDescriptors();
+
+    // the view must be in shader read only layout whenever a frame may sample it; thread safe
+    uint32_t addTexture(VkImageView view, VkSampler sampler);
+    uint32_t addBuffer(VkBuffer buffer, VkDeviceSize offset = 0, VkDeviceSize range = VK_WHOLE_SIZE);
+    // the index is only handed out again once the frames in flight are done with it
+    void removeTexture(uint32_t index);
+    void removeBuffer(uint32_t index);
+
+    // returns the set the frame binds, the frame slot's last submission must have finished
+    VkDescriptorSet beginFrame(uint32_t frame);
+
+    VkDescriptorSetLayout getLayout() const { return layout_; }
+    uint32_t getTextureCapacity() const { return textureCapacity_; }
+    uint32_t getBufferCapacity() const { return bufferCapacity_; }
+    bool usesDescriptorIndexing() const { return descriptorIndexing_; }
+
+private:
+
+    VkDevice device_;
+    bool descriptorIndexing_;
+    uint32_t textureCapacity_;
+    uint32_t bufferCapacity_;
+    Retire retire_;
+
+    VkDescriptorSetLayout layout_;
+    // the one update-after-bind set, or the per-frame pools when there is no descriptor indexing
+    VkDescriptorPool pool_ = VK_NULL_HANDLE;
+    VkDescriptorSet set_ = VK_NULL_HANDLE;
+    std::unique_ptr<FrameDescriptorAllocator> frameAllocator_;
+
+    std::mutex mutex_;
+    // kept on the cpu for the fallback, a null view or buffer marks a hole
+    std::vector<VkDescriptorImageInfo> textures_;
+    std::vector<VkDescriptorBufferInfo> buffers_;
+    std::vector<uint32_t> freeTextures_;
+    std::vector<uint32_t> freeBuffers_;
+
+    uint32_t claim_(std::vector<uint32_t>& freeIndices, size_t used, uint32_t capacity, const char* kind);
+};
\ No newline at end of file
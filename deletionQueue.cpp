@@ -0,0 +1,40 @@
+#include "deletionQueue.hpp"
+#include <algorithm>
+
+DeletionQueue::~DeletionQueue() {
+    flush();
+}
+
+void DeletionQueue::push(uint64_t lastUsedFrame, std::function<void()> deleter) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    entries_.push_back({lastUsedFrame, std::move(deleter)});
+}
+
+void DeletionQueue::collect(uint64_t completedFrame) {
+    std::vector<Entry> ready;
+
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+
+        // stable, so objects retired together are destroyed in the order they were pushed
+        auto firstPending = std::stable_partition(entries_.begin(), entries_.end(), [completedFrame](const Entry& entry) {
+            return entry.lastUsedFrame <= completedFrame;
+        });
+
+        ready.assign(std::make_move_iterator(entries_.begin()), std::make_move_iterator(firstPending));
+        entries_.erase(entries_.begin(), firstPending);
+    }
+
+    // deleters run unlocked, so they may retire further objects themselves
+    for (auto& entry : ready)
+        entry.deleter();
+}
+
+void DeletionQueue::flush() {
+    collect(UINT64_MAX);
+}
+
+size_t DeletionQueue::size() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return entries_.size();
+}
\ No newline at end of file
@@ -0,0 +1,35 @@
+#pragma once
+
+#include <vector>
+#include <functional>
+#include <mutex>
+#include <cstdint>
+
+// defers destroying gpu objects until the frame that last used them has finished executing,
+// so nothing has to drain the device just to release a handle
+class DeletionQueue {
+public:
+
+    ~DeletionQueue();
+
+    // lastUsedFrame is the number of the newest frame that may still reference the object
+    void push(uint64_t lastUsedFrame, std::function<void()> deleter);
+
+    // runs every deleter whose frame is at or before completedFrame
+    void collect(uint64_t completedFrame);
+
+    // runs everything, the caller must make sure the device is idle
+    void flush();
+
+    size_t size();
+
+private:
+
+    struct Entry {
+        uint64_t lastUsedFrame;
+        std::function<void()> deleter;
+    };
+
+    std::mutex mutex_;
+    std::vector<Entry> entries_;
+};
\ No newline at end of file
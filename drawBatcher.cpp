@@ -0,0 +1,152 @@
+#include "drawBatcher.hpp"
+#include <algorithm>
+#include <cstring>
+
+DrawBatcher::DrawBatcher(FrameAllocator& frameAllocator, bool multiDrawIndirect, bool drawIndirectFirstInstance, uint32_t maxDrawIndirectCount)
+    : frameAllocator_(frameAllocator), multiDrawIndirect_(multiDrawIndirect), drawIndirectFirstInstance_(drawIndirectFirstInstance),
+      maxDrawIndirectCount_(std::max(maxDrawIndirectCount, 1u)) {}
+
+void DrawBatcher::begin() {
+    commandCount_ = 0;
+    instanceCount_ = 0;
+    drawMeshes_.clear();
+    drawInstances_.clear();
+    drawRanges_.clear();
+}
+
+void DrawBatcher::draw(MeshHandle mesh, const InstanceData& instance) {
+    drawMeshes_.push_back(mesh);
+    drawInstances_.push_back(instance);
+}
+
+void DrawBatcher::drawRange(MeshHandle mesh, uint32_t count, std::function<void(InstanceData*)> write) {
+    if (count > 0)
+        drawRanges_.push_back({mesh, count, std::move(write)});
+}
+
+void DrawBatcher::build(MeshPool& meshPool) {
+    const auto skipped = UINT32_MAX;
+
+    // counting sort by mesh, linear in the number of draws
+    meshInstanceCounts_.assign(meshPool.handleCount(), 0);
+    for (auto mesh : drawMeshes_)
+        if (mesh < meshInstanceCounts_.size())
+            meshInstanceCounts_[mesh]++;
+    for (const auto& range : drawRanges_)
+        if (range.mesh < meshInstanceCounts_.size())
+            meshInstanceCounts_[range.mesh] += range.count;
+
+    // draws of removed meshes are dropped here rather than handed to the gpu
+    uint32_t usedMeshes = 0;
+    instanceCount_ = 0;
+    meshes_.resize(meshInstanceCounts_.size());
+    for (MeshHandle mesh = 0; mesh < meshInstanceCounts_.size(); mesh++) {
+        if (meshInstanceCounts_[mesh] == 0)
+            continue;
+
+        meshes_[mesh] = meshPool.getMesh(mesh);
+        if (!meshes_[mesh].valid) {
+            meshInstanceCounts_[mesh] = 0;
+            continue;
+        }
+
+        usedMeshes++;
+        instanceCount_ += meshInstanceCounts_[mesh];
+    }
+
+    // one pointer bump each, storage aligned as the culling pass binds all three; never empty, as descriptors cannot be
+    commands_ = frameAllocator_.allocateStorage(std::max(usedMeshes, 1u) * sizeof(VkDrawIndexedIndirectCommand));
+    instances_ = frameAllocator_.allocateStorage(std::max(instanceCount_, 1u) * sizeof(InstanceData));
+    cullInstances_ = frameAllocator_.allocateStorage(std::max(instanceCount_, 1u) * sizeof(CullInstance));
+
+    auto commands = static_cast<VkDrawIndexedIndirectCommand*>(commands_.data);
+    auto instances = static_cast<InstanceData*>(instances_.data);
+    auto cullInstances = static_cast<CullInstance*>(cullInstances_.data);
+    firstInstances_.clear();
+
+    // turn the counts into each mesh's first instance, emitting one command per mesh drawn
+    uint32_t firstInstance = 0;
+    meshCommands_.assign(meshInstanceCounts_.size(), skipped);
+    for (MeshHandle mesh = 0; mesh < meshInstanceCounts_.size(); mesh++) {
+        auto count = meshInstanceCounts_[mesh];
+        if (count == 0)
+            continue;
+
+        meshCommands_[mesh] = commandCount_;
+        meshInstanceCounts_[mesh] = firstInstance;
+
+        auto& command = commands[commandCount_++];
+        command.indexCount = meshes_[mesh].indexCount;
+        command.instanceCount = count;
+        command.firstIndex = meshes_[mesh].firstIndex;
+        command.vertexOffset = meshes_[mesh].vertexOffset;
+        command.firstInstance = drawIndirectFirstInstance_ ? firstInstance : 0;
+        firstInstances_.push_back(firstInstance);
+
+        firstInstance += count;
+    }
+
+    // scattered straight into mapped memory, the instance data is copied exactly once
+    for (size_t i = 0; i < drawMeshes_.size(); i++) {
+        auto mesh = drawMeshes_[i];
+        if (mesh >= meshCommands_.size() || meshCommands_[mesh] == skipped)
+            continue;
+
+        auto slot = meshInstanceCounts_[mesh]++;
+        instances[slot] = drawInstances_[i];
+
+        auto& cullInstance = cullInstances[slot];
+        cullInstance.commandIndex = meshCommands_[mesh];
+        cullInstance.instanceBase = firstInstances_[meshCommands_[mesh]];
+        std::copy(std::begin(meshes_[mesh].boundingSphere), std::end(meshes_[mesh].boundingSphere), cullInstance.boundingSphere);
+    }
+
+    for (const auto& range : drawRanges_) {
+        if (range.mesh >= meshCommands_.size() || meshCommands_[range.mesh] == skipped)
+            continue;
+
+        auto first = meshInstanceCounts_[range.mesh];
+        meshInstanceCounts_[range.mesh] += range.count;
+        range.write(instances + first);
+
+        auto cullInstance = CullInstance{};
+        cullInstance.commandIndex = meshCommands_[range.mesh];
+        cullInstance.instanceBase = firstInstances_[meshCommands_[range.mesh]];
+        std::copy(std::begin(meshes_[range.mesh].boundingSphere), std::end(meshes_[range.mesh].boundingSphere), cullInstance.boundingSphere);
+        std::fill(cullInstances + first, cullInstances + first + range.count, cullInstance);
+    }
+}
+
+DrawBuffers DrawBatcher::getDrawBuffers() const {
+    return {commands_.buffer, instances_.buffer, commands_.offset, instances_.offset};
+}
+
+void DrawBatcher::record(VkCommandBuffer commandBuffer, MeshPool& meshPool, DrawBuffers drawBuffers, uint32_t firstCommand, uint32_t commandCount) const {
+    const auto stride = static_cast<uint32_t>(sizeof(VkDrawIndexedIndirectCommand));
+
+    VkBuffer vertexBuffers[] = {meshPool.getVertexBuffer(), drawBuffers.instances};
+    VkDeviceSize offsets[] = {0, drawBuffers.instancesOffset};
+    vkCmdBindVertexBuffers(commandBuffer, 0, 2, vertexBuffers, offsets);
+    vkCmdBindIndexBuffer(commandBuffer, meshPool.getIndexBuffer(), 0, VK_INDEX_TYPE_UINT32);
+
+    if (!drawIndirectFirstInstance_) {
+        // every command needs the instance binding moved to its own instances
+        for (auto i = firstCommand; i < firstCommand + commandCount; i++) {
+            VkDeviceSize instanceOffset = drawBuffers.instancesOffset + static_cast<VkDeviceSize>(firstInstances_[i]) * sizeof(InstanceData);
+            vkCmdBindVertexBuffers(commandBuffer, 1, 1, &drawBuffers.instances, &instanceOffset);
+            vkCmdDrawIndexedIndirect(commandBuffer, drawBuffers.commands, drawBuffers.commandsOffset + static_cast<VkDeviceSize>(i) * stride, 1, stride);
+        }
+        return;
+    }
+
+    if (!multiDrawIndirect_) {
+        for (auto i = firstCommand; i < firstCommand + commandCount; i++)
+            vkCmdDrawIndexedIndirect(commandBuffer, drawBuffers.commands, drawBuffers.commandsOffset + static_cast<VkDeviceSize>(i) * stride, 1, stride);
+        return;
+    }
+
+    for (auto i = firstCommand; i < firstCommand + commandCount; i += maxDrawIndirectCount_) {
+        auto count = std::min(maxDrawIndirectCount_, firstCommand + commandCount - i);
+        vkCmdDrawIndexedIndirect(commandBuffer, drawBuffers.commands, drawBuffers.commandsOffset + static_cast<VkDeviceSize>(i) * stride, count, stride);
+    }
+}
\ No newline at end of file
@@ -0,0 +1,83 @@
+#pragma once
+
+#include <vector>
+#include <functional>
+#include <vulkan/vulkan.h>
+#include "frameAllocator.hpp"
+#include "meshPool.hpp"
+
+// column major model matrix, read by the vertex shader as a per-instance attribute
+struct InstanceData {
+    float model[16];
+};
+
+// what the culling pass needs to know about each instance, in the same order as the instance data
+struct CullInstance {
+    uint32_t commandIndex;
+    uint32_t instanceBase;
+    uint32_t padding[2];
+    float boundingSphere[4];
+};
+
+struct DrawBuffers {
+    VkBuffer commands;
+    VkBuffer instances;
+    VkDeviceSize commandsOffset = 0;
+    VkDeviceSize instancesOffset = 0;
+};
+
+// collects a frame's draws and turns them into a handful of indirect calls: draws of the same mesh are
+// merged into one instanced VkDrawIndexedIndirectCommand, and all commands go out in one multi-draw
+class DrawBatcher {
+public:
+
+    // the built lists live in the frame allocator's memory, for one frame each
+    DrawBatcher(FrameAllocator& frameAllocator, bool multiDrawIndirect, bool drawIndirectFirstInstance, uint32_t maxDrawIndirectCount);
+
+    // starts the frame's draw list, after the frame allocator began the frame
+    void begin();
+    void draw(MeshHandle mesh, const InstanceData& instance);
+    // count instances of a mesh whose data write(instances) fills in during build, straight into the mapped instance buffer
+    void drawRange(MeshHandle mesh, uint32_t count, std::function<void(InstanceData*)> write);
+    // groups the draws by mesh and writes the indirect commands and instance data of the frame
+    void build(MeshPool& meshPool);
+
+    uint32_t getCommandCount() const { return commandCount_; }
+    uint32_t getInstanceCount() const { return instanceCount_; }
+
+    // the built list as written by the cpu, commands carry every instance
+    DrawBuffers getDrawBuffers() const;
+    const FrameAllocation& getCullInstances() const { return cullInstances_; }
+
+    // issues commands [firstCommand, firstCommand + commandCount) from drawBuffers, either the built list or a
+    // culled copy with the same layout, safe to call from several threads
+    void record(VkCommandBuffer commandBuffer, MeshPool& meshPool, DrawBuffers drawBuffers, uint32_t firstCommand, uint32_t commandCount) const;
+
+private:
+
+    FrameAllocator& frameAllocator_;
+    bool multiDrawIndirect_;
+    bool drawIndirectFirstInstance_;
+    uint32_t maxDrawIndirectCount_;
+
+    FrameAllocation commands_;
+    FrameAllocation instances_;
+    FrameAllocation cullInstances_;
+    // where each command's instances start, used when firstInstance cannot be read from the buffer
+    std::vector<uint32_t> firstInstances_;
+    uint32_t commandCount_ = 0;
+    uint32_t instanceCount_ = 0;
+
+    std::vector<MeshHandle> drawMeshes_;
+    std::vector<InstanceData> drawInstances_;
+
+    struct DrawRange {
+        MeshHandle mesh;
+        uint32_t count;
+        std::function<void(InstanceData*)> write;
+    };
+    std::vector<DrawRange> drawRanges_;
+    std::vector<uint32_t> meshInstanceCounts_;
+    std::vector<Mesh> meshes_;
+    std::vector<uint32_t> meshCommands_;
+};
\ No newline at end of file
@@ -0,0 +1,30 @@
+#include "ecs.hpp"
+#include <atomic>
+
+Entity World::create() {
+    if (freeIndices_.empty()) {
+        generations_.push_back(0);
+        return {static_cast<uint32_t>(generations_.size() - 1), 0};
+    }
+
+    auto index = freeIndices_.back();
+    freeIndices_.pop_back();
+    return {index, generations_[index]};
+}
+
+void World::destroy(Entity entity) {
+    if (!isAlive(entity))
+        return;
+
+    for (auto& pool : pools_)
+        if (pool)
+            pool->remove(entity.index);
+
+    generations_[entity.index]++;
+    freeIndices_.push_back(entity.index);
+}
+
+uint32_t World::nextComponentId_() {
+    static std::atomic<uint32_t> next = 0;
+    return next++;
+}
\ No newline at end of file
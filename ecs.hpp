@@ -0,0 +1,166 @@
+#pragma once
+
+#include <vector>
+#include <memory>
+#include <cstdint>
+#include <algorithm>
+#include <tuple>
+#include "utilities.hpp"
+
+struct Entity {
+    uint32_t index;
+    uint32_t generation;
+
+    bool operator==(const Entity& other) const { return index == other.index && generation == other.generation; }
+    bool operator!=(const Entity& other) const { return !(*this == other); }
+};
+
+class ComponentPoolBase {
+public:
+
+    virtual ~ComponentPoolBase() = default;
+
+    virtual bool contains(uint32_t entity) const = 0;
+    virtual void remove(uint32_t entity) = 0;
+};
+
+// sparse set of one component type: the components are packed in one array, so a system touching a single
+// component streams through exactly the bytes it needs, and a sparse array of entity indices finds any of them
+template <typename T>
+class ComponentPool : public ComponentPoolBase {
+public:
+
+    T& add(uint32_t entity, T component) {
+        if (entity >= sparse_.size())
+            sparse_.resize(std::max<size_t>(entity + 1, sparse_.size() * 2), none_);
+
+        if (sparse_[entity] != none_)
+            return components_[sparse_[entity]] = std::move(component);
+
+        sparse_[entity] = static_cast<uint32_t>(dense_.size());
+        dense_.push_back(entity);
+        components_.push_back(std::move(component));
+        return components_.back();
+    }
+
+    // moves the last component into the hole, which keeps the array packed but reorders it
+    void remove(uint32_t entity) override {
+        if (!contains(entity))
+            return;
+
+        auto slot = sparse_[entity];
+        sparse_[dense_.back()] = slot;
+        dense_[slot] = dense_.back();
+        components_[slot] = std::move(components_.back());
+
+        sparse_[entity] = none_;
+        dense_.pop_back();
+        components_.pop_back();
+    }
+
+    bool contains(uint32_t entity) const override { return entity < sparse_.size() && sparse_[entity] != none_; }
+    T& get(uint32_t entity) { return components_[sparse_[entity]]; }
+    T* find(uint32_t entity) { return contains(entity) ? &components_[sparse_[entity]] : nullptr; }
+
+    uint32_t size() const { return static_cast<uint32_t>(dense_.size()); }
+    // packed components and the entity index owning each
+    T* data() { return components_.data(); }
+    const uint32_t* entities() const { return dense_.data(); }
+
+private:
+
+    static constexpr uint32_t none_ = UINT32_MAX;
+
+    std::vector<uint32_t> sparse_;
+    std::vector<uint32_t> dense_;
+    std::vector<T> components_;
+};
+
+// entities are indices into per-component pools, a generation tells a reused index from its previous owner;
+// creating, destroying and adding or removing components must not overlap an iteration
+class World {
+public:
+
+    Entity create();
+    void destroy(Entity entity);
+    bool isAlive(Entity entity) const { return entity.index < generations_.size() && generations_[entity.index] == entity.generation; }
+    uint32_t size() const { return static_cast<uint32_t>(generations_.size() - freeIndices_.size()); }
+
+    template <typename T>
+    T& add(Entity entity, T component = {}) { return pool<T>().add(entity.index, std::move(component)); }
+    template <typename T>
+    void remove(Entity entity) { pool<T>().remove(entity.index); }
+    template <typename T>
+    bool has(Entity entity) { return pool<T>().contains(entity.index); }
+    template <typename T>
+    T& get(Entity entity) { return pool<T>().get(entity.index); }
+
+    template <typename T>
+    ComponentPool<T>& pool() {
+        auto id = componentId_<T>();
+        if (id >= pools_.size())
+            pools_.resize(id + 1);
+        if (!pools_[id])
+            pools_[id] = std::make_unique<ComponentPool<T>>();
+        return static_cast<ComponentPool<T>&>(*pools_[id]);
+    }
+
+    // calls function(First&, Rest&...) for every entity with all the components, walking First's packed array,
+    // so put the rarest component first
+    template <typename First, typename... Rest, typename Function>
+    void each(Function&& function) {
+        eachInRange_<First, Rest...>(0, pool<First>().size(), function);
+    }
+
+    // each split into chunks of First's array run as jobs, function must only touch the entity it is given
+    template <typename First, typename... Rest, typename Function>
+    void parallelEach(Utilities::JobSystem& jobSystem, Function&& function, uint32_t chunkSize = 4096) {
+        // every pool is created up front, workers must not grow pools_
+        pool<First>();
+        (pool<Rest>(), ...);
+
+        auto count = pool<First>().size();
+        auto chunkCount = (count + chunkSize - 1) / chunkSize;
+        if (chunkCount <= 1) {
+            eachInRange_<First, Rest...>(0, count, function);
+            return;
+        }
+
+        jobSystem.parallelFor(chunkCount, [&](uint32_t chunk) {
+            eachInRange_<First, Rest...>(chunk * chunkSize, std::min(count, (chunk + 1) * chunkSize), function);
+        });
+    }
+
+private:
+
+    std::vector<uint32_t> generations_;
+    std::vector<uint32_t> freeIndices_;
+    std::vector<std::unique_ptr<ComponentPoolBase>> pools_;
+
+    static uint32_t nextComponentId_();
+    template <typename T>
+    static uint32_t componentId_() {
+        static const uint32_t id = nextComponentId_();
+        return id;
+    }
+
+    template <typename First, typename... Rest, typename Function>
+    void eachInRange_(uint32_t begin, uint32_t end, Function& function) {
+        auto& first = pool<First>();
+        auto components = first.data();
+
+        if constexpr (sizeof...(Rest) == 0) {
+            for (auto i = begin; i < end; i++)
+                function(components[i]);
+        } else {
+            auto entities = first.entities();
+            auto rest = std::tuple<ComponentPool<Rest>&...>(pool<Rest>()...);
+
+            for (auto i = begin; i < end; i++) {
+                auto entity = entities[i];
+                if ((std::get<ComponentPool<Rest>&>(rest).contains(entity) && ...))
+                    function(components[i], std::get<ComponentPool<Rest>&>(rest).get(entity)...);
+            }
+        }
+    }
+};
\ No newline at end of file
@@ -0,0 +1,101 @@
+#include "frameAllocator.hpp"
+#include <algorithm>
+
+namespace {
+
+    VkDeviceSize alignUp(VkDeviceSize value, VkDeviceSize alignment) {
+        return (value + alignment - 1) & ~(alignment - 1);
+    }
+}
+
+FrameAllocator::FrameAllocator(MemoryAllocator& allocator, const VkPhysicalDeviceLimits& limits, uint32_t framesInFlight, VkDeviceSize capacity)
+    : allocator_(allocator), uniformAlignment_(std::max<VkDeviceSize>(limits.minUniformBufferOffsetAlignment, 16)),
+      storageAlignment_(std::max<VkDeviceSize>(limits.minStorageBufferOffsetAlignment, 16)), frames_(framesInFlight) {
+    for (auto& frame : frames_) {
+        frame.buffer = createBuffer_(capacity);
+        frame.capacity = capacity;
+    }
+}
+
+FrameAllocator::~FrameAllocator() {
+    for (auto& frame : frames_) {
+        allocator_.destroyBuffer(frame.buffer);
+        for (auto& spill : frame.spills)
+            allocator_.destroyBuffer(spill);
+    }
+}
+
+void FrameAllocator::beginFrame(uint32_t frame) {
+    auto& buffers = frames_[frame];
+
+    // the gpu is done with the slot, so a buffer that turned out too small is replaced right away
+    if (!buffers.spills.empty()) {
+        for (auto& spill : buffers.spills)
+            allocator_.destroyBuffer(spill);
+        buffers.spills.clear();
+
+        auto capacity = buffers.capacity;
+        while (capacity < buffers.capacity + buffers.spilledBytes)
+            capacity *= 2;
+
+        allocator_.destroyBuffer(buffers.buffer);
+        buffers.buffer = createBuffer_(capacity);
+        buffers.capacity = capacity;
+        buffers.spilledBytes = 0;
+    }
+
+    frame_ = frame;
+    head_.store(0, std::memory_order_relaxed);
+    spillHead_ = 0;
+    spillCapacity_ = 0;
+}
+
+FrameAllocation FrameAllocator::allocate(VkDeviceSize size, VkDeviceSize alignment) {
+    auto& buffers = frames_[frame_];
+
+    auto head = head_.load(std::memory_order_relaxed);
+    VkDeviceSize offset;
+    do {
+        offset = alignUp(head, alignment);
+        if (offset + size > buffers.capacity)
+            return spill_(size, alignment);
+    } while (!head_.compare_exchange_weak(head, offset + size, std::memory_order_relaxed));
+
+    auto data = static_cast<char*>(buffers.buffer.allocation.mapped) + offset;
+    return {buffers.buffer.buffer, offset, size, data};
+}
+
+VkDeviceSize FrameAllocator::getUsedBytes() const {
+    return head_.load(std::memory_order_relaxed) + frames_[frame_].spilledBytes;
+}
+
+Buffer FrameAllocator::createBuffer_(VkDeviceSize size) {
+    auto bufferInfo = VkBufferCreateInfo{};
+    bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+    bufferInfo.size = size;
+    bufferInfo.usage = VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_VERTEX_BUFFER_BIT |
+        VK_BUFFER_USAGE_INDEX_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT;
+    bufferInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+
+    return allocator_.createBuffer(bufferInfo, MemoryUsage::CpuToGpu);
+}
+
+FrameAllocation FrameAllocator::spill_(VkDeviceSize size, VkDeviceSize alignment) {
+    std::lock_guard<std::mutex> lock(spillMutex_);
+    auto& buffers = frames_[frame_];
+
+    // spill buffers are at least as large as the main one, so a burst of small allocations shares them
+    auto offset = alignUp(spillHead_, alignment);
+    if (buffers.spills.empty() || offset + size > spillCapacity_) {
+        spillCapacity_ = std::max(buffers.capacity, size);
+        buffers.spills.push_back(createBuffer_(spillCapacity_));
+        offset = 0;
+    }
+
+    spillHead_ = offset + size;
+    buffers.spilledBytes += size;
+
+    auto& spill = buffers.spills.back();
+    auto data = static_cast<char*>(spill.allocation.mapped) + offset;
+    return {spill.buffer, offset, size, data};
+}
\ No newline at end of file
@@ -0,0 +1,61 @@
+#pragma once
+
+#include <vector>
+#include <mutex>
+#include <atomic>
+#include <vulkan/vulkan.h>
+#include "memoryAllocator.hpp"
+
+struct FrameAllocation {
+    VkBuffer buffer = VK_NULL_HANDLE;
+    VkDeviceSize offset = 0;
+    VkDeviceSize size = 0;
+    // persistently mapped and coherent, written straight by the cpu
+    void* data = nullptr;
+};
+
+// per-frame-in-flight linear memory for uniform, storage, vertex and indirect data written once a frame:
+// an allocation is one atomic bump of an offset into the frame slot's mapped buffer, and the slot's
+// allocations are all dropped together when it begins again. a frame that outgrows its buffer spills into
+// extra buffers, and the slot's buffer grows to fit the next time it begins
+class FrameAllocator {
+public:
+
+    FrameAllocator(MemoryAllocator& allocator, const VkPhysicalDeviceLimits& limits, uint32_t framesInFlight, VkDeviceSize capacity = 4ull * 1024 * 1024);
+    ~FrameAllocator();
+
+    // releases everything the slot handed out, the fence of its previous submission must have signaled
+    void beginFrame(uint32_t frame);
+
+    // alignment must be a power of two; thread safe, and lock free unless the frame spills
+    FrameAllocation allocate(VkDeviceSize size, VkDeviceSize alignment);
+    // aligned for use as a dynamic uniform or storage buffer offset
+    FrameAllocation allocateUniform(VkDeviceSize size) { return allocate(size, uniformAlignment_); }
+    FrameAllocation allocateStorage(VkDeviceSize size) { return allocate(size, storageAlignment_); }
+
+    VkDeviceSize getUsedBytes() const;
+
+private:
+
+    struct FrameBuffers {
+        Buffer buffer;
+        VkDeviceSize capacity = 0;
+        std::vector<Buffer> spills;
+        VkDeviceSize spilledBytes = 0;
+    };
+
+    MemoryAllocator& allocator_;
+    VkDeviceSize uniformAlignment_;
+    VkDeviceSize storageAlignment_;
+
+    std::vector<FrameBuffers> frames_;
+    uint32_t frame_ = 0;
+    std::atomic<VkDeviceSize> head_{0};
+
+    std::mutex spillMutex_;
+    VkDeviceSize spillHead_ = 0;
+    VkDeviceSize spillCapacity_ = 0;
+
+    Buffer createBuffer_(VkDeviceSize size);
+    FrameAllocation spill_(VkDeviceSize size, VkDeviceSize alignment);
+};
\ No newline at end of file
@@ -0,0 +1,65 @@
+#include "framePacer.hpp"
+#include <thread>
+#include <algorithm>
+
+namespace {
+    double milliseconds(FramePacer::Clock::duration duration) {
+        return std::chrono::duration<double, std::milli>(duration).count();
+    }
+}
+
+FramePacer::FramePacer(bool justInTime) : justInTime_(justInTime) {}
+
+double FramePacer::beginFrame(uint64_t frame) {
+    // a frame dropped before submission, say for a swapchain recreation, is sampled again
+    if (!pending_.empty() && !pending_.back().isSubmitted)
+        pending_.pop_back();
+
+    auto slept = 0.0;
+    if (justInTime_ && !pending_.empty()) {
+        // the new frame's gpu work queues behind every frame still pending, so predict when the last of them finishes
+        auto finish = lastCompletion_;
+        for (const auto& pending : pending_)
+            finish = std::max(finish, pending.submitted) + std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double, std::milli>(gpuTime_));
+
+        auto wake = finish - std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double, std::milli>(cpuTime_ + safetyMargin_));
+        auto now = Clock::now();
+        if (wake > now) {
+            std::this_thread::sleep_until(wake);
+            slept = milliseconds(Clock::now() - now);
+        }
+    }
+
+    auto pending = PendingFrame{};
+    pending.frame = frame;
+    pending.inputSampled = Clock::now();
+    pending_.push_back(pending);
+
+    return slept;
+}
+
+void FramePacer::frameSubmitted(uint64_t frame) {
+    if (pending_.empty() || pending_.back().frame != frame)
+        return;
+
+    auto& pending = pending_.back();
+    pending.submitted = Clock::now();
+    pending.isSubmitted = true;
+
+    auto cpuTime = milliseconds(pending.submitted - pending.inputSampled);
+    cpuTime_ = cpuTime_ == 0 ? cpuTime : cpuTime_ + smoothing_ * (cpuTime - cpuTime_);
+}
+
+void FramePacer::frameCompleted(uint64_t frame, Clock::time_point time) {
+    // frames seen done together all get the same time, which only makes the gpu look faster and the pacing more cautious
+    while (!pending_.empty() && pending_.front().frame <= frame && pending_.front().isSubmitted) {
+        auto& pending = pending_.front();
+
+        auto gpuTime = milliseconds(time - std::max(pending.submitted, lastCompletion_));
+        gpuTime_ = gpuTime_ == 0 ? gpuTime : gpuTime_ + smoothing_ * (gpuTime - gpuTime_);
+        latency_ = milliseconds(time - pending.inputSampled);
+
+        lastCompletion_ = time;
+        pending_.pop_front();
+    }
+}
\ No newline at end of file
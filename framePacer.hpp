@@ -0,0 +1,46 @@
+#pragma once
+
+#include <deque>
+#include <chrono>
+#include <cstdint>
+
+// tracks each frame from the moment its input is sampled until its fence is seen signaled, and in
+// just-in-time mode delays sampling the next frame's input until shortly before the gpu can take it
+class FramePacer {
+public:
+
+    using Clock = std::chrono::steady_clock;
+
+    FramePacer(bool justInTime);
+
+    // call right before sampling the frame's input, returns the milliseconds slept
+    double beginFrame(uint64_t frame);
+    void frameSubmitted(uint64_t frame);
+    // the frame and every frame before it were seen done at the given time
+    void frameCompleted(uint64_t frame, Clock::time_point time);
+
+    // milliseconds from input sample to gpu completion of the newest finished frame, presentation not included
+    double getLatency() const { return latency_; }
+
+private:
+
+    struct PendingFrame {
+        uint64_t frame;
+        Clock::time_point inputSampled;
+        Clock::time_point submitted;
+        bool isSubmitted = false;
+    };
+
+    bool justInTime_;
+    std::deque<PendingFrame> pending_;
+    Clock::time_point lastCompletion_;
+
+    // exponentially smoothed milliseconds from input sample to submit, and of gpu work per frame
+    double cpuTime_ = 0;
+    double gpuTime_ = 0;
+    double latency_ = 0;
+
+    const double smoothing_ = 0.1;
+    // slack for scheduler wake-up jitter, waking late costs a whole idle gpu gap
+    const double safetyMargin_ = 0.5;
+};
\ No newline at end of file
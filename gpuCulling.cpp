@@ -0,0 +1,466 @@
+#include "gpuCulling.hpp"
+#include <stdexcept>
+#include <algorithm>
+#include <cstring>
+
+namespace {
+
+    struct CullConstants {
+        float viewProjection[16];
+        uint32_t mode;
+        uint32_t count;
+        uint32_t depthPyramidReady;
+        uint32_t depthPyramidLevels;
+        float depthPyramidSize[2];
+    };
+
+    struct PyramidConstants {
+        int32_t sourceSize[2];
+        int32_t destinationSize[2];
+        uint32_t copy;
+    };
+
+    const uint32_t cullGroupSize = 64;
+    const uint32_t pyramidGroupSize = 8;
+
+    uint32_t groupCount(uint32_t count, uint32_t groupSize) {
+        return (count + groupSize - 1) / groupSize;
+    }
+
+    VkDescriptorSetLayout createSetLayout(VkDevice device, const std::vector<VkDescriptorType>& types) {
+        std::vector<VkDescriptorSetLayoutBinding> bindings(types.size());
+        for (auto i = 0; i < types.size(); i++) {
+            bindings[i].binding = i;
+            bindings[i].descriptorType = types[i];
+            bindings[i].descriptorCount = 1;
+            bindings[i].stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+        }
+
+        auto setLayoutInfo = VkDescriptorSetLayoutCreateInfo{};
+        setLayoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+        setLayoutInfo.bindingCount = static_cast<uint32_t>(bindings.size());
+        setLayoutInfo.pBindings = bindings.data();
+
+        VkDescriptorSetLayout setLayout;
+        if (vkCreateDescriptorSetLayout(device, &setLayoutInfo, nullptr, &setLayout) != VK_SUCCESS)
+            throw std::runtime_error("Failed to create descriptor set layout.");
+
+        return setLayout;
+    }
+
+    VkPipelineLayout createPipelineLayout(VkDevice device, VkDescriptorSetLayout setLayout, uint32_t pushConstantSize) {
+        auto pushConstantRange = VkPushConstantRange{};
+        pushConstantRange.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+        pushConstantRange.size = pushConstantSize;
+
+        auto pipelineLayoutInfo = VkPipelineLayoutCreateInfo{};
+        pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+        pipelineLayoutInfo.setLayoutCount = 1;
+        pipelineLayoutInfo.pSetLayouts = &setLayout;
+        pipelineLayoutInfo.pushConstantRangeCount = 1;
+        pipelineLayoutInfo.pPushConstantRanges = &pushConstantRange;
+
+        VkPipelineLayout pipelineLayout;
+        if (vkCreatePipelineLayout(device, &pipelineLayoutInfo, nullptr, &pipelineLayout) != VK_SUCCESS)
+            throw std::runtime_error("Failed to create pipeline layout.");
+
+        return pipelineLayout;
+    }
+
+    VkImageView createImageView(VkDevice device, VkImage image, uint32_t baseLevel, uint32_t levelCount) {
+        auto imageViewInfo = VkImageViewCreateInfo{};
+        imageViewInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+        imageViewInfo.image = image;
+        imageViewInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
+        imageViewInfo.format = VK_FORMAT_R32_SFLOAT;
+        imageViewInfo.subresourceRange = {VK_IMAGE_ASPECT_COLOR_BIT, baseLevel, levelCount, 0, 1};
+
+        VkImageView imageView;
+        if (vkCreateImageView(device, &imageViewInfo, nullptr, &imageView) != VK_SUCCESS)
+            throw std::runtime_error("Failed to create depth pyramid view.");
+
+        return imageView;
+    }
+}
+
+GpuCulling::GpuCulling(VkDevice device, MemoryAllocator& allocator, ShaderCompiler& shaderCompiler, VkPipelineCache pipelineCache, uint32_t framesInFlight, Retire retire)
+    : device_(device), allocator_(allocator), retire_(std::move(retire)), frames_(framesInFlight) {
+    // pyramid levels are read texel by texel, so nothing may be filtered
+    auto samplerInfo = VkSamplerCreateInfo{};
+    samplerInfo.sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO;
+    samplerInfo.magFilter = VK_FILTER_NEAREST;
+    samplerInfo.minFilter = VK_FILTER_NEAREST;
+    samplerInfo.mipmapMode = VK_SAMPLER_MIPMAP_MODE_NEAREST;
+    samplerInfo.addressModeU = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+    samplerInfo.addressModeV = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+    samplerInfo.addressModeW = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+    samplerInfo.maxLod = VK_LOD_CLAMP_NONE;
+
+    if (vkCreateSampler(device_, &samplerInfo, nullptr, &sampler_) != VK_SUCCESS)
+        throw std::runtime_error("Failed to create depth pyramid sampler.");
+
+    cullSetLayout_ = createSetLayout(device_, {
+        VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+        VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+        VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+        VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+        VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+        VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+        VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
+    });
+    cullPipelineLayout_ = createPipelineLayout(device_, cullSetLayout_, sizeof(CullConstants));
+    cullPipeline_ = createComputePipeline_(shaderCompiler, pipelineCache, "shaders/cull.comp", cullPipelineLayout_);
+
+    pyramidSetLayout_ = createSetLayout(device_, {VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE});
+    pyramidPipelineLayout_ = createPipelineLayout(device_, pyramidSetLayout_, sizeof(PyramidConstants));
+    pyramidPipeline_ = createComputePipeline_(shaderCompiler, pipelineCache, "shaders/hiz.comp", pyramidPipelineLayout_);
+
+    VkDescriptorPoolSize poolSizes[] = {
+        {VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 6 * framesInFlight},
+        {VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, framesInFlight},
+    };
+
+    auto descriptorPoolInfo = VkDescriptorPoolCreateInfo{};
+    descriptorPoolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+    descriptorPoolInfo.maxSets = framesInFlight;
+    descriptorPoolInfo.poolSizeCount = 2;
+    descriptorPoolInfo.pPoolSizes = poolSizes;
+
+    if (vkCreateDescriptorPool(device_, &descriptorPoolInfo, nullptr, &framePool_) != VK_SUCCESS)
+        throw std::runtime_error("Failed to create culling descriptor pool.");
+
+    for (auto& resources : frames_) {
+        auto allocateInfo = VkDescriptorSetAllocateInfo{};
+        allocateInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+        allocateInfo.descriptorPool = framePool_;
+        allocateInfo.descriptorSetCount = 1;
+        allocateInfo.pSetLayouts = &cullSetLayout_;
+
+        if (vkAllocateDescriptorSets(device_, &allocateInfo, &resources.descriptorSet) != VK_SUCCESS)
+            throw std::runtime_error("Failed to allocate culling descriptor set.");
+
+        auto bufferInfo = VkBufferCreateInfo{};
+        bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+        bufferInfo.size = sizeof(CullingStats);
+        bufferInfo.usage = VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT;
+        bufferInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+
+        resources.stats = allocator_.createBuffer(bufferInfo, MemoryUsage::GpuToCpu);
+        memset(resources.stats.allocation.mapped, 0, sizeof(CullingStats));
+
+        reserve_(resources, 64, 1024);
+    }
+}
+
+GpuCulling::~GpuCulling() {
+    destroyPyramid_(device_, allocator_, pyramid_);
+
+    for (auto& resources : frames_) {
+        allocator_.destroyBuffer(resources.commands);
+        allocator_.destroyBuffer(resources.instances);
+        allocator_.destroyBuffer(resources.stats);
+    }
+
+    vkDestroyDescriptorPool(device_, framePool_, nullptr);
+    vkDestroyPipeline(device_, pyramidPipeline_, nullptr);
+    vkDestroyPipelineLayout(device_, pyramidPipelineLayout_, nullptr);
+    vkDestroyDescriptorSetLayout(device_, pyramidSetLayout_, nullptr);
+    vkDestroyPipeline(device_, cullPipeline_, nullptr);
+    vkDestroyPipelineLayout(device_, cullPipelineLayout_, nullptr);
+    vkDestroyDescriptorSetLayout(device_, cullSetLayout_, nullptr);
+    vkDestroySampler(device_, sampler_, nullptr);
+}
+
+void GpuCulling::resize(VkExtent2D extent, VkImageView depthView) {
+    if (pyramid_.view != VK_NULL_HANDLE)
+        retire_([device = device_, allocator = &allocator_, pyramid = pyramid_]() mutable {
+            destroyPyramid_(device, *allocator, pyramid);
+        });
+
+    pyramid_ = {};
+    pyramid_.extent = extent;
+    pyramid_.levelCount = 1;
+    while ((std::max(extent.width, extent.height) >> pyramid_.levelCount) > 0)
+        pyramid_.levelCount++;
+
+    auto imageInfo = VkImageCreateInfo{};
+    imageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+    imageInfo.imageType = VK_IMAGE_TYPE_2D;
+    imageInfo.format = VK_FORMAT_R32_SFLOAT;
+    imageInfo.extent = {extent.width, extent.height, 1};
+    imageInfo.mipLevels = pyramid_.levelCount;
+    imageInfo.arrayLayers = 1;
+    imageInfo.samples = VK_SAMPLE_COUNT_1_BIT;
+    imageInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+    imageInfo.usage = VK_IMAGE_USAGE_STORAGE_BIT | VK_IMAGE_USAGE_SAMPLED_BIT;
+    imageInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+    imageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+
+    pyramid_.image = allocator_.createImage(imageInfo, MemoryUsage::GpuOnly);
+    pyramid_.view = createImageView(device_, pyramid_.image.image, 0, pyramid_.levelCount);
+    for (uint32_t level = 0; level < pyramid_.levelCount; level++)
+        pyramid_.levelViews.push_back(createImageView(device_, pyramid_.image.image, level, 1));
+
+    VkDescriptorPoolSize poolSizes[] = {
+        {VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, pyramid_.levelCount},
+        {VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, pyramid_.levelCount},
+    };
+
+    auto descriptorPoolInfo = VkDescriptorPoolCreateInfo{};
+    descriptorPoolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+    descriptorPoolInfo.maxSets = pyramid_.levelCount;
+    descriptorPoolInfo.poolSizeCount = 2;
+    descriptorPoolInfo.pPoolSizes = poolSizes;
+
+    if (vkCreateDescriptorPool(device_, &descriptorPoolInfo, nullptr, &pyramid_.descriptorPool) != VK_SUCCESS)
+        throw std::runtime_error("Failed to create depth pyramid descriptor pool.");
+
+    std::vector<VkDescriptorSetLayout> setLayouts(pyramid_.levelCount, pyramidSetLayout_);
+    pyramid_.levelSets.resize(pyramid_.levelCount);
+
+    auto allocateInfo = VkDescriptorSetAllocateInfo{};
+    allocateInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+    allocateInfo.descriptorPool = pyramid_.descriptorPool;
+    allocateInfo.descriptorSetCount = pyramid_.levelCount;
+    allocateInfo.pSetLayouts = setLayouts.data();
+
+    if (vkAllocateDescriptorSets(device_, &allocateInfo, pyramid_.levelSets.data()) != VK_SUCCESS)
+        throw std::runtime_error("Failed to allocate depth pyramid descriptor sets.");
+
+    // each level reads the one above it, the first reads the depth buffer
+    for (uint32_t level = 0; level < pyramid_.levelCount; level++) {
+        auto sourceInfo = VkDescriptorImageInfo{};
+        sourceInfo.sampler = sampler_;
+        sourceInfo.imageView = level == 0 ? depthView : pyramid_.levelViews[level - 1];
+        sourceInfo.imageLayout = level == 0 ? VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL : VK_IMAGE_LAYOUT_GENERAL;
+
+        auto destinationInfo = VkDescriptorImageInfo{};
+        destinationInfo.imageView = pyramid_.levelViews[level];
+        destinationInfo.imageLayout = VK_IMAGE_LAYOUT_GENERAL;
+
+        VkWriteDescriptorSet writes[2] = {};
+        for (auto i = 0; i < 2; i++) {
+            writes[i].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+            writes[i].dstSet = pyramid_.levelSets[level];
+            writes[i].dstBinding = i;
+            writes[i].descriptorCount = 1;
+        }
+        writes[0].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+        writes[0].pImageInfo = &sourceInfo;
+        writes[1].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
+        writes[1].pImageInfo = &destinationInfo;
+
+        vkUpdateDescriptorSets(device_, 2, writes, 0, nullptr);
+    }
+
+    pyramidInitialized_ = false;
+    pyramidBuilt_ = false;
+}
+
+void GpuCulling::recordCull(VkCommandBuffer commandBuffer, uint32_t frame, const DrawBatcher& drawBatcher, const float viewProjection[16]) {
+    auto& resources = frames_[frame];
+    auto commandCount = drawBatcher.getCommandCount();
+    auto instanceCount = drawBatcher.getInstanceCount();
+    reserve_(resources, commandCount, instanceCount);
+
+    // the frame's set was last used by the frame its fence just released, and the batcher's lists move every frame
+    auto sourceBuffers = drawBatcher.getDrawBuffers();
+    const auto& cullInstances = drawBatcher.getCullInstances();
+    VkDescriptorBufferInfo bufferInfos[] = {
+        {sourceBuffers.commands, sourceBuffers.commandsOffset, std::max(commandCount, 1u) * sizeof(VkDrawIndexedIndirectCommand)},
+        {cullInstances.buffer, cullInstances.offset, cullInstances.size},
+        {sourceBuffers.instances, sourceBuffers.instancesOffset, std::max(instanceCount, 1u) * sizeof(InstanceData)},
+        {resources.commands.buffer, 0, VK_WHOLE_SIZE},
+        {resources.instances.buffer, 0, VK_WHOLE_SIZE},
+        {resources.stats.buffer, 0, VK_WHOLE_SIZE},
+    };
+
+    auto pyramidInfo = VkDescriptorImageInfo{};
+    pyramidInfo.sampler = sampler_;
+    pyramidInfo.imageView = pyramid_.view;
+    pyramidInfo.imageLayout = VK_IMAGE_LAYOUT_GENERAL;
+
+    VkWriteDescriptorSet writes[7] = {};
+    for (auto i = 0; i < 7; i++) {
+        writes[i].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+        writes[i].dstSet = resources.descriptorSet;
+        writes[i].dstBinding = i;
+        writes[i].descriptorCount = 1;
+        writes[i].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+        writes[i].pBufferInfo = &bufferInfos[std::min(i, 5)];
+    }
+    writes[6].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+    writes[6].pBufferInfo = nullptr;
+    writes[6].pImageInfo = &pyramidInfo;
+
+    vkUpdateDescriptorSets(device_, 7, writes, 0, nullptr);
+
+    vkCmdFillBuffer(commandBuffer, resources.stats.buffer, 0, VK_WHOLE_SIZE, 0);
+
+    // the stats reset and the previous frame's pyramid build must land before the cull reads them
+    auto memoryBarrier = VkMemoryBarrier{};
+    memoryBarrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+    memoryBarrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+    memoryBarrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+
+    auto pyramidBarrier = VkImageMemoryBarrier{};
+    pyramidBarrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+    pyramidBarrier.srcAccessMask = 0;
+    pyramidBarrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+    pyramidBarrier.oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+    pyramidBarrier.newLayout = VK_IMAGE_LAYOUT_GENERAL;
+    pyramidBarrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    pyramidBarrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    pyramidBarrier.image = pyramid_.image.image;
+    pyramidBarrier.subresourceRange = {VK_IMAGE_ASPECT_COLOR_BIT, 0, pyramid_.levelCount, 0, 1};
+
+    vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0,
+        1, &memoryBarrier, 0, nullptr, pyramidInitialized_ ? 0 : 1, &pyramidBarrier);
+    pyramidInitialized_ = true;
+
+    vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, cullPipeline_);
+    vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, cullPipelineLayout_, 0, 1, &resources.descriptorSet, 0, nullptr);
+
+    auto constants = CullConstants{};
+    std::copy(viewProjection, viewProjection + 16, constants.viewProjection);
+    constants.depthPyramidReady = pyramidBuilt_ ? 1 : 0;
+    constants.depthPyramidLevels = pyramid_.levelCount;
+    constants.depthPyramidSize[0] = static_cast<float>(pyramid_.extent.width);
+    constants.depthPyramidSize[1] = static_cast<float>(pyramid_.extent.height);
+
+    // first copy the commands with no instances, then let every visible instance claim a slot in its command
+    constants.mode = 0;
+    constants.count = commandCount;
+    vkCmdPushConstants(commandBuffer, cullPipelineLayout_, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(constants), &constants);
+    vkCmdDispatch(commandBuffer, groupCount(commandCount, cullGroupSize), 1, 1);
+
+    memoryBarrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+    memoryBarrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+    vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 1, &memoryBarrier, 0, nullptr, 0, nullptr);
+
+    constants.mode = 1;
+    constants.count = instanceCount;
+    vkCmdPushConstants(commandBuffer, cullPipelineLayout_, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(constants), &constants);
+    vkCmdDispatch(commandBuffer, groupCount(instanceCount, cullGroupSize), 1, 1);
+
+    // the render graph hands the commands and instances over to the draws, only the stats are left for the host
+    memoryBarrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+    memoryBarrier.dstAccessMask = VK_ACCESS_HOST_READ_BIT;
+    vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_HOST_BIT, 0, 1, &memoryBarrier, 0, nullptr, 0, nullptr);
+}
+
+void GpuCulling::recordDepthPyramid(VkCommandBuffer commandBuffer) {
+    // the render graph hands the depth over to compute, only this frame's cull reads of the pyramid remain to wait for
+    vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 0, nullptr, 0, nullptr, 0, nullptr);
+
+    vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, pyramidPipeline_);
+
+    auto sourceExtent = pyramid_.extent;
+    for (uint32_t level = 0; level < pyramid_.levelCount; level++) {
+        auto destinationExtent = VkExtent2D{std::max(pyramid_.extent.width >> level, 1u), std::max(pyramid_.extent.height >> level, 1u)};
+
+        auto constants = PyramidConstants{};
+        constants.sourceSize[0] = static_cast<int32_t>(sourceExtent.width);
+        constants.sourceSize[1] = static_cast<int32_t>(sourceExtent.height);
+        constants.destinationSize[0] = static_cast<int32_t>(destinationExtent.width);
+        constants.destinationSize[1] = static_cast<int32_t>(destinationExtent.height);
+        constants.copy = level == 0 ? 1 : 0;
+
+        vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, pyramidPipelineLayout_, 0, 1, &pyramid_.levelSets[level], 0, nullptr);
+        vkCmdPushConstants(commandBuffer, pyramidPipelineLayout_, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(constants), &constants);
+        vkCmdDispatch(commandBuffer, groupCount(destinationExtent.width, pyramidGroupSize), groupCount(destinationExtent.height, pyramidGroupSize), 1);
+
+        auto memoryBarrier = VkMemoryBarrier{};
+        memoryBarrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+        memoryBarrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+        memoryBarrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+        vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 1, &memoryBarrier, 0, nullptr, 0, nullptr);
+
+        sourceExtent = destinationExtent;
+    }
+
+    pyramidBuilt_ = true;
+}
+
+DrawBuffers GpuCulling::getDrawBuffers(uint32_t frame) const {
+    return {frames_[frame].commands.buffer, frames_[frame].instances.buffer};
+}
+
+CullingStats GpuCulling::getStats(uint32_t frame) const {
+    auto stats = CullingStats{};
+    memcpy(&stats, frames_[frame].stats.allocation.mapped, sizeof(stats));
+    return stats;
+}
+
+VkPipeline GpuCulling::createComputePipeline_(ShaderCompiler& shaderCompiler, VkPipelineCache pipelineCache, const std::string& filename, VkPipelineLayout layout) {
+    auto code = shaderCompiler.compile(filename);
+
+    auto shaderModuleInfo = VkShaderModuleCreateInfo{};
+    shaderModuleInfo.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
+    shaderModuleInfo.codeSize = code.size() * sizeof(uint32_t);
+    shaderModuleInfo.pCode = code.data();
+
+    VkShaderModule shaderModule;
+    if (vkCreateShaderModule(device_, &shaderModuleInfo, nullptr, &shaderModule) != VK_SUCCESS)
+        throw std::runtime_error("Failed to create shader module.");
+
+    auto pipelineInfo = VkComputePipelineCreateInfo{};
+    pipelineInfo.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
+    pipelineInfo.stage.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+    pipelineInfo.stage.stage = VK_SHADER_STAGE_COMPUTE_BIT;
+    pipelineInfo.stage.module = shaderModule;
+    pipelineInfo.stage.pName = "main";
+    pipelineInfo.layout = layout;
+
+    VkPipeline pipeline;
+    auto result = vkCreateComputePipelines(device_, pipelineCache, 1, &pipelineInfo, nullptr, &pipeline);
+    vkDestroyShaderModule(device_, shaderModule, nullptr);
+
+    if (result != VK_SUCCESS)
+        throw std::runtime_error("Failed to create compute pipeline for " + filename + ".");
+
+    return pipeline;
+}
+
+void GpuCulling::reserve_(FrameResources& resources, uint32_t commandCount, uint32_t instanceCount) {
+    // the frame's previous cull is no longer read by the gpu, so its buffers can be replaced right away
+    if (commandCount > resources.commandCapacity) {
+        allocator_.destroyBuffer(resources.commands);
+        resources.commandCapacity = std::max(commandCount, resources.commandCapacity * 2);
+
+        auto bufferInfo = VkBufferCreateInfo{};
+        bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+        bufferInfo.size = static_cast<VkDeviceSize>(resources.commandCapacity) * sizeof(VkDrawIndexedIndirectCommand);
+        bufferInfo.usage = VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT;
+        bufferInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+
+        resources.commands = allocator_.createBuffer(bufferInfo, MemoryUsage::GpuOnly);
+    }
+
+    if (instanceCount > resources.instanceCapacity) {
+        allocator_.destroyBuffer(resources.instances);
+        resources.instanceCapacity = std::max(instanceCount, resources.instanceCapacity * 2);
+
+        auto bufferInfo = VkBufferCreateInfo{};
+        bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+        bufferInfo.size = static_cast<VkDeviceSize>(resources.instanceCapacity) * sizeof(InstanceData);
+        bufferInfo.usage = VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT;
+        bufferInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+
+        resources.instances = allocator_.createBuffer(bufferInfo, MemoryUsage::GpuOnly);
+    }
+}
+
+void GpuCulling::destroyPyramid_(VkDevice device, MemoryAllocator& allocator, DepthPyramid& pyramid) {
+    if (pyramid.descriptorPool != VK_NULL_HANDLE)
+        vkDestroyDescriptorPool(device, pyramid.descriptorPool, nullptr);
+
+    for (auto view : pyramid.levelViews)
+        vkDestroyImageView(device, view, nullptr);
+
+    if (pyramid.view != VK_NULL_HANDLE)
+        vkDestroyImageView(device, pyramid.view, nullptr);
+
+    allocator.destroyImage(pyramid.image);
+    pyramid = {};
+}
\ No newline at end of file
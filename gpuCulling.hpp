@@ -0,0 +1,84 @@
+#pragma once
+
+#include <vector>
+#include <functional>
+#include <vulkan/vulkan.h>
+#include "memoryAllocator.hpp"
+#include "shaderCompiler.hpp"
+#include "drawBatcher.hpp"
+
+struct CullingStats {
+    uint32_t visible = 0;
+    uint32_t frustumCulled = 0;
+    uint32_t occlusionCulled = 0;
+};
+
+// compute pre-pass that drops instances outside the frustum or hidden behind the previous frame's depth
+// pyramid, compacting the survivors into indirect commands and instance data laid out like the draw batcher's
+class GpuCulling {
+public:
+
+    // hands a deleter over to run once the frames in flight are done with the objects it destroys
+    using Retire = std::function<void(std::function<void()>)>;
+
+    GpuCulling(VkDevice device, MemoryAllocator& allocator, ShaderCompiler& shaderCompiler, VkPipelineCache pipelineCache, uint32_t framesInFlight, Retire retire);
+    ~GpuCulling();
+
+    // builds a depth pyramid matching the depth buffer, the previous one is retired
+    void resize(VkExtent2D extent, VkImageView depthView);
+
+    // records the cull of the frame's built draw list, ahead of the render pass
+    void recordCull(VkCommandBuffer commandBuffer, uint32_t frame, const DrawBatcher& drawBatcher, const float viewProjection[16]);
+    // records the pyramid build from the depth just rendered, for the next frame's occlusion test
+    void recordDepthPyramid(VkCommandBuffer commandBuffer);
+
+    DrawBuffers getDrawBuffers(uint32_t frame) const;
+    // counts of the frame slot's last cull, valid once its fence has signaled
+    CullingStats getStats(uint32_t frame) const;
+
+private:
+
+    struct FrameResources {
+        Buffer commands;
+        Buffer instances;
+        Buffer stats;
+        uint32_t commandCapacity = 0;
+        uint32_t instanceCapacity = 0;
+        VkDescriptorSet descriptorSet;
+    };
+
+    // level 0 matches the depth buffer, every texel of a level holds the farthest depth below it
+    struct DepthPyramid {
+        Image image;
+        VkImageView view = VK_NULL_HANDLE;
+        std::vector<VkImageView> levelViews;
+        VkDescriptorPool descriptorPool = VK_NULL_HANDLE;
+        std::vector<VkDescriptorSet> levelSets;
+        VkExtent2D extent = {};
+        uint32_t levelCount = 0;
+    };
+
+    VkDevice device_;
+    MemoryAllocator& allocator_;
+    Retire retire_;
+
+    VkSampler sampler_;
+
+    VkDescriptorSetLayout cullSetLayout_;
+    VkPipelineLayout cullPipelineLayout_;
+    VkPipeline cullPipeline_;
+    VkDescriptorPool framePool_;
+    std::vector<FrameResources> frames_;
+
+    VkDescriptorSetLayout pyramidSetLayout_;
+    VkPipelineLayout pyramidPipelineLayout_;
+    VkPipeline pyramidPipeline_;
+    DepthPyramid pyramid_;
+    // a new pyramid starts in an undefined layout and holds no depth until it is first built
+    bool pyramidInitialized_ = false;
+    bool pyramidBuilt_ = false;
+
+    VkPipeline createComputePipeline_(ShaderCompiler& shaderCompiler, VkPipelineCache pipelineCache, const std::string& filename, VkPipelineLayout layout);
+    void reserve_(FrameResources& resources, uint32_t commandCount, uint32_t instanceCount);
+    static void destroyPyramid_(VkDevice device, MemoryAllocator& allocator, DepthPyramid& pyramid);
+};
\ No newline at end of file
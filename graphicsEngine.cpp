@@ -4,72 +4,160 @@
 #include <set>
 #include "utilities.hpp"
 #include <functional>
-
-GraphicsEngine::GraphicsEngine() {
-    createWindow();
+#include <chrono>
+#include <algorithm>
+#include <cmath>
+#include "profiler.hpp"
+
+GraphicsEngine::GraphicsEngine(const GraphicsEngineSettings& settings)
+    : settings(settings), maxFramesInFlight(std::max(settings.framesInFlight, 1u)) {
+    PROFILE_SCOPE("GraphicsEngine::GraphicsEngine");
+    jobSystem = std::make_unique<Utilities::JobSystem>(settings.workerThreads);
+    fileReader = std::make_unique<Utilities::AsyncFileReader>(*jobSystem);
+    // streams in while the instance and device are created
+    if (!settings.pipelineCachePath.empty() && std::filesystem::exists(settings.pipelineCachePath))
+        pipelineCacheFile = fileReader->readFile(settings.pipelineCachePath);
+    if (!settings.headless)
+        createWindow();
     createInstance();
-    createSurface();
+    if (!settings.headless)
+        createSurface();
     #ifdef DEBUG_MODE
         createDebugMessenger();
     #endif
     pickPhysicalDevice();
     createDevice();
-    createSwapchain();
+    memoryAllocator = std::make_unique<MemoryAllocator>(physicalDevice, device);
+    createFrameAllocator();
+    uploadManager = std::make_unique<UploadManager>(device, *memoryAllocator, transferQueueIndex, transferQueue, graphicsQueueIndex.value(),
+        transferQueue == graphicsQueue ? &graphicsQueueMutex : nullptr);
+    createBindlessDescriptors();
+    meshPool = std::make_unique<MeshPool>(*memoryAllocator, *uploadManager);
+    if (settings.headless)
+        createOffscreenImages();
+    else
+        createSwapchain();
     createImageViews();
-    createRenderPass();
-    createGraphicsPipeline(pipelineLayout, graphicsPipeline);
-    createFramebuffers();
+    pickDepthFormat();
+    createPipelineCache();
+    openAssetArchive();
+    shaderCompiler = std::make_unique<ShaderCompiler>(settings.shaderCachePath, assetArchive.get());
+    if (settings.gpuCulling) {
+        culling = std::make_unique<GpuCulling>(device, *memoryAllocator, *shaderCompiler, pipelineCache, maxFramesInFlight,
+            [this](std::function<void()> deleter) { retire(std::move(deleter)); });
+    }
+    pipelineLibrary = std::make_unique<PipelineLibrary>(device, *shaderCompiler, pipelineCache, *bindless);
     createCommandPool();
     createCommandBuffer();
     createSyncObjects();
+    createTestScene();
+
+    // a first build settles the render passes the pipelines are made against
+    renderGraph = std::make_unique<RenderGraph>(device, *memoryAllocator, [this](std::function<void()> deleter) { retire(std::move(deleter)); });
+    buildFrameGraph(0);
+    auto graphStats = renderGraph->getStats();
+    std::cout << "Render graph: " << graphStats.passCount - graphStats.culledPassCount << "/" << graphStats.passCount << " passes, "
+        << graphStats.barrierCount << " barriers, " << graphStats.transientImageCount << " transient images in "
+        << graphStats.transientBytes / 1024 << " KiB (" << graphStats.unaliasedBytes / 1024 << " KiB unaliased)" << std::endl;
+
+    // the recording threads are idle until the first frame, so they build the variants in the meantime
+    auto pipelineStart = std::chrono::steady_clock::now();
+    {
+        PROFILE_SCOPE("PipelineLibrary::prewarm");
+        pipelineLibrary->prewarm({sceneMaterial}, *jobSystem);
+    }
+    pipelineCreationMilliseconds = FrameBenchmark::elapsedMilliseconds(pipelineStart, std::chrono::steady_clock::now());
+    std::cout << pipelineLibrary->size() << " graphics pipelines created in " << pipelineCreationMilliseconds << " ms ("
+        << (pipelineCacheWarm ? "warm" : "cold") << " pipeline cache)" << std::endl;
+    framePacer = std::make_unique<FramePacer>(settings.justInTime);
 
-    std::vector<std::string> a = {
-        "shaders/shader.vert",
-        "shaders/shader.frag",
-    };
-    fileWatcher = std::make_unique<Utilities::FileWatcher>(a, std::bind(&onChangedFile, this, std::placeholders::_1));
+    simulation = std::make_unique<Simulation>(*jobSystem, settings.drawCount, settings.tickRate);
+    simulation->start();
+
+    if (settings.benchmarkFrames > 0)
+        benchmark = std::make_unique<FrameBenchmark>(settings.benchmarkWarmupFrames, settings.benchmarkFrames);
+
+    fileWatcher = std::make_unique<Utilities::FileWatcher>(std::vector<std::string>{"shaders"}, std::bind(&GraphicsEngine::onChangedFiles, this, std::placeholders::_1));
     fileWatcher->start();
 }
 
 GraphicsEngine::~GraphicsEngine() {
+    simulation.reset();
     fileWatcher.reset();
 
+    // the builds only, runMainThreadJobs below publishes what they built
+    jobSystem->wait(shaderReloadJobs);
+    // the streamer's uploads may submit transfers of their own, which the idle below then covers
+    textureStreamer->wait();
+
+    vkDeviceWaitIdle(device);
+
+    // publishes reloads nobody picked up, so the flush below destroys whatever they replaced
+    jobSystem->runMainThreadJobs();
+    deletionQueue.flush();
+    textureStreamer.reset();
+
     for (auto i = 0; i < maxFramesInFlight; i++) {
         vkDestroyFence(device, inFlightFences[i], nullptr);
         vkDestroySemaphore(device, renderFinishedSemaphores[i], nullptr);
         vkDestroySemaphore(device, imageAvailableSemaphores[i], nullptr);
     }
 
+    for (auto& commands : frameCommands)
+        for (auto pool : commands.pools)
+            vkDestroyCommandPool(device, pool, nullptr);
     vkDestroyCommandPool(device, commandPool, nullptr);
 
     cleanupSwapchain();
 
-    vkDestroyPipeline(device, graphicsPipeline, nullptr);
-    vkDestroyPipelineLayout(device, pipelineLayout, nullptr);
-    vkDestroyRenderPass(device, renderPass, nullptr);
+    pipelineLibrary.reset();
+    renderGraph.reset();
+
+    vkDestroySampler(device, testSampler, nullptr);
+    vkDestroyImageView(device, testTextureView, nullptr);
+    memoryAllocator->destroyImage(testTexture);
+    bindless.reset();
+
+    destroyPipelineCache();
+
+    culling.reset();
+    drawBatcher.reset();
+    meshPool.reset();
+    uploadManager.reset();
+    frameAllocator.reset();
+    memoryAllocator.reset();
     
     vkDestroyDevice(device, nullptr);
     #ifdef DEBUG_MODE
         Vulkan::destroyDebugMessengerExtension(instance, debugMessenger, nullptr);
     #endif
-    vkDestroySurfaceKHR(instance, surface, nullptr);
+    if (!settings.headless)
+        vkDestroySurfaceKHR(instance, surface, nullptr);
     vkDestroyInstance(instance, nullptr);
-    glfwTerminate();
+    if (!settings.headless)
+        glfwTerminate();
 }
 
 void GraphicsEngine::createWindow() {
+    PROFILE_SCOPE("GraphicsEngine::createWindow");
     glfwInit();
 
     glfwWindowHint(GLFW_CLIENT_API, GLFW_NO_API);
-    glfwWindowHint(GLFW_RESIZABLE, GLFW_FALSE);
+    glfwWindowHint(GLFW_RESIZABLE, GLFW_TRUE);
 
-    window = glfwCreateWindow(width, height, "vk-game", nullptr, nullptr);
+    window = glfwCreateWindow(settings.width, settings.height, "vk-game", nullptr, nullptr);
     if (!window) {
         glfwTerminate();
         throw std::runtime_error("Failed to create window.");
     }
 
     glfwSetWindowPos(window, 1920 + 400, 350);
+
+    // not every platform reports a resize through vkQueuePresentKHR
+    glfwSetWindowUserPointer(window, this);
+    glfwSetFramebufferSizeCallback(window, [](GLFWwindow* window, int width, int height) {
+        static_cast<GraphicsEngine*>(glfwGetWindowUserPointer(window))->framebufferResized = true;
+    });
 }
 
 void GraphicsEngine::createSurface() {
@@ -78,6 +166,7 @@ void GraphicsEngine::createSurface() {
 }
 
 void GraphicsEngine::createInstance() {
+    PROFILE_SCOPE("GraphicsEngine::createInstance");
     std::vector<const char*> layers;
     #ifdef DEBUG_MODE
         layers.push_back("VK_LAYER_KHRONOS_validation");
@@ -86,9 +175,12 @@ void GraphicsEngine::createInstance() {
     if (!Vulkan::instanceSupportsLayers(layers))
         throw std::runtime_error("Layers are not supported.");
 
-    uint32_t glfwExtensionCount;
-    auto glfwExtensions = glfwGetRequiredInstanceExtensions(&glfwExtensionCount);
-    std::vector<const char*> extensions(glfwExtensions, glfwExtensions + glfwExtensionCount);
+    std::vector<const char*> extensions;
+    if (!settings.headless) {
+        uint32_t glfwExtensionCount;
+        auto glfwExtensions = glfwGetRequiredInstanceExtensions(&glfwExtensionCount);
+        extensions.assign(glfwExtensions, glfwExtensions + glfwExtensionCount);
+    }
     #ifdef DEBUG_MODE
         extensions.push_back(VK_EXT_DEBUG_UTILS_EXTENSION_NAME);
     #endif
@@ -101,7 +193,8 @@ void GraphicsEngine::createInstance() {
     appInfo.pApplicationName = "vk-game";
     appInfo.applicationVersion = VK_MAKE_VERSION(1, 0, 0);
     appInfo.pEngineName = "vk-game";
-    appInfo.apiVersion = VK_API_VERSION_1_0;
+    // 1.1 for vkGetPhysicalDeviceFeatures2, which tells whether descriptor indexing is there
+    appInfo.apiVersion = VK_API_VERSION_1_1;
 
     auto instanceInfo = VkInstanceCreateInfo{};
     instanceInfo.sType = VK_STRUCTURE_TYPE_INSTANCE_CREATE_INFO;
@@ -170,6 +263,7 @@ VKAPI_ATTR VkBool32 VKAPI_CALL GraphicsEngine::debugCallback(
 }
 
 void GraphicsEngine::pickPhysicalDevice() {
+    PROFILE_SCOPE("GraphicsEngine::pickPhysicalDevice");
     uint32_t deviceCount;
 
     if (vkEnumeratePhysicalDevices(instance, &deviceCount, nullptr) != VK_SUCCESS)
@@ -183,13 +277,24 @@ void GraphicsEngine::pickPhysicalDevice() {
     if (vkEnumeratePhysicalDevices(instance, &deviceCount, devices.data()) != VK_SUCCESS)
         throw std::runtime_error("Failed to enumerate physical devices.");
 
+    // prefer a discrete GPU, but fall back to anything else such as a software ICD (lavapipe) on CI
+    auto bestScore = 0;
     for (auto device : devices) {
         VkPhysicalDeviceProperties deviceProperties;
         vkGetPhysicalDeviceProperties(device, &deviceProperties);
 
-        if (deviceProperties.deviceType == VK_PHYSICAL_DEVICE_TYPE_DISCRETE_GPU)
+        auto score = 0;
+        switch (deviceProperties.deviceType) {
+            case VK_PHYSICAL_DEVICE_TYPE_DISCRETE_GPU: score = 4; break;
+            case VK_PHYSICAL_DEVICE_TYPE_INTEGRATED_GPU: score = 3; break;
+            case VK_PHYSICAL_DEVICE_TYPE_VIRTUAL_GPU: score = 2; break;
+            default: score = 1; break;
+        }
+
+        if (score > bestScore) {
+            bestScore = score;
             physicalDevice = device;
-            break;
+        }
     }
 
     if (physicalDevice == VK_NULL_HANDLE)
@@ -197,6 +302,7 @@ void GraphicsEngine::pickPhysicalDevice() {
 }
 
 void GraphicsEngine::createDevice() {
+    PROFILE_SCOPE("GraphicsEngine::createDevice");
     uint32_t queueFamilyCount;
     vkGetPhysicalDeviceQueueFamilyProperties(physicalDevice, &queueFamilyCount, nullptr);
 
@@ -210,6 +316,13 @@ void GraphicsEngine::createDevice() {
             graphicsQueueIndex = i;
         }
         
+        // nothing is presented, the first graphics family is all that is needed
+        if (settings.headless) {
+            if (graphicsQueueIndex.has_value())
+                break;
+            continue;
+        }
+
         VkBool32 presentSupported = false;
         vkGetPhysicalDeviceSurfaceSupportKHR(physicalDevice, i, surface, &presentSupported);
         if (presentSupported)
@@ -219,29 +332,112 @@ void GraphicsEngine::createDevice() {
             break;
     }
 
+    // nothing is presented in headless mode
+    if (settings.headless && graphicsQueueIndex.has_value())
+        presentIndex = graphicsQueueIndex;
+
     if (!graphicsQueueIndex.has_value() || !presentIndex.has_value())
         throw std::runtime_error("Failed to find a queue family supporting graphics and present operations.");
 
-    std::set<uint32_t> queueIndices = {graphicsQueueIndex.value(), presentIndex.value()};
+    // prefer a transfer-only family, then any other family, then a second queue of the graphics family
+    std::optional<uint32_t> transferIndex;
+    for (auto i = 0; i < queueFamilies.size(); i++)
+        if ((queueFamilies[i].queueFlags & VK_QUEUE_TRANSFER_BIT) && !(queueFamilies[i].queueFlags & (VK_QUEUE_GRAPHICS_BIT | VK_QUEUE_COMPUTE_BIT))) {
+            transferIndex = i;
+            break;
+        }
+
+    // graphics and compute families support transfers even when they do not report the bit
+    for (auto i = 0; i < queueFamilies.size() && !transferIndex.has_value(); i++)
+        if (i != graphicsQueueIndex.value() && (queueFamilies[i].queueFlags & (VK_QUEUE_TRANSFER_BIT | VK_QUEUE_GRAPHICS_BIT | VK_QUEUE_COMPUTE_BIT)))
+            transferIndex = i;
+
+    transferQueueIndex = transferIndex.value_or(graphicsQueueIndex.value());
+    uint32_t transferQueueSlot = 0;
+    if (transferQueueIndex == graphicsQueueIndex.value() && queueFamilies[transferQueueIndex].queueCount > 1)
+        transferQueueSlot = 1;
+
+    std::set<uint32_t> queueIndices = {graphicsQueueIndex.value(), presentIndex.value(), transferQueueIndex};
     std::vector<VkDeviceQueueCreateInfo> queueInfos;
-    auto queuePriority = 1.0f;
+    float queuePriorities[] = {1.0f, 1.0f};
 
     for (auto queueIndex : queueIndices) {
         auto queueInfo = VkDeviceQueueCreateInfo{};
         queueInfo.sType = VK_STRUCTURE_TYPE_DEVICE_QUEUE_CREATE_INFO;
         queueInfo.queueFamilyIndex = queueIndex;
-        queueInfo.queueCount = 1;
-        queueInfo.pQueuePriorities = &queuePriority;
+        queueInfo.queueCount = queueIndex == transferQueueIndex ? transferQueueSlot + 1 : 1;
+        queueInfo.pQueuePriorities = queuePriorities;
 
         queueInfos.push_back(queueInfo);
     }
 
-    const std::vector<const char*> extensions = { VK_KHR_SWAPCHAIN_EXTENSION_NAME };
+    std::vector<const char*> extensions;
+    if (!settings.headless)
+        extensions.push_back(VK_KHR_SWAPCHAIN_EXTENSION_NAME);
+
     if (!Vulkan::deviceSupportsExtensions(physicalDevice, extensions))
-        std::runtime_error("The extensions are not supported by the physical device.");
+        throw std::runtime_error("The extensions are not supported by the physical device.");
+
+    // both only widen what a single indirect call can cover, the draw batcher works without them
+    auto supportedFeatures = VkPhysicalDeviceFeatures{};
+    vkGetPhysicalDeviceFeatures(physicalDevice, &supportedFeatures);
+
+    auto enabledFeatures = VkPhysicalDeviceFeatures{};
+    enabledFeatures.multiDrawIndirect = supportedFeatures.multiDrawIndirect;
+    enabledFeatures.drawIndirectFirstInstance = supportedFeatures.drawIndirectFirstInstance;
+    multiDrawIndirect = supportedFeatures.multiDrawIndirect;
+    drawIndirectFirstInstance = supportedFeatures.drawIndirectFirstInstance;
+
+    // the bindless tables are indexed with push constants, which are dynamically uniform
+    enabledFeatures.shaderSampledImageArrayDynamicIndexing = supportedFeatures.shaderSampledImageArrayDynamicIndexing;
+    enabledFeatures.shaderStorageBufferArrayDynamicIndexing = supportedFeatures.shaderStorageBufferArrayDynamicIndexing;
+
+    // streamed textures come block compressed, those in formats the device cannot sample are skipped
+    enabledFeatures.textureCompressionBC = supportedFeatures.textureCompressionBC;
+    enabledFeatures.textureCompressionETC2 = supportedFeatures.textureCompressionETC2;
+    enabledFeatures.textureCompressionASTC_LDR = supportedFeatures.textureCompressionASTC_LDR;
+
+    // update after bind and partially bound arrays are core in 1.2 and an extension on 1.1 devices
+    auto properties = VkPhysicalDeviceProperties{};
+    vkGetPhysicalDeviceProperties(physicalDevice, &properties);
+
+    auto indexingFeatures = VkPhysicalDeviceDescriptorIndexingFeatures{};
+    indexingFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DESCRIPTOR_INDEXING_FEATURES;
+
+    auto indexingCore = properties.apiVersion >= VK_API_VERSION_1_2;
+    if (settings.descriptorIndexing && properties.apiVersion >= VK_API_VERSION_1_1 &&
+        (indexingCore || Vulkan::deviceSupportsExtensions(physicalDevice, {VK_EXT_DESCRIPTOR_INDEXING_EXTENSION_NAME}))) {
+        auto features = VkPhysicalDeviceFeatures2{};
+        features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
+        features.pNext = &indexingFeatures;
+        vkGetPhysicalDeviceFeatures2(physicalDevice, &features);
+
+        descriptorIndexing = indexingFeatures.descriptorBindingPartiallyBound && indexingFeatures.descriptorBindingUpdateUnusedWhilePending &&
+            indexingFeatures.descriptorBindingSampledImageUpdateAfterBind && indexingFeatures.descriptorBindingStorageBufferUpdateAfterBind;
+    }
+
+    // only what the bindless set uses is enabled
+    auto enabledIndexingFeatures = VkPhysicalDeviceDescriptorIndexingFeatures{};
+    enabledIndexingFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DESCRIPTOR_INDEXING_FEATURES;
+    enabledIndexingFeatures.descriptorBindingPartiallyBound = VK_TRUE;
+    enabledIndexingFeatures.descriptorBindingUpdateUnusedWhilePending = VK_TRUE;
+    enabledIndexingFeatures.descriptorBindingSampledImageUpdateAfterBind = VK_TRUE;
+    enabledIndexingFeatures.descriptorBindingStorageBufferUpdateAfterBind = VK_TRUE;
+
+    auto enabledFeatures2 = VkPhysicalDeviceFeatures2{};
+    enabledFeatures2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
+    enabledFeatures2.pNext = &enabledIndexingFeatures;
+    enabledFeatures2.features = enabledFeatures;
+
+    if (descriptorIndexing && !indexingCore)
+        extensions.push_back(VK_EXT_DESCRIPTOR_INDEXING_EXTENSION_NAME);
 
     auto deviceInfo = VkDeviceCreateInfo{};
     deviceInfo.sType = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO;
+    if (descriptorIndexing)
+        deviceInfo.pNext = &enabledFeatures2;
+    else
+        deviceInfo.pEnabledFeatures = &enabledFeatures;
     deviceInfo.queueCreateInfoCount = queueInfos.size();
     deviceInfo.pQueueCreateInfos = queueInfos.data();
     deviceInfo.enabledExtensionCount = static_cast<uint32_t>(extensions.size());
@@ -252,9 +448,11 @@ void GraphicsEngine::createDevice() {
 
     vkGetDeviceQueue(device, graphicsQueueIndex.value(), 0, &graphicsQueue);
     vkGetDeviceQueue(device, presentIndex.value(), 0, &presentQueue);
+    vkGetDeviceQueue(device, transferQueueIndex, transferQueueSlot, &transferQueue);
 }
 
 void GraphicsEngine::createSwapchain() {
+    PROFILE_SCOPE("GraphicsEngine::createSwapchain");
     auto capabilities = VkSurfaceCapabilitiesKHR{};
     if (vkGetPhysicalDeviceSurfaceCapabilitiesKHR(physicalDevice, surface, &capabilities) != VK_SUCCESS)
         throw std::runtime_error("Failed to get surface capabilites.");
@@ -290,14 +488,21 @@ void GraphicsEngine::createSwapchain() {
         throw std::runtime_error("Failed to get surface present modes.");
 
     auto presentMode = VkPresentModeKHR::VK_PRESENT_MODE_FIFO_KHR;
-    for (const auto& availablePresentMode : availablePresentModes)
-        if (availablePresentMode == VK_PRESENT_MODE_MAILBOX_KHR) {
-            presentMode = availablePresentMode;
-            break;
-        }
+    if (std::find(availablePresentModes.begin(), availablePresentModes.end(), settings.presentMode) != availablePresentModes.end())
+        presentMode = settings.presentMode;
+    else if (swapchain == VK_NULL_HANDLE)
+        std::cerr << "Present mode " << Vulkan::presentModeName(settings.presentMode) << " is not supported, falling back to FIFO." << std::endl;
+
+    // some platforms let the swapchain decide the extent
+    auto extent = capabilities.currentExtent;
+    if (extent.width == UINT32_MAX) {
+        auto width = 0;
+        auto height = 0;
+        glfwGetFramebufferSize(window, &width, &height);
 
-    if (surfaceFormat.format == VK_FORMAT_UNDEFINED)
-        throw std::runtime_error("Failed to find a suitable surface format.");
+        extent.width = std::clamp(static_cast<uint32_t>(width), capabilities.minImageExtent.width, capabilities.maxImageExtent.width);
+        extent.height = std::clamp(static_cast<uint32_t>(height), capabilities.minImageExtent.height, capabilities.maxImageExtent.height);
+    }
 
     auto swapchainInfo = VkSwapchainCreateInfoKHR{};
     swapchainInfo.sType = VK_STRUCTURE_TYPE_SWAPCHAIN_CREATE_INFO_KHR;
@@ -305,7 +510,7 @@ void GraphicsEngine::createSwapchain() {
     swapchainInfo.minImageCount = imageCount;
     swapchainInfo.imageFormat = surfaceFormat.format;
     swapchainInfo.imageColorSpace = surfaceFormat.colorSpace;
-    swapchainInfo.imageExtent = capabilities.currentExtent;
+    swapchainInfo.imageExtent = extent;
     swapchainInfo.imageArrayLayers = 1;
     swapchainInfo.imageUsage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT;
     swapchainInfo.imageSharingMode = VK_SHARING_MODE_EXCLUSIVE;
@@ -313,6 +518,8 @@ void GraphicsEngine::createSwapchain() {
     swapchainInfo.compositeAlpha = VK_COMPOSITE_ALPHA_OPAQUE_BIT_KHR;
     swapchainInfo.presentMode = presentMode;
     swapchainInfo.clipped = VK_TRUE;
+    // lets the driver reuse resources of the swapchain being replaced, if any
+    swapchainInfo.oldSwapchain = swapchain;
 
     if (vkCreateSwapchainKHR(device, &swapchainInfo, nullptr, &swapchain) != VK_SUCCESS)
         throw std::runtime_error("Failed to create swap chain.");
@@ -329,6 +536,7 @@ void GraphicsEngine::createSwapchain() {
     swapchainExtent = swapchainInfo.imageExtent;
 }
 void GraphicsEngine::recreateSwapchain() {
+    // a minimized window has nothing to present to
     auto width = 0;
     auto height = 0;
     glfwGetFramebufferSize(window, &width, &height);
@@ -337,26 +545,84 @@ void GraphicsEngine::recreateSwapchain() {
         glfwWaitEvents();
     }
 
-    vkDeviceWaitIdle(device);
+    framebufferResized = false;
 
-    cleanupSwapchain();
+    // frames in flight still render to and present the old images, they are released with those frames;
+    // the graph rebuilds its framebuffers and depth on the next frame, as the extent changed
+    renderGraph->releaseFramebuffers();
+    retire([device = device, swapchain = swapchain, imageViews = swapchainImageViews]() {
+        for (auto imageView : imageViews)
+            vkDestroyImageView(device, imageView, nullptr);
+
+        vkDestroySwapchainKHR(device, swapchain, nullptr);
+    });
 
     createSwapchain();
     createImageViews();
-    createFramebuffers();
 }
 
 void GraphicsEngine::cleanupSwapchain() {
-    for (auto framebuffer : swapchainFramebuffers)
-        vkDestroyFramebuffer(device, framebuffer, nullptr);
-
     for (auto imageView : swapchainImageViews)
         vkDestroyImageView(device, imageView, nullptr);
 
-    vkDestroySwapchainKHR(device, swapchain, nullptr);
+    if (settings.headless) {
+        for (auto& image : offscreenImages)
+            memoryAllocator->destroyImage(image);
+
+        offscreenImages.clear();
+    }
+    else
+        vkDestroySwapchainKHR(device, swapchain, nullptr);
+}
+
+void GraphicsEngine::createOffscreenImages() {
+    const std::vector<VkFormat> candidateFormats = {
+        VK_FORMAT_B8G8R8A8_SRGB,
+        VK_FORMAT_R8G8B8A8_SRGB,
+        VK_FORMAT_B8G8R8A8_UNORM,
+        VK_FORMAT_R8G8B8A8_UNORM,
+    };
+
+    swapchainImageFormat = VK_FORMAT_UNDEFINED;
+    for (auto format : candidateFormats) {
+        VkFormatProperties formatProperties;
+        vkGetPhysicalDeviceFormatProperties(physicalDevice, format, &formatProperties);
+
+        if (formatProperties.optimalTilingFeatures & VK_FORMAT_FEATURE_COLOR_ATTACHMENT_BIT) {
+            swapchainImageFormat = format;
+            break;
+        }
+    }
+
+    if (swapchainImageFormat == VK_FORMAT_UNDEFINED)
+        throw std::runtime_error("Failed to find a suitable offscreen format.");
+
+    swapchainExtent = {settings.width, settings.height};
+
+    swapchainImages.resize(maxFramesInFlight);
+    offscreenImages.resize(maxFramesInFlight);
+
+    for (auto i = 0; i < maxFramesInFlight; i++) {
+        auto imageInfo = VkImageCreateInfo{};
+        imageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+        imageInfo.imageType = VK_IMAGE_TYPE_2D;
+        imageInfo.format = swapchainImageFormat;
+        imageInfo.extent = {swapchainExtent.width, swapchainExtent.height, 1};
+        imageInfo.mipLevels = 1;
+        imageInfo.arrayLayers = 1;
+        imageInfo.samples = VK_SAMPLE_COUNT_1_BIT;
+        imageInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+        imageInfo.usage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT;
+        imageInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+        imageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+
+        offscreenImages[i] = memoryAllocator->createImage(imageInfo, MemoryUsage::GpuOnly);
+        swapchainImages[i] = offscreenImages[i].image;
+    }
 }
 
 void GraphicsEngine::createImageViews() {
+    PROFILE_SCOPE("GraphicsEngine::createImageViews");
     swapchainImageViews.resize(swapchainImages.size());
 
     for (auto i = 0; i < swapchainImages.size(); i++) {
@@ -376,247 +642,240 @@ void GraphicsEngine::createImageViews() {
     }
 }
 
-void GraphicsEngine::createRenderPass() {
-    auto attachmentDescription = VkAttachmentDescription{};
-    attachmentDescription.format = swapchainImageFormat;
-    attachmentDescription.samples = VK_SAMPLE_COUNT_1_BIT;
-    attachmentDescription.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
-    attachmentDescription.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
-    attachmentDescription.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
-    attachmentDescription.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
-    attachmentDescription.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
-    attachmentDescription.finalLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
-
-    auto colorAttachmentRef = VkAttachmentReference{};
-    colorAttachmentRef.attachment = 0;
-    colorAttachmentRef.layout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
-
-    auto subpass = VkSubpassDescription{};
-    subpass.pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
-    subpass.colorAttachmentCount = 1;
-    subpass.pColorAttachments = &colorAttachmentRef;
-
-    auto dependency = VkSubpassDependency{};
-    dependency.srcSubpass = VK_SUBPASS_EXTERNAL;
-    dependency.dstSubpass = 0;
-    dependency.srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
-    dependency.dstStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
-    dependency.srcAccessMask = 0;
-    dependency.dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
-
-    auto renderPassInfo = VkRenderPassCreateInfo{};
-    renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO;
-    renderPassInfo.attachmentCount = 1;
-    renderPassInfo.pAttachments = &attachmentDescription;
-    renderPassInfo.subpassCount = 1;
-    renderPassInfo.pSubpasses = &subpass;
-    renderPassInfo.dependencyCount =1;
-    renderPassInfo.pDependencies = &dependency;
-
-    if (vkCreateRenderPass(device, &renderPassInfo, nullptr, &renderPass) !=  VK_SUCCESS)
-        throw std::runtime_error("Failed to create render pass.");
-}
-
-void GraphicsEngine::createGraphicsPipeline(VkPipelineLayout& layout, VkPipeline& pipeline) {
-    // TODO: turn into a function for hot reloading shaders...
-    const char* command = "C:/VulkanSDK/1.3.261.1/Bin/glslc.exe shaders/shader.vert -o build/shader.vert.spv";
-    if (std::system(command) != 0)
-        throw std::runtime_error("Failed to build the shader.");
-        
-    auto vertShaderCode = Utilities::readFile("build/shader.vert.spv");
-
-    auto shaderModuleInfo = VkShaderModuleCreateInfo{};
-    shaderModuleInfo.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
-    shaderModuleInfo.codeSize = vertShaderCode.size();
-    shaderModuleInfo.pCode = reinterpret_cast<const uint32_t*>(vertShaderCode.data());
-
-    VkShaderModule shaderModule;
-    if (vkCreateShaderModule(device, &shaderModuleInfo, nullptr, &shaderModule) != VK_SUCCESS)
-        throw std::runtime_error("Failed to create shader module.");
-
-    auto pipelineShaderStageInfo = VkPipelineShaderStageCreateInfo{};
-    pipelineShaderStageInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
-    pipelineShaderStageInfo.stage = VK_SHADER_STAGE_VERTEX_BIT;
-    pipelineShaderStageInfo.module = shaderModule;
-    pipelineShaderStageInfo.pName = "main";
-
-    // TODO: turn into a function for hot reloading shaders...
-    command = "C:/VulkanSDK/1.3.261.1/Bin/glslc.exe shaders/shader.frag -o build/shader.frag.spv";
-    if (std::system(command) != 0)
-        throw std::runtime_error("Failed to build the shader.");
-        
-    auto fragShaderCode = Utilities::readFile("build/shader.frag.spv");
+void GraphicsEngine::pickDepthFormat() {
+    // the culling pass samples the depth to build its pyramid
+    const std::vector<VkFormat> candidateFormats = {VK_FORMAT_D32_SFLOAT, VK_FORMAT_D16_UNORM};
+    const auto requiredFeatures = VK_FORMAT_FEATURE_DEPTH_STENCIL_ATTACHMENT_BIT | VK_FORMAT_FEATURE_SAMPLED_IMAGE_BIT;
 
-    auto fShaderModuleInfo = VkShaderModuleCreateInfo{};
-    fShaderModuleInfo.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
-    fShaderModuleInfo.codeSize = fragShaderCode.size();
-    fShaderModuleInfo.pCode = reinterpret_cast<const uint32_t*>(fragShaderCode.data());
+    depthFormat = VK_FORMAT_UNDEFINED;
+    for (auto format : candidateFormats) {
+        VkFormatProperties formatProperties;
+        vkGetPhysicalDeviceFormatProperties(physicalDevice, format, &formatProperties);
 
-    VkShaderModule fshaderModule;
-    if (vkCreateShaderModule(device, &fShaderModuleInfo, nullptr, &fshaderModule) != VK_SUCCESS)
-        throw std::runtime_error("Failed to create shader module.");
+        if ((formatProperties.optimalTilingFeatures & requiredFeatures) == requiredFeatures) {
+            depthFormat = format;
+            break;
+        }
+    }
 
-    auto fpipelineShaderStageInfo = VkPipelineShaderStageCreateInfo{};
-    fpipelineShaderStageInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
-    fpipelineShaderStageInfo.stage = VK_SHADER_STAGE_FRAGMENT_BIT;
-    fpipelineShaderStageInfo.module = fshaderModule;
-    fpipelineShaderStageInfo.pName = "main";
+    if (depthFormat == VK_FORMAT_UNDEFINED)
+        throw std::runtime_error("Failed to find a suitable depth format.");
+}
 
-    VkPipelineShaderStageCreateInfo shaderStages[] = { pipelineShaderStageInfo, fpipelineShaderStageInfo };
+void GraphicsEngine::createPipelineCache() {
+    PROFILE_SCOPE("GraphicsEngine::createPipelineCache");
+    // an unreadable cache only costs a cold start
+    std::vector<char> cacheData;
+    if (pipelineCacheFile.valid()) {
+        try {
+            cacheData = Vulkan::parsePipelineCacheData(physicalDevice, pipelineCacheFile.get());
+        }
+        catch (const std::exception& exception) {
+            std::cerr << "Failed to load pipeline cache: " << exception.what() << std::endl;
+        }
+    }
 
-    auto vertexInputInfo = VkPipelineVertexInputStateCreateInfo{};
-    vertexInputInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
-    vertexInputInfo.vertexBindingDescriptionCount = 0;
-    vertexInputInfo.vertexAttributeDescriptionCount = 0;
+    pipelineCacheWarm = !cacheData.empty();
 
-    auto inputAssemblyInfo = VkPipelineInputAssemblyStateCreateInfo{};
-    inputAssemblyInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO;
-    inputAssemblyInfo.topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST;
+    auto pipelineCacheInfo = VkPipelineCacheCreateInfo{};
+    pipelineCacheInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO;
+    pipelineCacheInfo.initialDataSize = cacheData.size();
+    pipelineCacheInfo.pInitialData = cacheData.data();
 
-    auto viewport = VkViewport{};
-    viewport.x = 0;
-    viewport.y = 0;
-    viewport.width = swapchainExtent.width;
-    viewport.height = swapchainExtent.height;
-    viewport.minDepth = 0;
-    viewport.maxDepth = 0;
+    if (vkCreatePipelineCache(device, &pipelineCacheInfo, nullptr, &pipelineCache) != VK_SUCCESS)
+        throw std::runtime_error("Failed to create pipeline cache.");
+}
 
-    auto scissor = VkRect2D{};
-    scissor.offset = {0, 0};
-    scissor.extent = swapchainExtent;
-
-    auto viewportStateInfo = VkPipelineViewportStateCreateInfo{};
-    viewportStateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO;
-    viewportStateInfo.viewportCount = 1;
-    viewportStateInfo.pViewports = &viewport;
-    viewportStateInfo.scissorCount = 1;
-    viewportStateInfo.pScissors = &scissor;
-
-    auto rasterizerInfo = VkPipelineRasterizationStateCreateInfo{};
-    rasterizerInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_RASTERIZATION_STATE_CREATE_INFO;
-    rasterizerInfo.depthClampEnable = VK_FALSE;
-    rasterizerInfo.rasterizerDiscardEnable = VK_FALSE; // disables output to framebuffer if set to true
-    rasterizerInfo.polygonMode = VK_POLYGON_MODE_FILL;
-    rasterizerInfo.cullMode = VK_CULL_MODE_BACK_BIT;
-    rasterizerInfo.frontFace = VK_FRONT_FACE_CLOCKWISE;
-    rasterizerInfo.depthBiasEnable = VK_FALSE;
-    rasterizerInfo.lineWidth = 1;
-
-    auto multisampleInfo = VkPipelineMultisampleStateCreateInfo{};
-    multisampleInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_MULTISAMPLE_STATE_CREATE_INFO;
-    multisampleInfo.rasterizationSamples = VK_SAMPLE_COUNT_1_BIT;
-    multisampleInfo.sampleShadingEnable = VK_FALSE;
-
-    auto colorBlendAttachmentState = VkPipelineColorBlendAttachmentState{};
-    colorBlendAttachmentState.blendEnable = VK_FALSE;
-    colorBlendAttachmentState.colorWriteMask = VK_COLOR_COMPONENT_R_BIT | VK_COLOR_COMPONENT_G_BIT | VK_COLOR_COMPONENT_B_BIT | VK_COLOR_COMPONENT_A_BIT;
-
-    auto colorBlendState = VkPipelineColorBlendStateCreateInfo{};
-    colorBlendState.sType = VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO;
-    colorBlendState.logicOpEnable = VK_FALSE;
-    colorBlendState.attachmentCount = 1;
-    colorBlendState.pAttachments = &colorBlendAttachmentState;
-
-    auto pipelineLayoutInfo = VkPipelineLayoutCreateInfo{};
-    pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
-
-    if (vkCreatePipelineLayout(device, &pipelineLayoutInfo, nullptr, &layout) != VK_SUCCESS)
-        throw std::runtime_error("Failed to create pipeline layout.");
-
-    auto pipelineInfo = VkGraphicsPipelineCreateInfo{};
-    pipelineInfo.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
-    pipelineInfo.stageCount = 2;
-    pipelineInfo.pStages = shaderStages;
-    pipelineInfo.pVertexInputState = &vertexInputInfo;
-    pipelineInfo.pInputAssemblyState = &inputAssemblyInfo;
-    pipelineInfo.pViewportState = &viewportStateInfo;
-    pipelineInfo.pRasterizationState = &rasterizerInfo;
-    pipelineInfo.pMultisampleState = &multisampleInfo;
-    pipelineInfo.pColorBlendState = &colorBlendState;
-    pipelineInfo.layout = pipelineLayout;
-    pipelineInfo.renderPass = renderPass;
-
-    if (vkCreateGraphicsPipelines(device, VK_NULL_HANDLE, 1, &pipelineInfo, nullptr, &pipeline) != VK_SUCCESS)
-        throw std::runtime_error("Failed to create graphics pipeline.");
-
-    vkDestroyShaderModule(device, shaderModule, nullptr);
-    vkDestroyShaderModule(device, fshaderModule, nullptr);
-}
-
-void GraphicsEngine::createFramebuffers() {
-    swapchainFramebuffers.resize(swapchainImageViews.size());
-
-    for (auto i = 0; i < swapchainImageViews.size(); i++) {
-        VkImageView imageViews[] = { swapchainImageViews[i] };
-
-        auto framebufferInfo = VkFramebufferCreateInfo{};
-        framebufferInfo.sType = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO;
-        framebufferInfo.renderPass = renderPass;
-        framebufferInfo.attachmentCount = 1;
-        framebufferInfo.pAttachments = imageViews;
-        framebufferInfo.width = swapchainExtent.width;
-        framebufferInfo.height = swapchainExtent.height;
-        framebufferInfo.layers = 1;
-
-        if (vkCreateFramebuffer(device, &framebufferInfo, nullptr, &swapchainFramebuffers[i]) != VK_SUCCESS)
-            throw std::runtime_error("Failed to create framebuffer.");
+void GraphicsEngine::destroyPipelineCache() {
+    // a failed save only costs the next startup a cold cache
+    if (!settings.pipelineCachePath.empty()) {
+        try {
+            Vulkan::savePipelineCacheData(physicalDevice, device, pipelineCache, settings.pipelineCachePath);
+        }
+        catch (const std::exception& exception) {
+            std::cerr << "Failed to save pipeline cache: " << exception.what() << std::endl;
+        }
     }
+
+    vkDestroyPipelineCache(device, pipelineCache, nullptr);
 }
 
 void GraphicsEngine::createCommandPool() {
     auto commandPoolInfo = VkCommandPoolCreateInfo{};
     commandPoolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
-    commandPoolInfo.flags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT;
+    commandPoolInfo.flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT;
     commandPoolInfo.queueFamilyIndex = graphicsQueueIndex.value();
 
     if (vkCreateCommandPool(device, &commandPoolInfo, nullptr, &commandPool) != VK_SUCCESS)
         throw std::runtime_error("Failed to create command pool.");
+
+    frameCommands.resize(maxFramesInFlight);
+    for (auto& commands : frameCommands) {
+        commands.pools.resize(jobSystem->threadCount());
+        for (auto& pool : commands.pools)
+            if (vkCreateCommandPool(device, &commandPoolInfo, nullptr, &pool) != VK_SUCCESS)
+                throw std::runtime_error("Failed to create command pool.");
+    }
 }
 
 void GraphicsEngine::createCommandBuffer() {
-    commandBuffers.resize(maxFramesInFlight);
-
-    auto allocateInfo = VkCommandBufferAllocateInfo{};
-    allocateInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
-    allocateInfo.commandPool = commandPool;
-    allocateInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
-    allocateInfo.commandBufferCount = commandBuffers.size();
-
-    if (vkAllocateCommandBuffers(device, &allocateInfo, commandBuffers.data()) != VK_SUCCESS)
-        throw std::runtime_error("Failed to allocate command buffer.");
+    PROFILE_SCOPE("GraphicsEngine::createCommandBuffer");
+    for (auto& commands : frameCommands) {
+        auto allocateInfo = VkCommandBufferAllocateInfo{};
+        allocateInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+        allocateInfo.commandPool = commands.pools[0];
+        allocateInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+        allocateInfo.commandBufferCount = 1;
+
+        if (vkAllocateCommandBuffers(device, &allocateInfo, &commands.primary) != VK_SUCCESS)
+            throw std::runtime_error("Failed to allocate command buffer.");
+
+        commands.secondaries.resize(commands.pools.size());
+        for (auto i = 0; i < commands.pools.size(); i++) {
+            allocateInfo.commandPool = commands.pools[i];
+            allocateInfo.level = VK_COMMAND_BUFFER_LEVEL_SECONDARY;
+
+            if (vkAllocateCommandBuffers(device, &allocateInfo, &commands.secondaries[i]) != VK_SUCCESS)
+                throw std::runtime_error("Failed to allocate secondary command buffer.");
+        }
+    }
 }
 
 void GraphicsEngine::recordCommandBuffer(VkCommandBuffer commandBuffer, uint32_t imageIndex) {
+    PROFILE_SCOPE("GraphicsEngine::recordCommandBuffer");
     auto commandBufferBeginInfo = VkCommandBufferBeginInfo{};
     commandBufferBeginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
 
     if (vkBeginCommandBuffer(commandBuffer, &commandBufferBeginInfo) != VK_SUCCESS)
         throw std::runtime_error("Failed to begin command buffer.");
 
-    auto clearValue = VkClearValue{{{0.0f, 0.0f, 0.0f}}};
+    // this command buffer is submitted as frame number frameNumber + 1
+    uploadWaitSemaphores.clear();
+    uploadWaitStages.clear();
+    uploadManager->acquire(commandBuffer, frameNumber + 1, uploadWaitSemaphores, uploadWaitStages);
+
+    buildFrameGraph(imageIndex);
+    renderGraph->execute(commandBuffer);
+
+    if (vkEndCommandBuffer(commandBuffer) != VK_SUCCESS)
+        throw std::runtime_error("Failed to end command buffer.");
+}
+
+void GraphicsEngine::buildFrameGraph(uint32_t imageIndex) {
+    renderGraph->reset();
+
+    // the target comes in straight from acquire and leaves for presentation, or for readFrame when headless
+    auto targetFinal = settings.headless
+        ? ResourceState{VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_TRANSFER_READ_BIT, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL}
+        : ResourceState{VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, 0, VK_IMAGE_LAYOUT_PRESENT_SRC_KHR};
+    auto target = renderGraph->importImage("target", swapchainImages[imageIndex], swapchainImageViews[imageIndex], swapchainImageFormat,
+        swapchainExtent, VK_IMAGE_ASPECT_COLOR_BIT, {VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT, 0, VK_IMAGE_LAYOUT_UNDEFINED}, targetFinal);
+    auto depth = renderGraph->createImage("depth", {depthFormat, swapchainExtent, VK_IMAGE_ASPECT_DEPTH_BIT});
+
+    // the frame's fence already keeps each frame in flight off the others' draw buffers
+    auto drawBuffers = culling ? culling->getDrawBuffers(currentFrame) : drawBatcher->getDrawBuffers();
+    auto commands = renderGraph->importBuffer("commands", drawBuffers.commands);
+    auto instances = renderGraph->importBuffer("instances", drawBuffers.instances);
+
+    if (culling)
+        renderGraph->addComputePass("cull", [&](RenderGraph::PassBuilder& pass) {
+            pass.write(commands, {VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_WRITE_BIT});
+            pass.write(instances, {VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_WRITE_BIT});
+        }, [this](VkCommandBuffer commandBuffer, const RenderPassContext&) {
+            culling->recordCull(commandBuffer, currentFrame, *drawBatcher, viewProjection);
+        });
+
+    renderGraph->addGraphicsPass("scene", [&](RenderGraph::PassBuilder& pass) {
+        pass.colorAttachment(target, VkClearColorValue{{0.0f, 0.0f, 0.0f, 1.0f}});
+        pass.depthAttachment(depth, VkClearDepthStencilValue{1.0f, 0});
+        pass.read(commands, {VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT, VK_ACCESS_INDIRECT_COMMAND_READ_BIT});
+        pass.read(instances, {VK_PIPELINE_STAGE_VERTEX_INPUT_BIT, VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT});
+        pass.secondaryCommandBuffers();
+    }, [this](VkCommandBuffer commandBuffer, const RenderPassContext& context) {
+        // each slice of the indirect commands goes to its own secondary, recorded from its own pool
+        auto& commands = frameCommands[currentFrame];
+        auto drawCount = drawBatcher->getCommandCount();
+        auto sliceCount = std::min(static_cast<uint32_t>(commands.secondaries.size()),
+            std::max(1u, (drawCount + minDrawsPerRecordingThread - 1) / minDrawsPerRecordingThread));
+
+        jobSystem->parallelFor(sliceCount, [&](uint32_t slice) {
+            auto firstDraw = static_cast<uint64_t>(drawCount) * slice / sliceCount;
+            auto lastDraw = static_cast<uint64_t>(drawCount) * (slice + 1) / sliceCount;
+            recordDraws(commands.secondaries[slice], context, static_cast<uint32_t>(firstDraw), static_cast<uint32_t>(lastDraw - firstDraw));
+        });
+
+        vkCmdExecuteCommands(commandBuffer, sliceCount, commands.secondaries.data());
+    });
+
+    // the pyramid is only read by the next frame's cull, outside the graph
+    if (culling)
+        renderGraph->addComputePass("depthPyramid", [&](RenderGraph::PassBuilder& pass) {
+            pass.read(depth, {VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT, VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL});
+            pass.sideEffects();
+        }, [this](VkCommandBuffer commandBuffer, const RenderPassContext&) {
+            culling->recordDepthPyramid(commandBuffer);
+        });
+
+    renderGraph->compile();
+
+    auto depthView = renderGraph->getImageView(depth);
+    if (culling && depthView != cullingDepthView)
+        culling->resize(swapchainExtent, depthView);
+    cullingDepthView = depthView;
+
+    sceneMaterial.renderPass = renderGraph->getRenderPass("scene");
+}
+
+void GraphicsEngine::recordDraws(VkCommandBuffer commandBuffer, const RenderPassContext& context, uint32_t firstCommand, uint32_t commandCount) {
+    PROFILE_SCOPE("GraphicsEngine::recordDraws");
+    auto inheritanceInfo = VkCommandBufferInheritanceInfo{};
+    inheritanceInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_INHERITANCE_INFO;
+    inheritanceInfo.renderPass = context.renderPass;
+    inheritanceInfo.subpass = 0;
+    inheritanceInfo.framebuffer = context.framebuffer;
 
-    auto renderPassBeginInfo = VkRenderPassBeginInfo{};
-    renderPassBeginInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
-    renderPassBeginInfo.renderPass = renderPass;
-    renderPassBeginInfo.framebuffer = swapchainFramebuffers[imageIndex];
-    renderPassBeginInfo.renderArea.offset = {0, 0};
-    renderPassBeginInfo.renderArea.extent = swapchainExtent;
-    renderPassBeginInfo.clearValueCount = 1;
-    renderPassBeginInfo.pClearValues = &clearValue;
+    auto commandBufferBeginInfo = VkCommandBufferBeginInfo{};
+    commandBufferBeginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+    commandBufferBeginInfo.flags = VK_COMMAND_BUFFER_USAGE_RENDER_PASS_CONTINUE_BIT | VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+    commandBufferBeginInfo.pInheritanceInfo = &inheritanceInfo;
 
-    vkCmdBeginRenderPass(commandBuffer, &renderPassBeginInfo, VK_SUBPASS_CONTENTS_INLINE);
+    if (vkBeginCommandBuffer(commandBuffer, &commandBufferBeginInfo) != VK_SUCCESS)
+        throw std::runtime_error("Failed to begin secondary command buffer.");
+
+    vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLibrary->get(sceneMaterial));
+
+    // secondaries inherit no state from the primary, dynamic state included
+    auto viewport = VkViewport{};
+    viewport.x = 0;
+    viewport.y = 0;
+    viewport.width = context.extent.width;
+    viewport.height = context.extent.height;
+    viewport.minDepth = 0;
+    viewport.maxDepth = 1;
+    vkCmdSetViewport(commandBuffer, 0, 1, &viewport);
+
+    auto scissor = VkRect2D{};
+    scissor.offset = {0, 0};
+    scissor.extent = context.extent;
+    vkCmdSetScissor(commandBuffer, 0, 1, &scissor);
 
-    vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, graphicsPipeline);
+    // the one descriptor set of the frame, draws only ever differ in the indices they push
+    vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLibrary->getLayout(), 0, 1, &frameDescriptorSet, 0, nullptr);
 
-    vkCmdDraw(commandBuffer, 3, 1, 0, 0);
+    auto constants = DrawConstants{};
+    std::copy(std::begin(viewProjection), std::end(viewProjection), constants.viewProjection);
+    constants.textureIndex = sceneTextureIndex;
+    vkCmdPushConstants(commandBuffer, pipelineLibrary->getLayout(), VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT, 0, sizeof(constants), &constants);
 
-    vkCmdEndRenderPass(commandBuffer);
+    auto drawBuffers = culling ? culling->getDrawBuffers(currentFrame) : drawBatcher->getDrawBuffers();
+    drawBatcher->record(commandBuffer, *meshPool, drawBuffers, firstCommand, commandCount);
 
     if (vkEndCommandBuffer(commandBuffer) != VK_SUCCESS)
-        throw std::runtime_error("Failed to end command buffer.");
+        throw std::runtime_error("Failed to end secondary command buffer.");
 }
 
 void GraphicsEngine::createSyncObjects() {
+    frameSlotNumbers.resize(maxFramesInFlight, 0);
     imageAvailableSemaphores.resize(maxFramesInFlight);
     renderFinishedSemaphores.resize(maxFramesInFlight);
     inFlightFences.resize(maxFramesInFlight);
@@ -635,90 +894,535 @@ void GraphicsEngine::createSyncObjects() {
             throw std::runtime_error("Failed to create sync objects.");
 }
 
-void GraphicsEngine::mainLoop() {
-    while (!glfwWindowShouldClose(window)) {
+void GraphicsEngine::createBindlessDescriptors() {
+    PROFILE_SCOPE("GraphicsEngine::createBindlessDescriptors");
+    auto properties = VkPhysicalDeviceProperties{};
+    vkGetPhysicalDeviceProperties(physicalDevice, &properties);
+
+    // the non update-after-bind limits are the lower ones, and hold for the fallback as well;
+    // without dynamic indexing a shader can only ever reach element 0
+    auto supportedFeatures = VkPhysicalDeviceFeatures{};
+    vkGetPhysicalDeviceFeatures(physicalDevice, &supportedFeatures);
+
+    const uint32_t textureCapacity = 1024;
+    const uint32_t bufferCapacity = 256;
+    auto& limits = properties.limits;
+    auto textures = supportedFeatures.shaderSampledImageArrayDynamicIndexing
+        ? std::min({textureCapacity, limits.maxPerStageDescriptorSamplers, limits.maxPerStageDescriptorSampledImages}) : 1;
+    auto buffers = supportedFeatures.shaderStorageBufferArrayDynamicIndexing
+        ? std::min(bufferCapacity, limits.maxPerStageDescriptorStorageBuffers) : 1;
+
+    bindless = std::make_unique<BindlessDescriptors>(device, descriptorIndexing, textures, buffers, maxFramesInFlight,
+        [this](std::function<void()> deleter) { retire(std::move(deleter)); });
+
+    std::cout << "Bindless descriptors: " << textures << " textures, " << buffers << " buffers, "
+        << (descriptorIndexing ? "update after bind" : "rewritten per frame") << std::endl;
+}
+
+void GraphicsEngine::openAssetArchive() {
+    PROFILE_SCOPE("GraphicsEngine::openAssetArchive");
+    if (settings.assetArchivePath.empty() || !std::filesystem::exists(settings.assetArchivePath))
+        return;
+
+    // a stale or broken archive is not fatal, the loose files are still there
+    try {
+        assetArchive = std::make_unique<AssetArchive>(settings.assetArchivePath);
+        std::cout << "Asset archive: " << assetArchive->size() << " assets in " << settings.assetArchivePath << std::endl;
+    }
+    catch (const std::exception& exception) {
+        std::cerr << "Ignoring the asset archive: " << exception.what() << std::endl;
+    }
+}
 
-        // TODO: refactor shader hot reloading
-        if (swapGraphicsPipeline != VK_NULL_HANDLE) {
-            vkWaitForFences(device, inFlightFences.size(), inFlightFences.data(), VK_TRUE, UINT64_MAX);
+void GraphicsEngine::createFrameAllocator() {
+    auto properties = VkPhysicalDeviceProperties{};
+    vkGetPhysicalDeviceProperties(physicalDevice, &properties);
+
+    frameAllocator = std::make_unique<FrameAllocator>(*memoryAllocator, properties.limits, maxFramesInFlight);
+}
 
-            vkDestroyPipeline(device, graphicsPipeline, nullptr);
-            vkDestroyPipelineLayout(device, pipelineLayout, nullptr);
+void GraphicsEngine::createTestScene() {
+    PROFILE_SCOPE("GraphicsEngine::createTestScene");
+    auto properties = VkPhysicalDeviceProperties{};
+    vkGetPhysicalDeviceProperties(physicalDevice, &properties);
 
-            pipelineLayout = swapPipelineLayout;
-            graphicsPipeline = swapGraphicsPipeline;
+    drawBatcher = std::make_unique<DrawBatcher>(*frameAllocator, multiDrawIndirect, drawIndirectFirstInstance,
+        multiDrawIndirect ? properties.limits.maxDrawIndirectCount : 1);
 
-            swapPipelineLayout = VK_NULL_HANDLE;
-            swapGraphicsPipeline = VK_NULL_HANDLE;
+    std::vector<Vertex> vertices = {
+        {{0.0f, -0.5f, 0.0f}, {1.0f, 0.0f, 0.0f}},
+        {{0.5f, 0.5f, 0.0f}, {0.0f, 1.0f, 0.0f}},
+        {{-0.5f, 0.5f, 0.0f}, {0.0f, 0.0f, 1.0f}},
+    };
+    testMesh = meshPool->addMesh(vertices, {0, 1, 2});
+
+    // a checkerboard, the first texture, which is also what empty slots read without descriptor indexing
+    const uint32_t textureSize = 64;
+    const uint32_t squareSize = 8;
+    std::vector<uint8_t> texels(textureSize * textureSize * 4);
+    for (uint32_t y = 0; y < textureSize; y++)
+        for (uint32_t x = 0; x < textureSize; x++) {
+            auto value = ((x / squareSize + y / squareSize) % 2) ? 255 : 160;
+            auto texel = &texels[(y * textureSize + x) * 4];
+            texel[0] = texel[1] = texel[2] = static_cast<uint8_t>(value);
+            texel[3] = 255;
         }
 
-        glfwPollEvents();
-        drawFrame();
+    auto imageInfo = VkImageCreateInfo{};
+    imageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+    imageInfo.imageType = VK_IMAGE_TYPE_2D;
+    imageInfo.format = VK_FORMAT_R8G8B8A8_UNORM;
+    imageInfo.extent = {textureSize, textureSize, 1};
+    imageInfo.mipLevels = 1;
+    imageInfo.arrayLayers = 1;
+    imageInfo.samples = VK_SAMPLE_COUNT_1_BIT;
+    imageInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+    imageInfo.usage = VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT;
+    imageInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+    imageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+
+    testTexture = memoryAllocator->createImage(imageInfo, MemoryUsage::GpuOnly);
+    uploadManager->uploadImage(testTexture.image, VK_IMAGE_ASPECT_COLOR_BIT, 0, imageInfo.extent, texels.data(), texels.size(),
+        VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT);
+
+    auto imageViewInfo = VkImageViewCreateInfo{};
+    imageViewInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+    imageViewInfo.image = testTexture.image;
+    imageViewInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
+    imageViewInfo.format = imageInfo.format;
+    imageViewInfo.subresourceRange = {VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1};
+
+    if (vkCreateImageView(device, &imageViewInfo, nullptr, &testTextureView) != VK_SUCCESS)
+        throw std::runtime_error("Failed to create test texture view.");
+
+    auto samplerInfo = VkSamplerCreateInfo{};
+    samplerInfo.sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO;
+    samplerInfo.magFilter = VK_FILTER_NEAREST;
+    samplerInfo.minFilter = VK_FILTER_NEAREST;
+    samplerInfo.mipmapMode = VK_SAMPLER_MIPMAP_MODE_NEAREST;
+    samplerInfo.addressModeU = VK_SAMPLER_ADDRESS_MODE_REPEAT;
+    samplerInfo.addressModeV = VK_SAMPLER_ADDRESS_MODE_REPEAT;
+    samplerInfo.addressModeW = VK_SAMPLER_ADDRESS_MODE_REPEAT;
+    samplerInfo.maxLod = VK_LOD_CLAMP_NONE;
+
+    if (vkCreateSampler(device, &samplerInfo, nullptr, &testSampler) != VK_SUCCESS)
+        throw std::runtime_error("Failed to create test sampler.");
+
+    testTextureIndex = bindless->addTexture(testTextureView, testSampler);
+    sceneTextureIndex = testTextureIndex;
+
+    textureStreamer = std::make_unique<TextureStreamer>(device, physicalDevice, *memoryAllocator, *uploadManager, *bindless, *jobSystem, *fileReader,
+        assetArchive.get(), testTextureIndex, settings.textureBudget, [this](std::function<void()> deleter) { retire(std::move(deleter)); });
+    // only the header is read here, the levels stream in over the first frames
+    if (!settings.texturePath.empty() && ((assetArchive && assetArchive->find(settings.texturePath)) || std::filesystem::exists(settings.texturePath)))
+        sceneTexture = textureStreamer->load(settings.texturePath);
+}
+
+void GraphicsEngine::submitTestScene() {
+    PROFILE_SCOPE("GraphicsEngine::submitTestScene");
+    // render extraction: blended transforms go straight into the frame's instance buffer, in parallel chunks
+    auto state = simulation->acquire(Simulation::Clock::now());
+    drawBatcher->drawRange(testMesh, state.count, [this, state](InstanceData* instances) {
+        const uint32_t chunkSize = 4096;
+        auto chunkCount = (state.count + chunkSize - 1) / chunkSize;
+        std::vector<float> chunkScales(chunkCount, 0.0f);
+        jobSystem->parallelFor(chunkCount, [&](uint32_t chunk) {
+            for (auto i = chunk * chunkSize; i < std::min(state.count, (chunk + 1) * chunkSize); i++) {
+                const auto& from = state.previous[i];
+                const auto& to = state.current[i];
+
+                // the short way round, angles wrap at 2 pi
+                auto angle = from.angle + std::remainder(to.angle - from.angle, 6.28318530718f) * state.alpha;
+                auto scale = from.scale + (to.scale - from.scale) * state.alpha;
+                auto cosine = std::cos(angle) * scale;
+                auto sine = std::sin(angle) * scale;
+
+                // built in full and written once, the mapped memory may be uncached
+                auto instance = InstanceData{};
+                instance.model[0] = cosine;
+                instance.model[1] = sine;
+                instance.model[4] = -sine;
+                instance.model[5] = cosine;
+                instance.model[10] = 1.0f;
+                instance.model[12] = from.position[0] + (to.position[0] - from.position[0]) * state.alpha;
+                instance.model[13] = from.position[1] + (to.position[1] - from.position[1]) * state.alpha;
+                instance.model[15] = 1.0f;
+                instances[i] = instance;
+                chunkScales[chunk] = std::max(chunkScales[chunk], scale);
+            }
+        });
+
+        // the mesh spans one unit, half the clip space, and the texture spans the mesh once
+        if (sceneTexture) {
+            auto scale = chunkScales.empty() ? 0.0f : *std::max_element(chunkScales.begin(), chunkScales.end());
+            textureStreamer->requestSize(*sceneTexture, scale * std::max(swapchainExtent.width, swapchainExtent.height) / 2);
+        }
+    });
+
+    if (sceneTexture)
+        sceneTextureIndex = textureStreamer->getIndex(*sceneTexture);
+}
+
+bool GraphicsEngine::shouldClose() {
+    if (benchmark && benchmark->isDone())
+        return true;
+
+    if (settings.headless && !benchmark)
+        return frameNumber >= settings.headlessFrameCount;
+
+    return !settings.headless && glfwWindowShouldClose(window);
+}
+
+void GraphicsEngine::mainLoop() {
+    while (!shouldClose()) {
+        jobSystem->runMainThreadJobs();
+
+        // waiting for a free frame slot only after sampling input would age that input by the whole wait
+        auto slotWait = 0.0;
+        if (settings.justInTime) {
+            auto waitStart = std::chrono::steady_clock::now();
+            waitForFrameSlot();
+            slotWait = FrameBenchmark::elapsedMilliseconds(waitStart, std::chrono::steady_clock::now());
+        }
+        pollCompletedFrames();
+        auto pacingSleep = framePacer->beginFrame(frameNumber + 1);
+
+        if (!settings.headless)
+            glfwPollEvents();
+
+        auto drawnFrames = frameNumber;
+        drawFrame(slotWait);
+
+        frameTimings.pacingSleep = pacingSleep;
+        frameTimings.latency = framePacer->getLatency();
+
+        // frames dropped for a swapchain recreation have no meaningful timings
+        if (benchmark && frameNumber != drawnFrames)
+            benchmark->addFrame(frameTimings);
     }
 
     vkDeviceWaitIdle(device);
+
+    if (benchmark) {
+        benchmark->printSummary();
+        benchmark->writeCsv(settings.benchmarkReport + ".csv");
+        benchmark->writeJson(settings.benchmarkReport + ".json");
+    }
+
+    if (!settings.tracePath.empty()) {
+        #ifdef PROFILING_ENABLED
+            Profiler::writeChromeTrace(settings.tracePath);
+            std::cout << "Profiling trace written to " << settings.tracePath << std::endl;
+        #else
+            std::cerr << "Not writing " << settings.tracePath << ", profiling is compiled out, build with -DPROFILING_ENABLED." << std::endl;
+        #endif
+    }
 }
 
-void GraphicsEngine::drawFrame() {
+void GraphicsEngine::waitForFrameSlot() {
+    PROFILE_SCOPE("GraphicsEngine::waitForFrameSlot");
     vkWaitForFences(device, 1, &inFlightFences[currentFrame], VK_TRUE, UINT64_MAX);
 
-    uint32_t imageIndex;
+    // fences of a single queue signal in submission order, so every earlier frame is done as well
+    if (frameSlotNumbers[currentFrame] > completedFrameNumber) {
+        completedFrameNumber = frameSlotNumbers[currentFrame];
+        framePacer->frameCompleted(completedFrameNumber, FramePacer::Clock::now());
+    }
+}
+
+void GraphicsEngine::pollCompletedFrames() {
+    auto newestCompleted = completedFrameNumber;
+    for (auto i = 0; i < maxFramesInFlight; i++)
+        if (frameSlotNumbers[i] > newestCompleted && vkGetFenceStatus(device, inFlightFences[i]) == VK_SUCCESS)
+            newestCompleted = frameSlotNumbers[i];
+
+    if (newestCompleted > completedFrameNumber) {
+        completedFrameNumber = newestCompleted;
+        framePacer->frameCompleted(completedFrameNumber, FramePacer::Clock::now());
+    }
+}
+
+bool GraphicsEngine::acquireImage(uint32_t& imageIndex) {
+    PROFILE_SCOPE("GraphicsEngine::acquireImage");
+    // each frame in flight owns one offscreen image, which its fence already guards
+    if (settings.headless) {
+        imageIndex = currentFrame;
+        return true;
+    }
+
     auto result = vkAcquireNextImageKHR(device, swapchain, UINT64_MAX, imageAvailableSemaphores[currentFrame], VK_NULL_HANDLE, &imageIndex);
 
     if (result == VK_ERROR_OUT_OF_DATE_KHR) {
         recreateSwapchain();
-        return;
+        return false;
     }
 
     if (result != VK_SUCCESS && result != VK_SUBOPTIMAL_KHR)
         throw std::runtime_error("Failed to acquire next image.");
 
-    vkResetFences(device, 1, &inFlightFences[currentFrame]);
-
-    if (vkResetCommandBuffer(commandBuffers[currentFrame], 0) != VK_SUCCESS)
-        throw std::runtime_error("Failed to reset command buffer.");
-
-    recordCommandBuffer(commandBuffers[currentFrame], imageIndex);
-
-    VkSemaphore waitSemaphores[] = {imageAvailableSemaphores[currentFrame]};
-    VkSemaphore signalSemaphores[] = {renderFinishedSemaphores[currentFrame]};
+    return true;
+}
 
-    VkPipelineStageFlags waitStages[] = {VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT};
+void GraphicsEngine::presentImage(uint32_t imageIndex) {
+    PROFILE_SCOPE("GraphicsEngine::presentImage");
+    lastFrame = currentFrame;
+    lastImageIndex = imageIndex;
 
-    auto submitInfo = VkSubmitInfo{};
-    submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
-    submitInfo.waitSemaphoreCount = 1;
-    submitInfo.pWaitSemaphores = waitSemaphores;
-    submitInfo.pWaitDstStageMask = waitStages;
-    submitInfo.commandBufferCount = 1;
-    submitInfo.pCommandBuffers = &commandBuffers[currentFrame];
-    submitInfo.signalSemaphoreCount = 1;
-    submitInfo.pSignalSemaphores = signalSemaphores;
-
-    if (vkQueueSubmit(graphicsQueue, 1, &submitInfo, inFlightFences[currentFrame]) != VK_SUCCESS)
-        throw std::runtime_error("Failed to submit the command buffer to the queue.");
+    if (settings.headless)
+        return;
 
     VkSwapchainKHR swapchains[] = {swapchain};
 
     auto presentInfo = VkPresentInfoKHR{};
     presentInfo.sType = VK_STRUCTURE_TYPE_PRESENT_INFO_KHR;
     presentInfo.waitSemaphoreCount = 1;
-    presentInfo.pWaitSemaphores = signalSemaphores;
+    presentInfo.pWaitSemaphores = &renderFinishedSemaphores[currentFrame];
     presentInfo.swapchainCount = 1;
     presentInfo.pSwapchains = swapchains;
     presentInfo.pImageIndices = &imageIndex;
 
-    result = vkQueuePresentKHR(presentQueue, &presentInfo);
+    auto result = VK_SUCCESS;
+    {
+        std::lock_guard<std::mutex> lock(graphicsQueueMutex);
+        result = vkQueuePresentKHR(presentQueue, &presentInfo);
+    }
 
-    if (result == VK_ERROR_OUT_OF_DATE_KHR || result == VK_SUBOPTIMAL_KHR)
+    if (result == VK_ERROR_OUT_OF_DATE_KHR || result == VK_SUBOPTIMAL_KHR || framebufferResized)
         recreateSwapchain();
     else if (result != VK_SUCCESS)
         throw std::runtime_error("Failed to present the image.");
+}
+
+void GraphicsEngine::drawFrame(double slotWait) {
+    PROFILE_SCOPE("GraphicsEngine::drawFrame");
+    using Clock = std::chrono::steady_clock;
+    auto frameStart = Clock::now();
+
+    waitForFrameSlot();
+    auto fenceWaited = Clock::now();
+
+    deletionQueue.collect(completedFrameNumber);
+    uploadManager->collect(completedFrameNumber);
+    if (culling && frameSlotNumbers[currentFrame] > 0)
+        cullingStats = culling->getStats(currentFrame);
+    frameDescriptorSet = bindless->beginFrame(currentFrame);
+
+    uint32_t imageIndex;
+    if (!acquireImage(imageIndex))
+        return;
+    auto acquired = Clock::now();
+
+    vkResetFences(device, 1, &inFlightFences[currentFrame]);
+
+    // the fence wait above guarantees nothing recorded from this frame's pools is still executing
+    for (auto pool : frameCommands[currentFrame].pools)
+        if (vkResetCommandPool(device, pool, 0) != VK_SUCCESS)
+            throw std::runtime_error("Failed to reset command pool.");
+
+    // everything allocated from this slot belonged to the frame the fence just released
+    frameAllocator->beginFrame(currentFrame);
+    drawBatcher->begin();
+    // ahead of the upload submission below, so this frame waits for the levels it swaps in
+    textureStreamer->update();
+    submitTestScene();
+    {
+        PROFILE_SCOPE("DrawBatcher::build");
+        drawBatcher->build(*meshPool);
+    }
+    PROFILE_COUNTER("Draw commands", drawBatcher->getCommandCount());
+    PROFILE_COUNTER("Instances", drawBatcher->getInstanceCount());
+    PROFILE_COUNTER("Resident texture MiB", textureStreamer->getResidentBytes() / (1024.0 * 1024.0));
+
+    // copies requested since the last frame go out first, so this frame can already wait on them
+    uploadManager->submit();
+
+    recordCommandBuffer(frameCommands[currentFrame].primary, imageIndex);
+    auto recorded = Clock::now();
+
+    // headless frames are never acquired nor presented, so there is nothing to wait on or signal
+    std::vector<VkSemaphore> waitSemaphores = uploadWaitSemaphores;
+    std::vector<VkPipelineStageFlags> waitStages = uploadWaitStages;
+    if (!settings.headless) {
+        waitSemaphores.push_back(imageAvailableSemaphores[currentFrame]);
+        waitStages.push_back(VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT);
+    }
+
+    VkSemaphore signalSemaphores[] = {renderFinishedSemaphores[currentFrame]};
+
+    auto submitInfo = VkSubmitInfo{};
+    submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+    submitInfo.waitSemaphoreCount = static_cast<uint32_t>(waitSemaphores.size());
+    submitInfo.pWaitSemaphores = waitSemaphores.data();
+    submitInfo.pWaitDstStageMask = waitStages.data();
+    submitInfo.commandBufferCount = 1;
+    submitInfo.pCommandBuffers = &frameCommands[currentFrame].primary;
+    submitInfo.signalSemaphoreCount = settings.headless ? 0 : 1;
+    submitInfo.pSignalSemaphores = signalSemaphores;
+
+    {
+        PROFILE_SCOPE("vkQueueSubmit");
+        std::lock_guard<std::mutex> lock(graphicsQueueMutex);
+        if (vkQueueSubmit(graphicsQueue, 1, &submitInfo, inFlightFences[currentFrame]) != VK_SUCCESS)
+            throw std::runtime_error("Failed to submit the command buffer to the queue.");
+    }
+
+    frameNumber++;
+    frameSlotNumbers[currentFrame] = frameNumber;
+    framePacer->frameSubmitted(frameNumber);
+    auto submitted = Clock::now();
+
+    presentImage(imageIndex);
+    auto presented = Clock::now();
+
+    frameTimings.fenceWait = slotWait + FrameBenchmark::elapsedMilliseconds(frameStart, fenceWaited);
+    frameTimings.acquire = FrameBenchmark::elapsedMilliseconds(fenceWaited, acquired);
+    frameTimings.record = FrameBenchmark::elapsedMilliseconds(acquired, recorded);
+    frameTimings.submit = FrameBenchmark::elapsedMilliseconds(recorded, submitted);
+    frameTimings.present = FrameBenchmark::elapsedMilliseconds(submitted, presented);
+    frameTimings.total = slotWait + FrameBenchmark::elapsedMilliseconds(frameStart, presented);
 
     currentFrame = (currentFrame + 1) % maxFramesInFlight;
 }
 
-void GraphicsEngine::onChangedFile(const std::string& filename) {
-    std::cout << filename << std::endl;
-    createGraphicsPipeline(swapPipelineLayout, swapGraphicsPipeline);
+std::vector<uint8_t> GraphicsEngine::readFrame() {
+    // swapchain images belong to the presentation engine once presented
+    if (!settings.headless)
+        throw std::runtime_error("Frame readback is only available in headless mode.");
+
+    if (frameNumber == 0)
+        throw std::runtime_error("No frame has been drawn yet.");
+
+    vkWaitForFences(device, 1, &inFlightFences[lastFrame], VK_TRUE, UINT64_MAX);
+
+    const auto pixelCount = static_cast<VkDeviceSize>(swapchainExtent.width) * swapchainExtent.height;
+    const auto bufferSize = pixelCount * 4;
+
+    auto bufferInfo = VkBufferCreateInfo{};
+    bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+    bufferInfo.size = bufferSize;
+    bufferInfo.usage = VK_BUFFER_USAGE_TRANSFER_DST_BIT;
+    bufferInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+
+    auto buffer = memoryAllocator->createBuffer(bufferInfo, MemoryUsage::GpuToCpu);
+
+    auto commandBufferInfo = VkCommandBufferAllocateInfo{};
+    commandBufferInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+    commandBufferInfo.commandPool = commandPool;
+    commandBufferInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+    commandBufferInfo.commandBufferCount = 1;
+
+    VkCommandBuffer commandBuffer;
+    if (vkAllocateCommandBuffers(device, &commandBufferInfo, &commandBuffer) != VK_SUCCESS)
+        throw std::runtime_error("Failed to allocate readback command buffer.");
+
+    auto beginInfo = VkCommandBufferBeginInfo{};
+    beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+    beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+    vkBeginCommandBuffer(commandBuffer, &beginInfo);
+
+    // the render graph already leaves the image in transfer src layout and visible to transfers, the copy only has to come after
+    auto imageBarrier = VkImageMemoryBarrier{};
+    imageBarrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+    imageBarrier.srcAccessMask = 0;
+    imageBarrier.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+    imageBarrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+    imageBarrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+    imageBarrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    imageBarrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    imageBarrier.image = swapchainImages[lastImageIndex];
+    imageBarrier.subresourceRange = {VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1};
+
+    vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, nullptr, 0, nullptr, 1, &imageBarrier);
+
+    auto region = VkBufferImageCopy{};
+    region.imageSubresource = {VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, 1};
+    region.imageExtent = {swapchainExtent.width, swapchainExtent.height, 1};
+
+    vkCmdCopyImageToBuffer(commandBuffer, swapchainImages[lastImageIndex], VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, buffer.buffer, 1, &region);
+
+    auto hostBarrier = VkBufferMemoryBarrier{};
+    hostBarrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+    hostBarrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+    hostBarrier.dstAccessMask = VK_ACCESS_HOST_READ_BIT;
+    hostBarrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    hostBarrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    hostBarrier.buffer = buffer.buffer;
+    hostBarrier.size = VK_WHOLE_SIZE;
+
+    vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_HOST_BIT, 0, 0, nullptr, 1, &hostBarrier, 0, nullptr);
+
+    if (vkEndCommandBuffer(commandBuffer) != VK_SUCCESS)
+        throw std::runtime_error("Failed to end readback command buffer.");
+
+    auto submitInfo = VkSubmitInfo{};
+    submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+    submitInfo.commandBufferCount = 1;
+    submitInfo.pCommandBuffers = &commandBuffer;
+
+    {
+        std::lock_guard<std::mutex> lock(graphicsQueueMutex);
+        if (vkQueueSubmit(graphicsQueue, 1, &submitInfo, VK_NULL_HANDLE) != VK_SUCCESS)
+            throw std::runtime_error("Failed to submit readback.");
+        vkQueueWaitIdle(graphicsQueue);
+    }
+
+    // swizzle into RGBA regardless of which format the images ended up with
+    std::vector<uint8_t> pixels(bufferSize);
+    auto source = static_cast<const uint8_t*>(buffer.allocation.mapped);
+    const auto isBgra = swapchainImageFormat == VK_FORMAT_B8G8R8A8_SRGB || swapchainImageFormat == VK_FORMAT_B8G8R8A8_UNORM;
+    for (VkDeviceSize i = 0; i < pixelCount; i++) {
+        pixels[i * 4 + 0] = source[i * 4 + (isBgra ? 2 : 0)];
+        pixels[i * 4 + 1] = source[i * 4 + 1];
+        pixels[i * 4 + 2] = source[i * 4 + (isBgra ? 0 : 2)];
+        pixels[i * 4 + 3] = source[i * 4 + 3];
+    }
+
+    vkFreeCommandBuffers(device, commandPool, 1, &commandBuffer);
+    memoryAllocator->destroyBuffer(buffer);
+
+    return pixels;
+}
+
+void GraphicsEngine::onChangedFiles(const std::vector<std::string>& filenames) {
+    for (const auto& filename : filenames)
+        std::cout << filename << std::endl;
+
+    // the archive's shaders are older than any edit
+    shaderCompiler->sourcesChanged();
+
+    // only hand the work over, the watcher thread should go straight back to waiting
+    shaderReloadRequested = true;
+    if (!shaderReloadRunning.exchange(true))
+        jobSystem->submitBackground([this] { reloadShaders(); }, &shaderReloadJobs);
+}
+
+void GraphicsEngine::reloadShaders() {
+    do {
+        // changes arriving during a build trigger one more build, not one per change
+        while (shaderReloadRequested.exchange(false)) {
+            try {
+                auto pipelines = pipelineLibrary->rebuild(*jobSystem);
+                jobSystem->submitToMainThread([this, pipelines] { publishReloadedPipelines(pipelines); });
+            }
+            catch (const std::exception& exception) {
+                std::cerr << "Shader reload failed, keeping the current pipelines: " << exception.what() << std::endl;
+            }
+        }
+
+        shaderReloadRunning = false;
+        // a change that came in after the last check saw this job still running and left the build to it
+    } while (shaderReloadRequested && !shaderReloadRunning.exchange(true));
+}
+
+void GraphicsEngine::publishReloadedPipelines(std::vector<std::pair<PipelineDescription, VkPipeline>> pipelines) {
+    // frames already submitted may still use the current variants
+    retire([device = device, pipelines = pipelineLibrary->replace(std::move(pipelines))] {
+        for (auto pipeline : pipelines)
+            vkDestroyPipeline(device, pipeline, nullptr);
+    });
+}
+
+void GraphicsEngine::retire(std::function<void()> deleter) {
+    // the frame being recorded, if any, may still reference the object as well
+    deletionQueue.push(frameNumber + 1, std::move(deleter));
 }
\ No newline at end of file
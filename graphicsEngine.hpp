@@ -3,32 +3,118 @@
 #include <vector>
 #include <optional>
 #include <memory>
+#include <string>
+#include <atomic>
+#include <mutex>
 #include "utilities.hpp"
+#include "benchmark.hpp"
+#include "shaderCompiler.hpp"
+#include "assetArchive.hpp"
+#include "deletionQueue.hpp"
+#include "memoryAllocator.hpp"
+#include "frameAllocator.hpp"
+#include "uploadManager.hpp"
+#include "meshPool.hpp"
+#include "drawBatcher.hpp"
+#include "gpuCulling.hpp"
+#include "pipelineLibrary.hpp"
+#include "framePacer.hpp"
+#include "simulation.hpp"
+#include "renderGraph.hpp"
+#include "bindlessDescriptors.hpp"
+#include "textureStreamer.hpp"
 
 #define GLFW_INCLUDE_VULKAN
 #include <GLFW/glfw3.h>
 
+struct GraphicsEngineSettings {
+    // renders into engine-owned images instead of a window, no display or present support needed
+    bool headless = false;
+    uint32_t width = 640;
+    uint32_t height = 480;
+    // number of frames mainLoop draws before returning in headless mode
+    uint32_t headlessFrameCount = 1;
+
+    // when benchmarkFrames is non-zero, mainLoop draws the warm-up and measured frames then
+    // writes the per-stage timings to <benchmarkReport>.csv and <benchmarkReport>.json
+    uint32_t benchmarkWarmupFrames = 60;
+    uint32_t benchmarkFrames = 0;
+    std::string benchmarkReport = "benchmark";
+    // Chrome trace of the profiling zones, written when mainLoop returns, empty to skip; needs PROFILING_ENABLED
+    std::string tracePath;
+
+    // driver pipeline cache kept across runs, empty to disable
+    std::string pipelineCachePath = "build/pipeline.cache";
+    // compiled SPIR-V keyed by source and options hash, empty to only cache in memory
+    std::string shaderCachePath = "build/shadercache";
+    // packed by tools/assetPacker, assets it lacks and every asset when it is missing load from loose files
+    std::string assetArchivePath = "build/assets.pak";
+    // KTX2 texture streamed onto the test scene, which keeps the checkerboard when there is none
+    std::string texturePath = "textures/test.ktx2";
+    // device memory streamed textures may hold, the finer levels of the least recently drawn are evicted beyond it
+    VkDeviceSize textureBudget = 256ull * 1024 * 1024;
+
+    // job system workers besides the main thread, shared by recording, simulation and loading, 0 for one per hardware thread
+    uint32_t workerThreads = 0;
+    // objects in the test scene, laid out on a grid, raise it to load the draw path
+    uint32_t drawCount = 1;
+    // drops objects outside the view or hidden behind last frame's depth on the gpu before drawing
+    bool gpuCulling = true;
+    // keeps one update-after-bind set of every texture and buffer, off or unsupported it is rewritten each frame instead
+    bool descriptorIndexing = true;
+
+    // fewer frames in flight trade throughput for latency, 1 keeps the cpu and gpu in lockstep
+    uint32_t framesInFlight = 2;
+    // falls back to FIFO, the only mode every surface supports, when the requested one is unavailable
+    VkPresentModeKHR presentMode = VK_PRESENT_MODE_MAILBOX_KHR;
+    // sleeps before sampling input so the frame reaches the gpu just as it frees up, instead of queueing there
+    bool justInTime = false;
+    // simulation ticks per second, independent of the frame rate, frames blend the two newest ticks
+    double tickRate = 60.0;
+};
+
 class GraphicsEngine {
 public:
 
-    GraphicsEngine();
+    GraphicsEngine(const GraphicsEngineSettings& settings = {});
     ~GraphicsEngine();
 
     void mainLoop();
 
+    // returns the last drawn frame as tightly packed RGBA8 pixels
+    std::vector<uint8_t> readFrame();
+    VkExtent2D getFrameExtent() const { return swapchainExtent; }
+    // counts of the last frame whose cull has completed, zero with culling off
+    CullingStats getCullingStats() const { return cullingStats; }
+
 private:
-    const int maxFramesInFlight = 2;
+    const GraphicsEngineSettings settings;
+
+    // every subsystem's parallel work runs here, created first and destroyed last
+    std::unique_ptr<Utilities::JobSystem> jobSystem;
+    // loads without blocking whoever asks, files are read by the kernel or by jobs
+    std::unique_ptr<Utilities::AsyncFileReader> fileReader;
+
+    const int maxFramesInFlight;
     uint32_t currentFrame = 0;
+    uint64_t frameNumber = 0;
+    // frame number last submitted from each frame in flight, and the newest one known to be done
+    std::vector<uint64_t> frameSlotNumbers;
+    uint64_t completedFrameNumber = 0;
+
+    // destroys gpu objects once every frame submitted so far has finished, safe to call mid-frame
+    DeletionQueue deletionQueue;
+    void retire(std::function<void()> deleter);
+    bool shouldClose();
 
     // TODO: move window to something else?
     // let the engine just be the interface to vulkan
     // and make the game loop outside, such that there is a draw function that can be called
-    const uint32_t width = 640;
-    const uint32_t height = 480;
-    GLFWwindow* window;
+    GLFWwindow* window = nullptr;
+    bool framebufferResized = false;
     void createWindow();
 
-    VkSurfaceKHR surface;
+    VkSurfaceKHR surface = VK_NULL_HANDLE;
     void createSurface();
 
     VkInstance instance;
@@ -39,56 +125,146 @@ private:
     void createDebugMessenger();
     static VKAPI_ATTR VkBool32 VKAPI_CALL debugCallback(VkDebugUtilsMessageSeverityFlagBitsEXT messageSeverity, VkDebugUtilsMessageTypeFlagsEXT messageType, const VkDebugUtilsMessengerCallbackDataEXT* callbackData, void* userData); 
 
-    VkPhysicalDevice physicalDevice;
+    VkPhysicalDevice physicalDevice = VK_NULL_HANDLE;
     void pickPhysicalDevice();
 
     std::optional<uint32_t> graphicsQueueIndex;
+    // a transfer-only family when the device has one, so uploads run on the copy engine
+    uint32_t transferQueueIndex;
     VkDevice device;
     VkQueue graphicsQueue;
     VkQueue presentQueue;
+    VkQueue transferQueue;
+    bool multiDrawIndirect = false;
+    bool drawIndirectFirstInstance = false;
+    bool descriptorIndexing = false;
+    // held around every graphics queue submit or present, as uploads may share that queue
+    std::mutex graphicsQueueMutex;
     void createDevice();
 
-    VkSwapchainKHR swapchain;
+    std::unique_ptr<MemoryAllocator> memoryAllocator;
+    // per frame in flight dynamic data, reset once the frame's fence signals
+    std::unique_ptr<FrameAllocator> frameAllocator;
+    void createFrameAllocator();
+    std::unique_ptr<UploadManager> uploadManager;
+    // filled while recording a frame, waited on by its submission
+    std::vector<VkSemaphore> uploadWaitSemaphores;
+    std::vector<VkPipelineStageFlags> uploadWaitStages;
+
+    // every texture and buffer the shaders index, bound once per command buffer
+    std::unique_ptr<BindlessDescriptors> bindless;
+    VkDescriptorSet frameDescriptorSet = VK_NULL_HANDLE;
+    void createBindlessDescriptors();
+
+    std::unique_ptr<MeshPool> meshPool;
+    std::unique_ptr<DrawBatcher> drawBatcher;
+    MeshHandle testMesh;
+    Image testTexture;
+    VkImageView testTextureView;
+    VkSampler testSampler;
+    uint32_t testTextureIndex;
+    // pages mip levels in and out by on-screen size, textures sample the checkerboard until they arrive
+    std::unique_ptr<TextureStreamer> textureStreamer;
+    std::optional<TextureHandle> sceneTexture;
+    // what this frame's draws sample, fixed before recording starts
+    uint32_t sceneTextureIndex;
+    void createTestScene();
+    void submitTestScene();
+
+    // game logic runs here rather than in mainLoop, so it never adds to the frame time
+    std::unique_ptr<Simulation> simulation;
+
+    std::unique_ptr<GpuCulling> culling;
+    CullingStats cullingStats;
+    // there is no camera yet, the test scene is laid out in clip space
+    float viewProjection[16] = {1, 0, 0, 0, 0, 1, 0, 0, 0, 0, 1, 0, 0, 0, 0, 1};
+
+    VkSwapchainKHR swapchain = VK_NULL_HANDLE;
     VkFormat swapchainImageFormat;
     VkExtent2D swapchainExtent;
     void createSwapchain();
     void recreateSwapchain();
     void cleanupSwapchain();
 
+    // headless stand-ins for the swapchain images, one per frame in flight
+    std::vector<Image> offscreenImages;
+    void createOffscreenImages();
+
     std::vector<VkImage> swapchainImages;
     std::vector<VkImageView> swapchainImageViews;
     void createImageViews();
 
-    VkRenderPass renderPass;
-    void createRenderPass();
+    VkFormat depthFormat;
+    void pickDepthFormat();
+
+    // declared anew every frame, its render passes, framebuffers and transient images persist across frames
+    std::unique_ptr<RenderGraph> renderGraph;
+    // the depth view the culling pyramid was last sized for
+    VkImageView cullingDepthView = VK_NULL_HANDLE;
+    void buildFrameGraph(uint32_t imageIndex);
 
-    VkPipelineLayout pipelineLayout;
-    VkPipeline graphicsPipeline;
+    // shared by every pipeline creation, including hot reloads
+    VkPipelineCache pipelineCache;
+    bool pipelineCacheWarm = false;
+    std::future<std::vector<char>> pipelineCacheFile;
+    void createPipelineCache();
+    void destroyPipelineCache();
 
-    // TODO: rename or move once asset manager / build is created
-    VkPipelineLayout swapPipelineLayout = VK_NULL_HANDLE;
-    VkPipeline swapGraphicsPipeline = VK_NULL_HANDLE;
+    // every pipeline variant, created ahead of the first frame that needs it
+    std::unique_ptr<PipelineLibrary> pipelineLibrary;
+    PipelineDescription sceneMaterial;
+    double pipelineCreationMilliseconds = 0;
 
-    void createGraphicsPipeline(VkPipelineLayout& layout, VkPipeline& pipeline);
+    // hot reloads are built by a job and swapped in by a main-thread job, at the start of a frame
+    std::atomic<bool> shaderReloadRequested = false;
+    std::atomic<bool> shaderReloadRunning = false;
+    Utilities::JobSystem::Counter shaderReloadJobs;
+    void reloadShaders();
+    void publishReloadedPipelines(std::vector<std::pair<PipelineDescription, VkPipeline>> pipelines);
 
-    std::vector<VkFramebuffer> swapchainFramebuffers;
-    void createFramebuffers();
+    std::unique_ptr<AssetArchive> assetArchive;
+    void openAssetArchive();
+    std::unique_ptr<ShaderCompiler> shaderCompiler;
 
+    // for one-off commands such as readbacks
     VkCommandPool commandPool;
     void createCommandPool();
 
-    std::vector<VkCommandBuffer> commandBuffers;
+    // one pool per recording thread and frame in flight, reset wholesale once the frame's fence signals;
+    // the first pool also holds the primary buffer that executes the secondaries
+    struct FrameCommands {
+        std::vector<VkCommandPool> pools;
+        VkCommandBuffer primary;
+        std::vector<VkCommandBuffer> secondaries;
+    };
+    std::vector<FrameCommands> frameCommands;
+    // below this many indirect commands per thread, splitting the work costs more than it saves
+    const uint32_t minDrawsPerRecordingThread = 256;
     void createCommandBuffer();
 
     void recordCommandBuffer(VkCommandBuffer commandBuffer, uint32_t imageIndex);
+    void recordDraws(VkCommandBuffer commandBuffer, const RenderPassContext& context, uint32_t firstCommand, uint32_t commandCount);
 
     std::vector<VkSemaphore> imageAvailableSemaphores;
     std::vector<VkSemaphore> renderFinishedSemaphores;
     std::vector<VkFence> inFlightFences;
     void createSyncObjects();
 
-    void drawFrame();
+    uint32_t lastFrame = 0;
+    uint32_t lastImageIndex = 0;
+    std::unique_ptr<FramePacer> framePacer;
+    void waitForFrameSlot();
+    // notices frames that finished while nobody was waiting on their fences, for the latency estimate
+    void pollCompletedFrames();
+
+    bool acquireImage(uint32_t& imageIndex);
+    void presentImage(uint32_t imageIndex);
+    // slotWait is the milliseconds the loop already spent waiting for this frame's slot, counted as fence wait
+    void drawFrame(double slotWait);
+
+    FrameTimings frameTimings;
+    std::unique_ptr<FrameBenchmark> benchmark;
 
     std::unique_ptr<Utilities::FileWatcher> fileWatcher;
-    void onChangedFile(const std::string& filename);
+    void onChangedFiles(const std::vector<std::string>& filenames);
 };
\ No newline at end of file
@@ -1,14 +1,89 @@
 #include "graphicsEngine.hpp"
-#include "Utilities.hpp"
+#include "utilities.hpp"
+#include "vulkan.hpp"
+#include "profiler.hpp"
 #include <iostream>
+#include <fstream>
+#include <cstring>
 
 void callback(const std::string& filename) {
     std::cout << filename << std::endl;
 }
 
-int main() {
-    GraphicsEngine* graphicsEngine = new GraphicsEngine();
+void writePpm(const std::string& filename, const std::vector<uint8_t>& pixels, VkExtent2D extent) {
+    std::ofstream file(filename, std::ios::binary);
+    if (!file.is_open())
+        throw std::runtime_error("Failed to open " + filename + " for writing.");
+
+    file << "P6\n" << extent.width << " " << extent.height << "\n255\n";
+    for (size_t i = 0; i < pixels.size(); i += 4)
+        file.write(reinterpret_cast<const char*>(&pixels[i]), 3);
+}
+
+// usage: vk-game [--headless] [--frames <count>] [--capture <file.ppm>]
+//                [--benchmark <frames>] [--warmup <frames>] [--report <basename>]
+//                [--threads <count>] [--draws <count>] [--no-culling] [--no-descriptor-indexing]
+//                [--frames-in-flight <count>] [--present <fifo|fifo-relaxed|mailbox|immediate>] [--just-in-time]
+//                [--tick-rate <hz>] [--assets <archive.pak>] [--texture <file.ktx2>] [--texture-budget <MiB>]
+//                [--trace <file.json>]
+int main(int argc, char** argv) {
+    PROFILE_THREAD("Main");
+    auto settings = GraphicsEngineSettings{};
+    std::string captureFilename;
+
+    for (auto i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--headless") == 0)
+            settings.headless = true;
+        else if (strcmp(argv[i], "--frames") == 0 && i + 1 < argc)
+            settings.headlessFrameCount = std::stoul(argv[++i]);
+        else if (strcmp(argv[i], "--capture") == 0 && i + 1 < argc)
+            captureFilename = argv[++i];
+        else if (strcmp(argv[i], "--benchmark") == 0 && i + 1 < argc)
+            settings.benchmarkFrames = std::stoul(argv[++i]);
+        else if (strcmp(argv[i], "--warmup") == 0 && i + 1 < argc)
+            settings.benchmarkWarmupFrames = std::stoul(argv[++i]);
+        else if (strcmp(argv[i], "--report") == 0 && i + 1 < argc)
+            settings.benchmarkReport = argv[++i];
+        else if (strcmp(argv[i], "--threads") == 0 && i + 1 < argc)
+            settings.workerThreads = std::stoul(argv[++i]);
+        else if (strcmp(argv[i], "--draws") == 0 && i + 1 < argc)
+            settings.drawCount = std::stoul(argv[++i]);
+        else if (strcmp(argv[i], "--no-culling") == 0)
+            settings.gpuCulling = false;
+        else if (strcmp(argv[i], "--no-descriptor-indexing") == 0)
+            settings.descriptorIndexing = false;
+        else if (strcmp(argv[i], "--frames-in-flight") == 0 && i + 1 < argc)
+            settings.framesInFlight = std::stoul(argv[++i]);
+        else if (strcmp(argv[i], "--present") == 0 && i + 1 < argc) {
+            if (!Vulkan::parsePresentMode(argv[++i], settings.presentMode))
+                std::cerr << "Unknown present mode " << argv[i] << ", keeping " << Vulkan::presentModeName(settings.presentMode) << "." << std::endl;
+        }
+        else if (strcmp(argv[i], "--just-in-time") == 0)
+            settings.justInTime = true;
+        else if (strcmp(argv[i], "--tick-rate") == 0 && i + 1 < argc)
+            settings.tickRate = std::stod(argv[++i]);
+        else if (strcmp(argv[i], "--assets") == 0 && i + 1 < argc)
+            settings.assetArchivePath = argv[++i];
+        else if (strcmp(argv[i], "--texture") == 0 && i + 1 < argc)
+            settings.texturePath = argv[++i];
+        else if (strcmp(argv[i], "--texture-budget") == 0 && i + 1 < argc)
+            settings.textureBudget = std::stoull(argv[++i]) * 1024 * 1024;
+        else if (strcmp(argv[i], "--trace") == 0 && i + 1 < argc)
+            settings.tracePath = argv[++i];
+    }
+
+    GraphicsEngine* graphicsEngine = new GraphicsEngine(settings);
     graphicsEngine->mainLoop();
+
+    if (settings.gpuCulling) {
+        auto stats = graphicsEngine->getCullingStats();
+        std::cout << "Culling: " << stats.visible << " visible, " << stats.frustumCulled << " outside the frustum, "
+            << stats.occlusionCulled << " occluded" << std::endl;
+    }
+
+    if (settings.headless && !captureFilename.empty())
+        writePpm(captureFilename, graphicsEngine->readFrame(), graphicsEngine->getFrameExtent());
+
     delete graphicsEngine;
 
     // Utilities::FileWatcher f = Utilities::FileWatcher(
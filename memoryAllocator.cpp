@@ -0,0 +1,478 @@
+#include "memoryAllocator.hpp"
+#include <iostream>
+#include <stdexcept>
+#include <algorithm>
+
+namespace {
+
+    uint32_t mostSignificantBit(uint64_t value) {
+        uint32_t bit = 0;
+        while (value >>= 1)
+            bit++;
+        return bit;
+    }
+
+    uint32_t leastSignificantBit(uint64_t value) {
+        uint32_t bit = 0;
+        while (!(value & 1)) {
+            value >>= 1;
+            bit++;
+        }
+        return bit;
+    }
+
+    VkDeviceSize alignUp(VkDeviceSize value, VkDeviceSize alignment) {
+        return (value + alignment - 1) / alignment * alignment;
+    }
+
+    // remainders smaller than this stay attached to the allocation instead of becoming free ranges
+    const VkDeviceSize minimumSplitSize = 64;
+
+    // blocks larger than this fraction of the block size get their own vkAllocateMemory
+    const VkDeviceSize dedicatedThresholdDivisor = 2;
+}
+
+TlsfAllocator::TlsfAllocator(VkDeviceSize size) : size_(size) {
+    for (auto& heads : freeHeads_)
+        std::fill(std::begin(heads), std::end(heads), none);
+
+    auto node = createNode_();
+    nodes_[node].offset = 0;
+    nodes_[node].size = size;
+    insertFree_(node);
+}
+
+std::optional<TlsfAllocator::Range> TlsfAllocator::allocate(VkDeviceSize size, VkDeviceSize alignment) {
+    if (size == 0)
+        size = 1;
+    alignment = std::max<VkDeviceSize>(alignment, 1);
+
+    // reserving the worst case padding up front means any block of the found class fits
+    auto node = findFree_(size + alignment - 1);
+    if (node == none)
+        return std::nullopt;
+    removeFree_(node);
+
+    auto alignedOffset = alignUp(nodes_[node].offset, alignment);
+    auto padding = alignedOffset - nodes_[node].offset;
+    if (padding > 0) {
+        // neighbours of a free range are never free, so the padding can be inserted as is
+        auto front = createNode_();
+        nodes_[front].offset = nodes_[node].offset;
+        nodes_[front].size = padding;
+        nodes_[front].previousPhysical = nodes_[node].previousPhysical;
+        nodes_[front].nextPhysical = node;
+        if (nodes_[front].previousPhysical != none)
+            nodes_[nodes_[front].previousPhysical].nextPhysical = front;
+        nodes_[node].previousPhysical = front;
+        nodes_[node].offset = alignedOffset;
+        nodes_[node].size -= padding;
+        insertFree_(front);
+    }
+
+    if (nodes_[node].size - size >= minimumSplitSize) {
+        auto back = createNode_();
+        nodes_[back].offset = alignedOffset + size;
+        nodes_[back].size = nodes_[node].size - size;
+        nodes_[back].previousPhysical = node;
+        nodes_[back].nextPhysical = nodes_[node].nextPhysical;
+        if (nodes_[back].nextPhysical != none)
+            nodes_[nodes_[back].nextPhysical].previousPhysical = back;
+        nodes_[node].nextPhysical = back;
+        nodes_[node].size = size;
+        insertFree_(back);
+    }
+
+    nodes_[node].free = false;
+    usedBytes_ += nodes_[node].size;
+    allocationCount_++;
+
+    return Range{alignedOffset, node};
+}
+
+void TlsfAllocator::free(uint32_t node) {
+    usedBytes_ -= nodes_[node].size;
+    allocationCount_--;
+
+    auto previous = nodes_[node].previousPhysical;
+    if (previous != none && nodes_[previous].free) {
+        removeFree_(previous);
+        nodes_[previous].size += nodes_[node].size;
+        nodes_[previous].nextPhysical = nodes_[node].nextPhysical;
+        if (nodes_[node].nextPhysical != none)
+            nodes_[nodes_[node].nextPhysical].previousPhysical = previous;
+        releaseNode_(node);
+        node = previous;
+    }
+
+    auto next = nodes_[node].nextPhysical;
+    if (next != none && nodes_[next].free) {
+        removeFree_(next);
+        nodes_[node].size += nodes_[next].size;
+        nodes_[node].nextPhysical = nodes_[next].nextPhysical;
+        if (nodes_[next].nextPhysical != none)
+            nodes_[nodes_[next].nextPhysical].previousPhysical = node;
+        releaseNode_(next);
+    }
+
+    insertFree_(node);
+}
+
+VkDeviceSize TlsfAllocator::largestFreeRange() const {
+    VkDeviceSize largest = 0;
+    for (const auto& node : nodes_)
+        if (node.free)
+            largest = std::max(largest, node.size);
+    return largest;
+}
+
+uint32_t TlsfAllocator::freeRangeCount() const {
+    return static_cast<uint32_t>(std::count_if(nodes_.begin(), nodes_.end(), [](const Node& node) { return node.free; }));
+}
+
+uint32_t TlsfAllocator::createNode_() {
+    if (!unusedNodes_.empty()) {
+        auto node = unusedNodes_.back();
+        unusedNodes_.pop_back();
+        nodes_[node] = {};
+        return node;
+    }
+
+    nodes_.emplace_back();
+    return static_cast<uint32_t>(nodes_.size() - 1);
+}
+
+void TlsfAllocator::releaseNode_(uint32_t node) {
+    nodes_[node] = {};
+    unusedNodes_.push_back(node);
+}
+
+void TlsfAllocator::mapping_(VkDeviceSize size, uint32_t& firstLevel, uint32_t& secondLevel) {
+    if (size < (1ull << smallLog2)) {
+        firstLevel = 0;
+        secondLevel = static_cast<uint32_t>(size >> (smallLog2 - secondLevelLog2));
+        return;
+    }
+
+    auto bit = mostSignificantBit(size);
+    firstLevel = bit - smallLog2 + 1;
+    secondLevel = static_cast<uint32_t>(size >> (bit - secondLevelLog2)) & (secondLevelCount - 1);
+}
+
+void TlsfAllocator::insertFree_(uint32_t node) {
+    uint32_t firstLevel, secondLevel;
+    mapping_(nodes_[node].size, firstLevel, secondLevel);
+
+    auto head = freeHeads_[firstLevel][secondLevel];
+    nodes_[node].free = true;
+    nodes_[node].previousFree = none;
+    nodes_[node].nextFree = head;
+    if (head != none)
+        nodes_[head].previousFree = node;
+    freeHeads_[firstLevel][secondLevel] = node;
+
+    firstLevelBitmap_ |= 1ull << firstLevel;
+    secondLevelBitmaps_[firstLevel] |= 1u << secondLevel;
+}
+
+void TlsfAllocator::removeFree_(uint32_t node) {
+    uint32_t firstLevel, secondLevel;
+    mapping_(nodes_[node].size, firstLevel, secondLevel);
+
+    auto previous = nodes_[node].previousFree;
+    auto next = nodes_[node].nextFree;
+    if (previous != none)
+        nodes_[previous].nextFree = next;
+    else
+        freeHeads_[firstLevel][secondLevel] = next;
+    if (next != none)
+        nodes_[next].previousFree = previous;
+
+    nodes_[node].free = false;
+    nodes_[node].previousFree = none;
+    nodes_[node].nextFree = none;
+
+    if (freeHeads_[firstLevel][secondLevel] == none) {
+        secondLevelBitmaps_[firstLevel] &= ~(1u << secondLevel);
+        if (!secondLevelBitmaps_[firstLevel])
+            firstLevelBitmap_ &= ~(1ull << firstLevel);
+    }
+}
+
+uint32_t TlsfAllocator::findFree_(VkDeviceSize size) const {
+    // round up to the next class boundary so every range in the class found is large enough
+    if (size < (1ull << smallLog2))
+        size = alignUp(size, 1ull << (smallLog2 - secondLevelLog2));
+    else
+        size += (1ull << (mostSignificantBit(size) - secondLevelLog2)) - 1;
+
+    uint32_t firstLevel, secondLevel;
+    mapping_(size, firstLevel, secondLevel);
+    if (firstLevel >= firstLevelCount)
+        return none;
+
+    auto secondLevelMap = secondLevelBitmaps_[firstLevel] & (~0u << secondLevel);
+    if (!secondLevelMap) {
+        auto firstLevelMap = firstLevel + 1 < 64 ? firstLevelBitmap_ & (~0ull << (firstLevel + 1)) : 0;
+        if (!firstLevelMap)
+            return none;
+        firstLevel = leastSignificantBit(firstLevelMap);
+        secondLevelMap = secondLevelBitmaps_[firstLevel];
+    }
+
+    return freeHeads_[firstLevel][leastSignificantBit(secondLevelMap)];
+}
+
+MemoryAllocator::MemoryAllocator(VkPhysicalDevice physicalDevice, VkDevice device, VkDeviceSize blockSize)
+    : physicalDevice_(physicalDevice), device_(device), blockSize_(blockSize) {
+    auto properties = VkPhysicalDeviceProperties{};
+    vkGetPhysicalDeviceProperties(physicalDevice_, &properties);
+    bufferImageGranularity_ = properties.limits.bufferImageGranularity;
+    maxAllocationCount_ = properties.limits.maxMemoryAllocationCount;
+
+    vkGetPhysicalDeviceMemoryProperties(physicalDevice_, &memoryProperties_);
+    pools_.resize(memoryProperties_.memoryTypeCount * 2);
+}
+
+MemoryAllocator::~MemoryAllocator() {
+    for (auto& pool : pools_)
+        for (auto& block : pool.blocks) {
+            if (block->ranges.allocationCount() > 0)
+                std::cerr << "Memory block freed with " << block->ranges.allocationCount() << " live allocations." << std::endl;
+            vkFreeMemory(device_, block->memory, nullptr);
+        }
+
+    if (dedicatedAllocationCount_ > 0)
+        std::cerr << dedicatedAllocationCount_ << " dedicated allocations were never freed." << std::endl;
+}
+
+Buffer MemoryAllocator::createBuffer(const VkBufferCreateInfo& bufferInfo, MemoryUsage usage) {
+    auto buffer = Buffer{};
+    if (vkCreateBuffer(device_, &bufferInfo, nullptr, &buffer.buffer) != VK_SUCCESS)
+        throw std::runtime_error("Failed to create buffer.");
+
+    auto requirements = VkMemoryRequirements{};
+    vkGetBufferMemoryRequirements(device_, buffer.buffer, &requirements);
+
+    try {
+        buffer.allocation = allocate(requirements, usage, true);
+    } catch (...) {
+        vkDestroyBuffer(device_, buffer.buffer, nullptr);
+        throw;
+    }
+
+    if (vkBindBufferMemory(device_, buffer.buffer, buffer.allocation.memory, buffer.allocation.offset) != VK_SUCCESS) {
+        destroyBuffer(buffer);
+        throw std::runtime_error("Failed to bind buffer memory.");
+    }
+
+    return buffer;
+}
+
+void MemoryAllocator::destroyBuffer(Buffer& buffer) {
+    if (buffer.buffer != VK_NULL_HANDLE)
+        vkDestroyBuffer(device_, buffer.buffer, nullptr);
+    free(buffer.allocation);
+    buffer = {};
+}
+
+Image MemoryAllocator::createImage(const VkImageCreateInfo& imageInfo, MemoryUsage usage) {
+    auto image = Image{};
+    if (vkCreateImage(device_, &imageInfo, nullptr, &image.image) != VK_SUCCESS)
+        throw std::runtime_error("Failed to create image.");
+
+    auto requirements = VkMemoryRequirements{};
+    vkGetImageMemoryRequirements(device_, image.image, &requirements);
+
+    try {
+        image.allocation = allocate(requirements, usage, imageInfo.tiling == VK_IMAGE_TILING_LINEAR);
+    } catch (...) {
+        vkDestroyImage(device_, image.image, nullptr);
+        throw;
+    }
+
+    if (vkBindImageMemory(device_, image.image, image.allocation.memory, image.allocation.offset) != VK_SUCCESS) {
+        destroyImage(image);
+        throw std::runtime_error("Failed to bind image memory.");
+    }
+
+    return image;
+}
+
+void MemoryAllocator::destroyImage(Image& image) {
+    if (image.image != VK_NULL_HANDLE)
+        vkDestroyImage(device_, image.image, nullptr);
+    free(image.allocation);
+    image = {};
+}
+
+Allocation MemoryAllocator::allocate(const VkMemoryRequirements& requirements, MemoryUsage usage, bool linear) {
+    std::lock_guard<std::mutex> lock(mutex_);
+
+    auto memoryType = findMemoryType_(requirements.memoryTypeBits, usage);
+    auto blockSize = blockSizeFor_(memoryType);
+    auto allocation = Allocation{};
+
+    if (requirements.size > blockSize / dedicatedThresholdDivisor) {
+        allocation.memory = allocateDeviceMemory_(requirements.size, memoryType, &allocation.mapped);
+        allocation.size = requirements.size;
+        dedicatedAllocationCount_++;
+        return allocation;
+    }
+
+    // with a granularity of 1 linear and optimal resources may share pages, so one pool is enough
+    auto& pool = pools_[memoryType * 2 + (!linear && bufferImageGranularity_ > 1 ? 1 : 0)];
+
+    auto alignment = requirements.alignment;
+    Block* block = nullptr;
+    auto range = std::optional<TlsfAllocator::Range>{};
+    for (auto& candidate : pool.blocks) {
+        range = candidate->ranges.allocate(requirements.size, alignment);
+        if (range) {
+            block = candidate.get();
+            break;
+        }
+    }
+
+    if (!block) {
+        auto newBlock = std::make_unique<Block>(Block{VK_NULL_HANDLE, nullptr, TlsfAllocator(blockSize)});
+        newBlock->memory = allocateDeviceMemory_(blockSize, memoryType, &newBlock->mapped);
+        range = newBlock->ranges.allocate(requirements.size, alignment);
+        block = newBlock.get();
+        pool.blocks.push_back(std::move(newBlock));
+    }
+
+    allocation.memory = block->memory;
+    allocation.offset = range->offset;
+    allocation.size = requirements.size;
+    allocation.mapped = block->mapped ? static_cast<char*>(block->mapped) + range->offset : nullptr;
+    allocation.block = block;
+    allocation.node = range->node;
+
+    return allocation;
+}
+
+void MemoryAllocator::free(Allocation& allocation) {
+    if (allocation.memory == VK_NULL_HANDLE)
+        return;
+
+    std::lock_guard<std::mutex> lock(mutex_);
+
+    if (!allocation.block) {
+        // unmapping is implicit in vkFreeMemory
+        vkFreeMemory(device_, allocation.memory, nullptr);
+        deviceAllocationCount_--;
+        dedicatedAllocationCount_--;
+        allocation = {};
+        return;
+    }
+
+    auto block = static_cast<Block*>(allocation.block);
+    block->ranges.free(allocation.node);
+
+    // keep one empty block per pool around so a free followed by an allocate does not hit the driver
+    if (block->ranges.allocationCount() == 0)
+        for (auto& pool : pools_) {
+            auto found = std::find_if(pool.blocks.begin(), pool.blocks.end(), [block](const std::unique_ptr<Block>& candidate) {
+                return candidate.get() == block;
+            });
+            if (found == pool.blocks.end())
+                continue;
+
+            auto emptyBlocks = std::count_if(pool.blocks.begin(), pool.blocks.end(), [](const std::unique_ptr<Block>& candidate) {
+                return candidate->ranges.allocationCount() == 0;
+            });
+            if (emptyBlocks > 1) {
+                vkFreeMemory(device_, block->memory, nullptr);
+                deviceAllocationCount_--;
+                pool.blocks.erase(found);
+            }
+            break;
+        }
+
+    allocation = {};
+}
+
+MemoryStats MemoryAllocator::getStats() {
+    std::lock_guard<std::mutex> lock(mutex_);
+
+    auto stats = MemoryStats{};
+    stats.dedicatedAllocationCount = dedicatedAllocationCount_;
+    for (const auto& pool : pools_)
+        for (const auto& block : pool.blocks) {
+            stats.blockCount++;
+            stats.allocationCount += block->ranges.allocationCount();
+            stats.reservedBytes += block->ranges.size();
+            stats.usedBytes += block->ranges.usedBytes();
+            stats.largestFreeRange = std::max(stats.largestFreeRange, block->ranges.largestFreeRange());
+            stats.freeRangeCount += block->ranges.freeRangeCount();
+        }
+    stats.freeBytes = stats.reservedBytes - stats.usedBytes;
+
+    if (stats.freeBytes > 0)
+        stats.fragmentation = 1.0 - static_cast<double>(stats.largestFreeRange) / stats.freeBytes;
+
+    return stats;
+}
+
+void MemoryAllocator::printStats() {
+    auto stats = getStats();
+    std::cout << "Device memory: " << stats.blockCount << " blocks, " << stats.dedicatedAllocationCount << " dedicated, "
+              << stats.allocationCount << " suballocations, " << stats.usedBytes / 1024 << " of " << stats.reservedBytes / 1024
+              << " KiB used, " << stats.freeRangeCount << " free ranges, fragmentation " << stats.fragmentation << std::endl;
+}
+
+uint32_t MemoryAllocator::findMemoryType_(uint32_t memoryTypeBits, MemoryUsage usage) const {
+    VkMemoryPropertyFlags required = 0, preferred = 0;
+    switch (usage) {
+    case MemoryUsage::GpuOnly:
+        preferred = VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT;
+        break;
+    case MemoryUsage::CpuToGpu:
+        required = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
+        break;
+    case MemoryUsage::GpuToCpu:
+        required = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
+        preferred = VK_MEMORY_PROPERTY_HOST_CACHED_BIT;
+        break;
+    }
+
+    for (auto flags : {required | preferred, required})
+        for (uint32_t i = 0; i < memoryProperties_.memoryTypeCount; i++)
+            if ((memoryTypeBits & (1 << i)) && (memoryProperties_.memoryTypes[i].propertyFlags & flags) == flags)
+                return i;
+
+    throw std::runtime_error("Failed to find suitable memory type.");
+}
+
+VkDeviceSize MemoryAllocator::blockSizeFor_(uint32_t memoryType) const {
+    // small heaps, like the 256 MiB device local and host visible window, get proportionally smaller blocks
+    auto heapSize = memoryProperties_.memoryHeaps[memoryProperties_.memoryTypes[memoryType].heapIndex].size;
+    return std::min(blockSize_, heapSize / 8);
+}
+
+VkDeviceMemory MemoryAllocator::allocateDeviceMemory_(VkDeviceSize size, uint32_t memoryType, void** mapped) {
+    if (deviceAllocationCount_ >= maxAllocationCount_)
+        throw std::runtime_error("Failed to allocate memory, maxMemoryAllocationCount reached.");
+
+    auto allocateInfo = VkMemoryAllocateInfo{};
+    allocateInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+    allocateInfo.allocationSize = size;
+    allocateInfo.memoryTypeIndex = memoryType;
+
+    VkDeviceMemory memory;
+    if (vkAllocateMemory(device_, &allocateInfo, nullptr, &memory) != VK_SUCCESS)
+        throw std::runtime_error("Failed to allocate memory.");
+    deviceAllocationCount_++;
+
+    // host visible memory stays mapped for its whole lifetime
+    *mapped = nullptr;
+    if (memoryProperties_.memoryTypes[memoryType].propertyFlags & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT)
+        if (vkMapMemory(device_, memory, 0, VK_WHOLE_SIZE, 0, mapped) != VK_SUCCESS) {
+            vkFreeMemory(device_, memory, nullptr);
+            deviceAllocationCount_--;
+            throw std::runtime_error("Failed to map memory.");
+        }
+
+    return memory;
+}
\ No newline at end of file
@@ -0,0 +1,160 @@
+#pragma once
+
+#include <vector>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <vulkan/vulkan.h>
+
+// two-level segregated fit allocator over an abstract [0, size) range, O(1) allocate and free
+class TlsfAllocator {
+public:
+
+    struct Range {
+        VkDeviceSize offset;
+        uint32_t node;
+    };
+
+    TlsfAllocator(VkDeviceSize size);
+
+    std::optional<Range> allocate(VkDeviceSize size, VkDeviceSize alignment);
+    void free(uint32_t node);
+
+    VkDeviceSize size() const { return size_; }
+    VkDeviceSize usedBytes() const { return usedBytes_; }
+    uint32_t allocationCount() const { return allocationCount_; }
+    VkDeviceSize largestFreeRange() const;
+    uint32_t freeRangeCount() const;
+
+private:
+
+    static constexpr uint32_t secondLevelLog2 = 4;
+    static constexpr uint32_t secondLevelCount = 1 << secondLevelLog2;
+    // everything below 2^smallLog2 bytes shares the first first-level list
+    static constexpr uint32_t smallLog2 = 8;
+    static constexpr uint32_t firstLevelCount = 64 - smallLog2 + 1;
+    static constexpr uint32_t none = UINT32_MAX;
+
+    struct Node {
+        VkDeviceSize offset = 0;
+        VkDeviceSize size = 0;
+        uint32_t previousPhysical = none;
+        uint32_t nextPhysical = none;
+        uint32_t previousFree = none;
+        uint32_t nextFree = none;
+        bool free = false;
+    };
+
+    VkDeviceSize size_;
+    VkDeviceSize usedBytes_ = 0;
+    uint32_t allocationCount_ = 0;
+
+    std::vector<Node> nodes_;
+    std::vector<uint32_t> unusedNodes_;
+
+    uint64_t firstLevelBitmap_ = 0;
+    uint32_t secondLevelBitmaps_[firstLevelCount] = {};
+    uint32_t freeHeads_[firstLevelCount][secondLevelCount];
+
+    uint32_t createNode_();
+    void releaseNode_(uint32_t node);
+    void insertFree_(uint32_t node);
+    void removeFree_(uint32_t node);
+    uint32_t findFree_(VkDeviceSize size) const;
+    static void mapping_(VkDeviceSize size, uint32_t& firstLevel, uint32_t& secondLevel);
+};
+
+enum class MemoryUsage {
+    // device local, never touched by the host
+    GpuOnly,
+    // host visible and coherent, persistently mapped, for uploads and per-frame data
+    CpuToGpu,
+    // host visible and preferably cached, persistently mapped, for readbacks
+    GpuToCpu,
+};
+
+struct Allocation {
+    VkDeviceMemory memory = VK_NULL_HANDLE;
+    VkDeviceSize offset = 0;
+    VkDeviceSize size = 0;
+    // points at offset when the memory is host visible
+    void* mapped = nullptr;
+
+    // null for dedicated allocations
+    void* block = nullptr;
+    uint32_t node = 0;
+};
+
+struct Buffer {
+    VkBuffer buffer = VK_NULL_HANDLE;
+    Allocation allocation;
+};
+
+struct Image {
+    VkImage image = VK_NULL_HANDLE;
+    Allocation allocation;
+};
+
+struct MemoryStats {
+    uint32_t blockCount = 0;
+    uint32_t dedicatedAllocationCount = 0;
+    uint32_t allocationCount = 0;
+    VkDeviceSize reservedBytes = 0;
+    VkDeviceSize usedBytes = 0;
+    VkDeviceSize freeBytes = 0;
+    VkDeviceSize largestFreeRange = 0;
+    uint32_t freeRangeCount = 0;
+    // 0 when all free memory is one range, towards 1 the more it is scattered
+    double fragmentation = 0;
+};
+
+// sub-allocates buffers and images from large vkAllocateMemory blocks, one set of blocks per
+// memory type; linear and optimal resources get separate blocks when bufferImageGranularity demands it
+class MemoryAllocator {
+public:
+
+    MemoryAllocator(VkPhysicalDevice physicalDevice, VkDevice device, VkDeviceSize blockSize = 64ull * 1024 * 1024);
+    ~MemoryAllocator();
+
+    Buffer createBuffer(const VkBufferCreateInfo& bufferInfo, MemoryUsage usage);
+    void destroyBuffer(Buffer& buffer);
+
+    Image createImage(const VkImageCreateInfo& imageInfo, MemoryUsage usage);
+    void destroyImage(Image& image);
+
+    // for resources bound by the caller, such as aliased render targets
+    Allocation allocate(const VkMemoryRequirements& requirements, MemoryUsage usage, bool linear);
+    void free(Allocation& allocation);
+
+    MemoryStats getStats();
+    void printStats();
+
+private:
+
+    struct Block {
+        VkDeviceMemory memory;
+        void* mapped;
+        TlsfAllocator ranges;
+    };
+
+    struct Pool {
+        std::vector<std::unique_ptr<Block>> blocks;
+    };
+
+    VkPhysicalDevice physicalDevice_;
+    VkDevice device_;
+    VkDeviceSize blockSize_;
+    VkDeviceSize bufferImageGranularity_;
+    uint32_t maxAllocationCount_;
+    VkPhysicalDeviceMemoryProperties memoryProperties_;
+
+    std::mutex mutex_;
+    // indexed by memory type * 2 + (optimal tiling ? 1 : 0)
+    std::vector<Pool> pools_;
+    uint32_t deviceAllocationCount_ = 0;
+    uint32_t dedicatedAllocationCount_ = 0;
+
+    uint32_t findMemoryType_(uint32_t memoryTypeBits, MemoryUsage usage) const;
+    VkDeviceSize blockSizeFor_(uint32_t memoryType) const;
+    VkDeviceMemory allocateDeviceMemory_(VkDeviceSize size, uint32_t memoryType, void** mapped);
+};
\ No newline at end of file
@@ -0,0 +1,114 @@
+#include "meshPool.hpp"
+#include <stdexcept>
+#include <algorithm>
+#include <cmath>
+
+MeshPool::MeshPool(MemoryAllocator& allocator, UploadManager& uploadManager, uint32_t maxVertices, uint32_t maxIndices)
+    : allocator_(allocator), uploadManager_(uploadManager), vertexRanges_(maxVertices), indexRanges_(maxIndices) {
+    auto bufferInfo = VkBufferCreateInfo{};
+    bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+    bufferInfo.size = static_cast<VkDeviceSize>(maxVertices) * sizeof(Vertex);
+    bufferInfo.usage = VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT;
+    bufferInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+
+    vertexBuffer_ = allocator_.createBuffer(bufferInfo, MemoryUsage::GpuOnly);
+
+    bufferInfo.size = static_cast<VkDeviceSize>(maxIndices) * sizeof(uint32_t);
+    bufferInfo.usage = VK_BUFFER_USAGE_INDEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT;
+
+    indexBuffer_ = allocator_.createBuffer(bufferInfo, MemoryUsage::GpuOnly);
+}
+
+MeshPool::~MeshPool() {
+    allocator_.destroyBuffer(indexBuffer_);
+    allocator_.destroyBuffer(vertexBuffer_);
+}
+
+MeshHandle MeshPool::addMesh(const std::vector<Vertex>& vertices, const std::vector<uint32_t>& indices) {
+    if (vertices.empty() || indices.empty())
+        throw std::runtime_error("Failed to add mesh, it has no vertices or no indices.");
+
+    auto entry = Entry{};
+
+    // centered on the bounding box, which is tight enough for culling and needs no iteration
+    float minimum[3] = {vertices[0].position[0], vertices[0].position[1], vertices[0].position[2]};
+    float maximum[3] = {minimum[0], minimum[1], minimum[2]};
+    for (const auto& vertex : vertices)
+        for (auto axis = 0; axis < 3; axis++) {
+            minimum[axis] = std::min(minimum[axis], vertex.position[axis]);
+            maximum[axis] = std::max(maximum[axis], vertex.position[axis]);
+        }
+
+    for (auto axis = 0; axis < 3; axis++)
+        entry.mesh.boundingSphere[axis] = (minimum[axis] + maximum[axis]) / 2;
+
+    float radiusSquared = 0;
+    for (const auto& vertex : vertices) {
+        float distanceSquared = 0;
+        for (auto axis = 0; axis < 3; axis++)
+            distanceSquared += (vertex.position[axis] - entry.mesh.boundingSphere[axis]) * (vertex.position[axis] - entry.mesh.boundingSphere[axis]);
+        radiusSquared = std::max(radiusSquared, distanceSquared);
+    }
+    entry.mesh.boundingSphere[3] = std::sqrt(radiusSquared);
+
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+
+        auto vertexRange = vertexRanges_.allocate(vertices.size(), 1);
+        if (!vertexRange)
+            throw std::runtime_error("Failed to add mesh, the mesh pool is out of vertex space.");
+
+        auto indexRange = indexRanges_.allocate(indices.size(), 1);
+        if (!indexRange) {
+            vertexRanges_.free(vertexRange->node);
+            throw std::runtime_error("Failed to add mesh, the mesh pool is out of index space.");
+        }
+
+        entry.mesh.indexCount = static_cast<uint32_t>(indices.size());
+        entry.mesh.firstIndex = static_cast<uint32_t>(indexRange->offset);
+        entry.mesh.vertexOffset = static_cast<int32_t>(vertexRange->offset);
+        entry.mesh.valid = true;
+        entry.vertexNode = vertexRange->node;
+        entry.indexNode = indexRange->node;
+    }
+
+    // indices stay relative to the mesh, vertexOffset rebases them when drawing
+    uploadManager_.uploadBuffer(vertexBuffer_.buffer, entry.mesh.vertexOffset * sizeof(Vertex), vertices.data(), vertices.size() * sizeof(Vertex),
+        VK_PIPELINE_STAGE_VERTEX_INPUT_BIT, VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT);
+    uploadManager_.uploadBuffer(indexBuffer_.buffer, entry.mesh.firstIndex * sizeof(uint32_t), indices.data(), indices.size() * sizeof(uint32_t),
+        VK_PIPELINE_STAGE_VERTEX_INPUT_BIT, VK_ACCESS_INDEX_READ_BIT);
+
+    std::lock_guard<std::mutex> lock(mutex_);
+
+    if (!freeHandles_.empty()) {
+        auto mesh = freeHandles_.back();
+        freeHandles_.pop_back();
+        entries_[mesh] = entry;
+        return mesh;
+    }
+
+    entries_.push_back(entry);
+    return static_cast<MeshHandle>(entries_.size() - 1);
+}
+
+void MeshPool::removeMesh(MeshHandle mesh) {
+    std::lock_guard<std::mutex> lock(mutex_);
+
+    if (mesh >= entries_.size() || !entries_[mesh].mesh.valid)
+        throw std::runtime_error("Failed to remove mesh, the handle is not valid.");
+
+    vertexRanges_.free(entries_[mesh].vertexNode);
+    indexRanges_.free(entries_[mesh].indexNode);
+    entries_[mesh] = {};
+    freeHandles_.push_back(mesh);
+}
+
+Mesh MeshPool::getMesh(MeshHandle mesh) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return mesh < entries_.size() ? entries_[mesh].mesh : Mesh{};
+}
+
+uint32_t MeshPool::handleCount() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return static_cast<uint32_t>(entries_.size());
+}
\ No newline at end of file
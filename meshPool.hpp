@@ -0,0 +1,65 @@
+#pragma once
+
+#include <vector>
+#include <mutex>
+#include <vulkan/vulkan.h>
+#include "memoryAllocator.hpp"
+#include "uploadManager.hpp"
+
+struct Vertex {
+    float position[3];
+    float color[3];
+};
+
+using MeshHandle = uint32_t;
+
+struct Mesh {
+    uint32_t indexCount = 0;
+    uint32_t firstIndex = 0;
+    int32_t vertexOffset = 0;
+    // center and radius in model space, for culling
+    float boundingSphere[4] = {};
+    bool valid = false;
+};
+
+// every mesh lives in one shared vertex buffer and one shared index buffer, so any set of meshes
+// can be drawn with a single binding and a single indirect call
+class MeshPool {
+public:
+
+    MeshPool(MemoryAllocator& allocator, UploadManager& uploadManager, uint32_t maxVertices = 1 << 20, uint32_t maxIndices = 1 << 22);
+    ~MeshPool();
+
+    // thread safe, the data reaches the gpu through the upload manager before the next frame uses it
+    MeshHandle addMesh(const std::vector<Vertex>& vertices, const std::vector<uint32_t>& indices);
+    // the caller must make sure no frame in flight still draws the mesh
+    void removeMesh(MeshHandle mesh);
+
+    Mesh getMesh(MeshHandle mesh);
+    // every handle handed out so far is below this
+    uint32_t handleCount();
+
+    VkBuffer getVertexBuffer() const { return vertexBuffer_.buffer; }
+    VkBuffer getIndexBuffer() const { return indexBuffer_.buffer; }
+
+private:
+
+    MemoryAllocator& allocator_;
+    UploadManager& uploadManager_;
+
+    Buffer vertexBuffer_;
+    Buffer indexBuffer_;
+    // ranges are counted in vertices and indices rather than bytes
+    TlsfAllocator vertexRanges_;
+    TlsfAllocator indexRanges_;
+
+    struct Entry {
+        Mesh mesh;
+        uint32_t vertexNode;
+        uint32_t indexNode;
+    };
+
+    std::mutex mutex_;
+    std::vector<Entry> entries_;
+    std::vector<MeshHandle> freeHandles_;
+};
\ No newline at end of file
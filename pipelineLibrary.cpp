@@ -0,0 +1,286 @@
+#include "pipelineLibrary.hpp"
+#include <stdexcept>
+#include <cstddef>
+#include "meshPool.hpp"
+#include "drawBatcher.hpp"
+#include "profiler.hpp"
+
+bool PipelineDescription::operator==(const PipelineDescription& other) const {
+    return vertexShader == other.vertexShader && fragmentShader == other.fragmentShader && topology == other.topology &&
+        polygonMode == other.polygonMode && cullMode == other.cullMode && frontFace == other.frontFace &&
+        depthTest == other.depthTest && depthWrite == other.depthWrite && depthCompareOp == other.depthCompareOp &&
+        alphaBlend == other.alphaBlend && renderPass == other.renderPass && subpass == other.subpass;
+}
+
+uint64_t PipelineDescription::hash() const {
+    uint32_t state[] = {
+        static_cast<uint32_t>(topology),
+        static_cast<uint32_t>(polygonMode),
+        static_cast<uint32_t>(cullMode),
+        static_cast<uint32_t>(frontFace),
+        depthTest,
+        depthWrite,
+        static_cast<uint32_t>(depthCompareOp),
+        alphaBlend,
+        subpass,
+    };
+
+    // shader names are hashed with their terminator, so "a" + "bc" and "ab" + "c" differ
+    auto key = Utilities::hashBytes(vertexShader.c_str(), vertexShader.size() + 1);
+    key = Utilities::hashBytes(fragmentShader.c_str(), fragmentShader.size() + 1, key);
+    key = Utilities::hashBytes(state, sizeof(state), key);
+    return Utilities::hashBytes(&renderPass, sizeof(renderPass), key);
+}
+
+PipelineLibrary::PipelineLibrary(VkDevice device, ShaderCompiler& shaderCompiler, VkPipelineCache pipelineCache, const BindlessDescriptors& bindless)
+    : device_(device), shaderCompiler_(shaderCompiler), pipelineCache_(pipelineCache),
+    specializationData_{bindless.getTextureCapacity(), bindless.getBufferCapacity()} {
+    auto pushConstantRange = VkPushConstantRange{};
+    pushConstantRange.stageFlags = VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT;
+    pushConstantRange.size = sizeof(DrawConstants);
+
+    auto setLayout = bindless.getLayout();
+
+    auto pipelineLayoutInfo = VkPipelineLayoutCreateInfo{};
+    pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+    pipelineLayoutInfo.setLayoutCount = 1;
+    pipelineLayoutInfo.pSetLayouts = &setLayout;
+    pipelineLayoutInfo.pushConstantRangeCount = 1;
+    pipelineLayoutInfo.pPushConstantRanges = &pushConstantRange;
+
+    if (vkCreatePipelineLayout(device_, &pipelineLayoutInfo, nullptr, &layout_) != VK_SUCCESS)
+        throw std::runtime_error("Failed to create pipeline layout.");
+}
+
+PipelineLibrary::~PipelineLibrary() {
+    for (auto& [description, pipeline] : pipelines_)
+        vkDestroyPipeline(device_, pipeline, nullptr);
+
+    vkDestroyPipelineLayout(device_, layout_, nullptr);
+}
+
+VkPipeline PipelineLibrary::get(const PipelineDescription& description) {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        auto found = pipelines_.find(description);
+        if (found != pipelines_.end())
+            return found->second;
+    }
+
+    // created outside the lock so other variants stay available meanwhile, a thread that lost the race drops its copy
+    auto pipeline = create_(description);
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto [entry, inserted] = pipelines_.emplace(description, pipeline);
+    if (!inserted)
+        vkDestroyPipeline(device_, pipeline, nullptr);
+
+    return entry->second;
+}
+
+void PipelineLibrary::prewarm(const std::vector<PipelineDescription>& descriptions, Utilities::JobSystem& jobSystem) {
+    jobSystem.parallelFor(static_cast<uint32_t>(descriptions.size()), [&](uint32_t i) {
+        get(descriptions[i]);
+    });
+}
+
+std::vector<std::pair<PipelineDescription, VkPipeline>> PipelineLibrary::rebuild(Utilities::JobSystem& jobSystem) {
+    std::vector<PipelineDescription> descriptions;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        for (auto& [description, pipeline] : pipelines_)
+            descriptions.push_back(description);
+    }
+
+    // every variant is attempted even after a failure, so all that were created can be destroyed
+    std::vector<std::pair<PipelineDescription, VkPipeline>> variants;
+    for (auto& description : descriptions)
+        variants.emplace_back(description, VK_NULL_HANDLE);
+
+    try {
+        jobSystem.parallelFor(static_cast<uint32_t>(variants.size()), [&](uint32_t i) {
+            variants[i].second = create_(variants[i].first);
+        });
+    }
+    catch (...) {
+        for (auto& [description, pipeline] : variants)
+            if (pipeline != VK_NULL_HANDLE)
+                vkDestroyPipeline(device_, pipeline, nullptr);
+        throw;
+    }
+
+    return variants;
+}
+
+std::vector<VkPipeline> PipelineLibrary::replace(std::vector<std::pair<PipelineDescription, VkPipeline>> variants) {
+    std::vector<VkPipeline> replaced;
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    for (auto& [description, pipeline] : variants) {
+        auto& entry = pipelines_[description];
+        if (entry != VK_NULL_HANDLE)
+            replaced.push_back(entry);
+        entry = pipeline;
+    }
+
+    return replaced;
+}
+
+size_t PipelineLibrary::size() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return pipelines_.size();
+}
+
+VkPipeline PipelineLibrary::create_(const PipelineDescription& description) {
+    PROFILE_SCOPE("PipelineLibrary::createGraphicsPipeline");
+    // compile both stages before creating anything, so a shader error leaves nothing to clean up
+    auto vertShaderCode = shaderCompiler_.compile(description.vertexShader);
+    auto fragShaderCode = shaderCompiler_.compile(description.fragmentShader);
+
+    auto shaderModule = createShaderModule_(vertShaderCode);
+
+    VkSpecializationMapEntry specializationEntries[] = {
+        {0, 0, sizeof(uint32_t)},
+        {1, sizeof(uint32_t), sizeof(uint32_t)},
+    };
+
+    auto specializationInfo = VkSpecializationInfo{};
+    specializationInfo.mapEntryCount = 2;
+    specializationInfo.pMapEntries = specializationEntries;
+    specializationInfo.dataSize = sizeof(specializationData_);
+    specializationInfo.pData = specializationData_;
+
+    auto pipelineShaderStageInfo = VkPipelineShaderStageCreateInfo{};
+    pipelineShaderStageInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+    pipelineShaderStageInfo.stage = VK_SHADER_STAGE_VERTEX_BIT;
+    pipelineShaderStageInfo.module = shaderModule;
+    pipelineShaderStageInfo.pName = "main";
+    pipelineShaderStageInfo.pSpecializationInfo = &specializationInfo;
+
+    auto fshaderModule = createShaderModule_(fragShaderCode);
+
+    auto fpipelineShaderStageInfo = VkPipelineShaderStageCreateInfo{};
+    fpipelineShaderStageInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+    fpipelineShaderStageInfo.stage = VK_SHADER_STAGE_FRAGMENT_BIT;
+    fpipelineShaderStageInfo.module = fshaderModule;
+    fpipelineShaderStageInfo.pName = "main";
+    fpipelineShaderStageInfo.pSpecializationInfo = &specializationInfo;
+
+    VkPipelineShaderStageCreateInfo shaderStages[] = { pipelineShaderStageInfo, fpipelineShaderStageInfo };
+
+    // binding 0 holds the mesh pool's vertices, binding 1 the draw batcher's per-instance model matrices
+    VkVertexInputBindingDescription vertexBindings[] = {
+        {0, sizeof(Vertex), VK_VERTEX_INPUT_RATE_VERTEX},
+        {1, sizeof(InstanceData), VK_VERTEX_INPUT_RATE_INSTANCE},
+    };
+
+    VkVertexInputAttributeDescription vertexAttributes[] = {
+        {0, 0, VK_FORMAT_R32G32B32_SFLOAT, offsetof(Vertex, position)},
+        {1, 0, VK_FORMAT_R32G32B32_SFLOAT, offsetof(Vertex, color)},
+        {2, 1, VK_FORMAT_R32G32B32A32_SFLOAT, 0},
+        {3, 1, VK_FORMAT_R32G32B32A32_SFLOAT, 16},
+        {4, 1, VK_FORMAT_R32G32B32A32_SFLOAT, 32},
+        {5, 1, VK_FORMAT_R32G32B32A32_SFLOAT, 48},
+    };
+
+    auto vertexInputInfo = VkPipelineVertexInputStateCreateInfo{};
+    vertexInputInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
+    vertexInputInfo.vertexBindingDescriptionCount = 2;
+    vertexInputInfo.pVertexBindingDescriptions = vertexBindings;
+    vertexInputInfo.vertexAttributeDescriptionCount = 6;
+    vertexInputInfo.pVertexAttributeDescriptions = vertexAttributes;
+
+    auto inputAssemblyInfo = VkPipelineInputAssemblyStateCreateInfo{};
+    inputAssemblyInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO;
+    inputAssemblyInfo.topology = description.topology;
+
+    // viewport and scissor are set while recording, so resizing never invalidates a variant
+    auto viewportStateInfo = VkPipelineViewportStateCreateInfo{};
+    viewportStateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO;
+    viewportStateInfo.viewportCount = 1;
+    viewportStateInfo.scissorCount = 1;
+
+    VkDynamicState dynamicStates[] = { VK_DYNAMIC_STATE_VIEWPORT, VK_DYNAMIC_STATE_SCISSOR };
+
+    auto dynamicStateInfo = VkPipelineDynamicStateCreateInfo{};
+    dynamicStateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_DYNAMIC_STATE_CREATE_INFO;
+    dynamicStateInfo.dynamicStateCount = 2;
+    dynamicStateInfo.pDynamicStates = dynamicStates;
+
+    auto rasterizerInfo = VkPipelineRasterizationStateCreateInfo{};
+    rasterizerInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_RASTERIZATION_STATE_CREATE_INFO;
+    rasterizerInfo.depthClampEnable = VK_FALSE;
+    rasterizerInfo.rasterizerDiscardEnable = VK_FALSE; // disables output to framebuffer if set to true
+    rasterizerInfo.polygonMode = description.polygonMode;
+    rasterizerInfo.cullMode = description.cullMode;
+    rasterizerInfo.frontFace = description.frontFace;
+    rasterizerInfo.depthBiasEnable = VK_FALSE;
+    rasterizerInfo.lineWidth = 1;
+
+    auto multisampleInfo = VkPipelineMultisampleStateCreateInfo{};
+    multisampleInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_MULTISAMPLE_STATE_CREATE_INFO;
+    multisampleInfo.rasterizationSamples = VK_SAMPLE_COUNT_1_BIT;
+    multisampleInfo.sampleShadingEnable = VK_FALSE;
+
+    auto depthStencilInfo = VkPipelineDepthStencilStateCreateInfo{};
+    depthStencilInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_DEPTH_STENCIL_STATE_CREATE_INFO;
+    depthStencilInfo.depthTestEnable = description.depthTest;
+    depthStencilInfo.depthWriteEnable = description.depthWrite;
+    depthStencilInfo.depthCompareOp = description.depthCompareOp;
+
+    auto colorBlendAttachmentState = VkPipelineColorBlendAttachmentState{};
+    colorBlendAttachmentState.blendEnable = description.alphaBlend;
+    colorBlendAttachmentState.srcColorBlendFactor = VK_BLEND_FACTOR_SRC_ALPHA;
+    colorBlendAttachmentState.dstColorBlendFactor = VK_BLEND_FACTOR_ONE_MINUS_SRC_ALPHA;
+    colorBlendAttachmentState.colorBlendOp = VK_BLEND_OP_ADD;
+    colorBlendAttachmentState.srcAlphaBlendFactor = VK_BLEND_FACTOR_ONE;
+    colorBlendAttachmentState.dstAlphaBlendFactor = VK_BLEND_FACTOR_ONE_MINUS_SRC_ALPHA;
+    colorBlendAttachmentState.alphaBlendOp = VK_BLEND_OP_ADD;
+    colorBlendAttachmentState.colorWriteMask = VK_COLOR_COMPONENT_R_BIT | VK_COLOR_COMPONENT_G_BIT | VK_COLOR_COMPONENT_B_BIT | VK_COLOR_COMPONENT_A_BIT;
+
+    auto colorBlendState = VkPipelineColorBlendStateCreateInfo{};
+    colorBlendState.sType = VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO;
+    colorBlendState.logicOpEnable = VK_FALSE;
+    colorBlendState.attachmentCount = 1;
+    colorBlendState.pAttachments = &colorBlendAttachmentState;
+
+    auto pipelineInfo = VkGraphicsPipelineCreateInfo{};
+    pipelineInfo.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
+    pipelineInfo.stageCount = 2;
+    pipelineInfo.pStages = shaderStages;
+    pipelineInfo.pVertexInputState = &vertexInputInfo;
+    pipelineInfo.pInputAssemblyState = &inputAssemblyInfo;
+    pipelineInfo.pViewportState = &viewportStateInfo;
+    pipelineInfo.pRasterizationState = &rasterizerInfo;
+    pipelineInfo.pMultisampleState = &multisampleInfo;
+    pipelineInfo.pDepthStencilState = &depthStencilInfo;
+    pipelineInfo.pColorBlendState = &colorBlendState;
+    pipelineInfo.pDynamicState = &dynamicStateInfo;
+    pipelineInfo.layout = layout_;
+    pipelineInfo.renderPass = description.renderPass;
+    pipelineInfo.subpass = description.subpass;
+
+    VkPipeline pipeline;
+    auto result = vkCreateGraphicsPipelines(device_, pipelineCache_, 1, &pipelineInfo, nullptr, &pipeline);
+
+    vkDestroyShaderModule(device_, shaderModule, nullptr);
+    vkDestroyShaderModule(device_, fshaderModule, nullptr);
+
+    if (result != VK_SUCCESS)
+        throw std::runtime_error("Failed to create graphics pipeline.");
+
+    return pipeline;
+}
+
+VkShaderModule PipelineLibrary::createShaderModule_(const SpirvCode& code) {
+    auto shaderModuleInfo = VkShaderModuleCreateInfo{};
+    shaderModuleInfo.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
+    shaderModuleInfo.codeSize = code.size() * sizeof(uint32_t);
+    shaderModuleInfo.pCode = code.data();
+
+    VkShaderModule shaderModule;
+    if (vkCreateShaderModule(device_, &shaderModuleInfo, nullptr, &shaderModule) != VK_SUCCESS)
+        throw std::runtime_error("Failed to create shader module.");
+
+    return shaderModule;
+}
\ No newline at end of file
@@ -0,0 +1,80 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include <mutex>
+#include <vulkan/vulkan.h>
+#include "shaderCompiler.hpp"
+#include "bindlessDescriptors.hpp"
+#include "utilities.hpp"
+
+// everything that makes one graphics pipeline differ from another, viewport and scissor are always dynamic
+struct PipelineDescription {
+    std::string vertexShader = "shaders/shader.vert";
+    std::string fragmentShader = "shaders/shader.frag";
+    VkPrimitiveTopology topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST;
+    VkPolygonMode polygonMode = VK_POLYGON_MODE_FILL;
+    VkCullModeFlags cullMode = VK_CULL_MODE_BACK_BIT;
+    VkFrontFace frontFace = VK_FRONT_FACE_CLOCKWISE;
+    bool depthTest = true;
+    bool depthWrite = true;
+    VkCompareOp depthCompareOp = VK_COMPARE_OP_LESS;
+    bool alphaBlend = false;
+    VkRenderPass renderPass = VK_NULL_HANDLE;
+    uint32_t subpass = 0;
+
+    bool operator==(const PipelineDescription& other) const;
+    uint64_t hash() const;
+};
+
+// push constants shared by every variant, visible to the vertex and fragment stages
+struct DrawConstants {
+    float viewProjection[16];
+    // index into the bindless texture table
+    uint32_t textureIndex;
+};
+
+// creates and owns every graphics pipeline variant, keyed by the hash of its description;
+// all variants take the mesh pool's vertices and the draw batcher's instances, and share one layout
+class PipelineLibrary {
+public:
+
+    PipelineLibrary(VkDevice device, ShaderCompiler& shaderCompiler, VkPipelineCache pipelineCache, const BindlessDescriptors& bindless);
+    ~PipelineLibrary();
+
+    // the bindless set as set 0 and DrawConstants as push constants
+    VkPipelineLayout getLayout() const { return layout_; }
+
+    // returns the variant, creating it on first use, safe to call from any thread
+    VkPipeline get(const PipelineDescription& description);
+    // creates the variants up front as jobs, so the frame path only ever hits the cache
+    void prewarm(const std::vector<PipelineDescription>& descriptions, Utilities::JobSystem& jobSystem);
+
+    // creates every variant known so far again from the current shader sources as jobs, leaving the cache as is;
+    // throws without leaking anything if a single one fails
+    std::vector<std::pair<PipelineDescription, VkPipeline>> rebuild(Utilities::JobSystem& jobSystem);
+    // swaps rebuilt variants in and hands back the pipelines they replace, which frames in flight may still use
+    std::vector<VkPipeline> replace(std::vector<std::pair<PipelineDescription, VkPipeline>> variants);
+
+    size_t size();
+
+private:
+
+    struct DescriptionHash {
+        size_t operator()(const PipelineDescription& description) const { return description.hash(); }
+    };
+
+    VkDevice device_;
+    ShaderCompiler& shaderCompiler_;
+    VkPipelineCache pipelineCache_;
+    VkPipelineLayout layout_;
+    // the bindless table capacities, the size of the shaders' descriptor arrays
+    uint32_t specializationData_[2];
+
+    std::mutex mutex_;
+    std::unordered_map<PipelineDescription, VkPipeline, DescriptionHash> pipelines_;
+
+    VkPipeline create_(const PipelineDescription& description);
+    VkShaderModule createShaderModule_(const SpirvCode& code);
+};
\ No newline at end of file
@@ -0,0 +1,133 @@
+#include "profiler.hpp"
+#include <vector>
+#include <memory>
+#include <mutex>
+#include <atomic>
+#include <chrono>
+#include <fstream>
+#include <stdexcept>
+#include <algorithm>
+
+namespace {
+
+    struct Event {
+        const char* name;
+        uint64_t begin;
+        // zones only
+        uint64_t end;
+        // counters only
+        double value;
+        bool counter;
+    };
+
+    // written by its thread alone, which publishes each event by moving head past it
+    struct ThreadEvents {
+        uint32_t id;
+        std::string name;
+        std::unique_ptr<Event[]> events = std::make_unique<Event[]>(Profiler::eventsPerThread);
+        std::atomic<uint64_t> head = 0;
+    };
+
+    // buffers outlive their threads, so a trace still holds the events of threads that have exited
+    std::mutex threadsMutex;
+    std::vector<std::unique_ptr<ThreadEvents>> threads;
+    thread_local ThreadEvents* currentThread = nullptr;
+
+    ThreadEvents& threadEvents() {
+        if (!currentThread) {
+            std::lock_guard<std::mutex> lock(threadsMutex);
+            threads.push_back(std::make_unique<ThreadEvents>());
+            currentThread = threads.back().get();
+            currentThread->id = static_cast<uint32_t>(threads.size());
+            currentThread->name = "Thread " + std::to_string(currentThread->id);
+        }
+        return *currentThread;
+    }
+
+    void record(const Event& event) {
+        auto& thread = threadEvents();
+        auto head = thread.head.load(std::memory_order_relaxed);
+        thread.events[head % Profiler::eventsPerThread] = event;
+        thread.head.store(head + 1, std::memory_order_release);
+    }
+
+    std::string escape(const std::string& text) {
+        std::string escaped;
+        for (auto character : text) {
+            if (character == '"' || character == '\\')
+                escaped += '\\';
+            escaped += character;
+        }
+        return escaped;
+    }
+}
+
+uint64_t Profiler::now() {
+    using Clock = std::chrono::steady_clock;
+    static const auto start = Clock::now();
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - start).count();
+}
+
+void Profiler::setThreadName(const std::string& name) {
+    auto& thread = threadEvents();
+    std::lock_guard<std::mutex> lock(threadsMutex);
+    thread.name = name;
+}
+
+void Profiler::zone(const char* name, uint64_t begin, uint64_t end) {
+    record({name, begin, end, 0, false});
+}
+
+void Profiler::counter(const char* name, double value) {
+    record({name, now(), 0, value, true});
+}
+
+void Profiler::writeChromeTrace(const std::string& filename) {
+    std::ofstream file(filename);
+    if (!file.is_open())
+        throw std::runtime_error("Failed to open " + filename + " for writing.");
+
+    // timestamps in microseconds, with the nanoseconds kept as decimals
+    auto microseconds = [](uint64_t nanoseconds) { return std::to_string(nanoseconds / 1000) + "." + std::to_string(nanoseconds % 1000 + 1000).substr(1); };
+
+    std::lock_guard<std::mutex> lock(threadsMutex);
+    file << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[";
+
+    auto first = true;
+    auto separator = [&] {
+        if (!first)
+            file << ",";
+        first = false;
+        file << "\n";
+    };
+
+    for (const auto& thread : threads) {
+        auto tid = std::to_string(thread->id);
+        separator();
+        file << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" << tid << ",\"args\":{\"name\":\"" << escape(thread->name) << "\"}}";
+
+        // copied out first, then whatever the thread overwrote during the copy is dropped
+        auto end = thread->head.load(std::memory_order_acquire);
+        auto begin = end > eventsPerThread ? end - eventsPerThread : 0;
+        std::vector<Event> events(end - begin);
+        for (auto i = begin; i < end; i++)
+            events[i - begin] = thread->events[i % eventsPerThread];
+
+        // the slot of the event being written holds the one eventsPerThread older still
+        auto written = thread->head.load(std::memory_order_acquire) + 1;
+        auto valid = written > eventsPerThread ? written - eventsPerThread : 0;
+
+        for (auto i = std::max(begin, valid); i < end; i++) {
+            const auto& event = events[i - begin];
+            separator();
+            if (event.counter)
+                file << "{\"name\":\"" << escape(event.name) << "\",\"ph\":\"C\",\"ts\":" << microseconds(event.begin)
+                    << ",\"pid\":1,\"tid\":" << tid << ",\"args\":{\"value\":" << event.value << "}}";
+            else
+                file << "{\"name\":\"" << escape(event.name) << "\",\"ph\":\"X\",\"ts\":" << microseconds(event.begin)
+                    << ",\"dur\":" << microseconds(event.end - event.begin) << ",\"pid\":1,\"tid\":" << tid << "}";
+        }
+    }
+
+    file << "\n]}\n";
+}
\ No newline at end of file
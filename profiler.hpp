@@ -0,0 +1,50 @@
+#pragma once
+
+#include <string>
+#include <cstdint>
+
+// scoped cpu zones and counters, compiled out unless PROFILING_ENABLED is defined; every thread records into a
+// ring of its own newest events without taking a lock, and writeChromeTrace turns all of them into a Chrome
+// trace event file, which chrome://tracing and ui.perfetto.dev open
+#ifdef PROFILING_ENABLED
+    #define PROFILE_CONCATENATE_(a, b) a##b
+    #define PROFILE_CONCATENATE(a, b) PROFILE_CONCATENATE_(a, b)
+    // names are kept by pointer, so they must outlive the capture, as string literals do
+    #define PROFILE_SCOPE(name) Profiler::Zone PROFILE_CONCATENATE(profileZone, __LINE__)(name)
+    #define PROFILE_COUNTER(name, value) Profiler::counter(name, static_cast<double>(value))
+    #define PROFILE_THREAD(name) Profiler::setThreadName(name)
+#else
+    #define PROFILE_SCOPE(name) ((void)0)
+    #define PROFILE_COUNTER(name, value) ((void)0)
+    #define PROFILE_THREAD(name) ((void)0)
+#endif
+
+namespace Profiler {
+    // per thread, the oldest are overwritten once a thread records more
+    constexpr uint32_t eventsPerThread = 1 << 16;
+
+    // nanoseconds since the first call
+    uint64_t now();
+
+    void setThreadName(const std::string& name);
+    void zone(const char* name, uint64_t begin, uint64_t end);
+    void counter(const char* name, double value);
+
+    // every thread's events so far, threads still recording may lose the events they overwrite meanwhile
+    void writeChromeTrace(const std::string& filename);
+
+    class Zone {
+    public:
+
+        Zone(const char* name) : name_(name), begin_(now()) {}
+        ~Zone() { zone(name_, begin_, now()); }
+
+        Zone(const Zone&) = delete;
+        Zone& operator=(const Zone&) = delete;
+
+    private:
+
+        const char* name_;
+        uint64_t begin_;
+    };
+}
\ No newline at end of file
@@ -0,0 +1,694 @@
+#include "renderGraph.hpp"
+#include <stdexcept>
+#include <algorithm>
+#include <numeric>
+#include "utilities.hpp"
+
+namespace {
+
+    const VkAccessFlags writeAccessMask = VK_ACCESS_SHADER_WRITE_BIT | VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT |
+        VK_ACCESS_TRANSFER_WRITE_BIT | VK_ACCESS_HOST_WRITE_BIT | VK_ACCESS_MEMORY_WRITE_BIT;
+
+    // what the graph knows about a resource at a point of the frame
+    struct TrackedState {
+        VkImageLayout layout = VK_IMAGE_LAYOUT_UNDEFINED;
+        // the last write or layout transition, and the reads since then
+        VkPipelineStageFlags writeStages = 0;
+        VkAccessFlags writeAccess = 0;
+        VkPipelineStageFlags readStages = 0;
+        // the stages and accesses that already waited for the last write
+        VkPipelineStageFlags visibleStages = 0;
+        VkAccessFlags visibleAccess = 0;
+        bool hasContents = false;
+    };
+
+    VkImageUsageFlags usageFor(const ResourceState& state) {
+        VkImageUsageFlags usage = 0;
+        if (state.access & (VK_ACCESS_COLOR_ATTACHMENT_READ_BIT | VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT))
+            usage |= VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT;
+        if (state.access & (VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT))
+            usage |= VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT;
+        if (state.access & VK_ACCESS_INPUT_ATTACHMENT_READ_BIT)
+            usage |= VK_IMAGE_USAGE_INPUT_ATTACHMENT_BIT;
+        if (state.access & VK_ACCESS_SHADER_WRITE_BIT)
+            usage |= VK_IMAGE_USAGE_STORAGE_BIT;
+        if (state.access & VK_ACCESS_SHADER_READ_BIT)
+            usage |= state.layout == VK_IMAGE_LAYOUT_GENERAL ? VK_IMAGE_USAGE_STORAGE_BIT : VK_IMAGE_USAGE_SAMPLED_BIT;
+        if (state.access & VK_ACCESS_TRANSFER_READ_BIT)
+            usage |= VK_IMAGE_USAGE_TRANSFER_SRC_BIT;
+        if (state.access & VK_ACCESS_TRANSFER_WRITE_BIT)
+            usage |= VK_IMAGE_USAGE_TRANSFER_DST_BIT;
+        return usage;
+    }
+
+    // folds one access into the pass's barriers, leaving out whatever an earlier barrier already covers
+    void track(std::vector<VkImageMemoryBarrier>& imageBarriers, VkPipelineStageFlags& srcStages, VkPipelineStageFlags& dstStages,
+        VkAccessFlags& srcAccess, VkAccessFlags& dstAccess, TrackedState& tracked, VkImage image, VkImageAspectFlags aspect,
+        const ResourceState& state, bool write) {
+        auto transition = image != VK_NULL_HANDLE && state.layout != tracked.layout;
+
+        if (transition || write) {
+            // a transition or a write must wait for every earlier access, reads included
+            auto waitStages = tracked.writeStages | tracked.readStages;
+
+            if (transition) {
+                auto imageBarrier = VkImageMemoryBarrier{};
+                imageBarrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+                imageBarrier.srcAccessMask = tracked.writeAccess;
+                imageBarrier.dstAccessMask = state.access;
+                imageBarrier.oldLayout = tracked.hasContents ? tracked.layout : VK_IMAGE_LAYOUT_UNDEFINED;
+                imageBarrier.newLayout = state.layout;
+                imageBarrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+                imageBarrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+                imageBarrier.image = image;
+                imageBarrier.subresourceRange = {aspect, 0, VK_REMAINING_MIP_LEVELS, 0, VK_REMAINING_ARRAY_LAYERS};
+                imageBarriers.push_back(imageBarrier);
+
+                srcStages |= waitStages ? waitStages : VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT;
+                dstStages |= state.stages;
+            }
+            else if (waitStages) {
+                srcStages |= waitStages;
+                dstStages |= state.stages;
+                if (tracked.writeAccess) {
+                    srcAccess |= tracked.writeAccess;
+                    dstAccess |= state.access;
+                }
+            }
+
+            tracked.layout = state.layout;
+            tracked.writeStages = state.stages;
+            tracked.writeAccess = write ? state.access & writeAccessMask : 0;
+            tracked.readStages = write ? 0 : state.stages;
+            tracked.visibleStages = state.stages;
+            tracked.visibleAccess = state.access;
+        }
+        else {
+            auto unseenStages = state.stages & ~tracked.visibleStages;
+            auto unseenAccess = tracked.writeAccess ? state.access & ~tracked.visibleAccess : 0;
+
+            if ((unseenStages || unseenAccess) && tracked.writeStages) {
+                srcStages |= tracked.writeStages;
+                dstStages |= state.stages;
+                if (tracked.writeAccess) {
+                    srcAccess |= tracked.writeAccess;
+                    dstAccess |= state.access;
+                }
+                tracked.visibleStages |= state.stages;
+                tracked.visibleAccess |= state.access;
+            }
+
+            tracked.readStages |= state.stages;
+        }
+
+        if (write)
+            tracked.hasContents = true;
+    }
+}
+
+void RenderGraph::PassBuilder::colorAttachment(RenderGraphResource image, std::optional<VkClearColorValue> clear) {
+    auto& pass = graph_.passes_[pass_];
+    if (!pass.graphics)
+        throw std::runtime_error("Only graphics passes have attachments.");
+
+    auto attachment = Attachment{image, false, clear.has_value(), {}};
+    if (clear)
+        attachment.clearValue.color = *clear;
+    pass.attachments.push_back(attachment);
+
+    auto state = ResourceState{VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT, VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL};
+    if (!clear)
+        state.access |= VK_ACCESS_COLOR_ATTACHMENT_READ_BIT;
+    pass.uses.push_back({image, state, true, clear.has_value()});
+}
+
+void RenderGraph::PassBuilder::depthAttachment(RenderGraphResource image, std::optional<VkClearDepthStencilValue> clear) {
+    auto& pass = graph_.passes_[pass_];
+    if (!pass.graphics)
+        throw std::runtime_error("Only graphics passes have attachments.");
+
+    auto attachment = Attachment{image, true, clear.has_value(), {}};
+    if (clear)
+        attachment.clearValue.depthStencil = *clear;
+    pass.attachments.push_back(attachment);
+
+    auto state = ResourceState{VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT,
+        VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT, VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL};
+    pass.uses.push_back({image, state, true, clear.has_value()});
+}
+
+void RenderGraph::PassBuilder::secondaryCommandBuffers() {
+    graph_.passes_[pass_].secondaryCommandBuffers = true;
+}
+
+void RenderGraph::PassBuilder::read(RenderGraphResource resource, const ResourceState& state) {
+    graph_.passes_[pass_].uses.push_back({resource, state, false});
+}
+
+void RenderGraph::PassBuilder::write(RenderGraphResource resource, const ResourceState& state) {
+    graph_.passes_[pass_].uses.push_back({resource, state, true});
+}
+
+void RenderGraph::PassBuilder::sideEffects() {
+    graph_.passes_[pass_].sideEffects = true;
+}
+
+RenderGraph::RenderGraph(VkDevice device, MemoryAllocator& allocator, Retire retire)
+    : device_(device), allocator_(allocator), retire_(std::move(retire)) {}
+
+RenderGraph::~RenderGraph() {
+    // the owner idles the device first, nothing is left to retire to
+    for (auto& transient : transients_) {
+        vkDestroyImageView(device_, transient.view, nullptr);
+        vkDestroyImage(device_, transient.image, nullptr);
+    }
+
+    for (auto& slot : slots_)
+        allocator_.free(slot);
+
+    for (auto& [key, framebuffer] : framebuffers_)
+        vkDestroyFramebuffer(device_, framebuffer, nullptr);
+
+    for (auto& [key, renderPass] : renderPasses_)
+        vkDestroyRenderPass(device_, renderPass, nullptr);
+}
+
+void RenderGraph::reset() {
+    passes_.clear();
+    resources_.clear();
+    finalBarriers_ = {};
+}
+
+RenderGraphResource RenderGraph::importImage(const std::string& name, VkImage image, VkImageView view, VkFormat format, VkExtent2D extent,
+    VkImageAspectFlags aspect, const ResourceState& initial, const ResourceState& final) {
+    auto resource = Resource{};
+    resource.name = name;
+    resource.isImage = true;
+    resource.imported = true;
+    resource.image = image;
+    resource.view = view;
+    resource.format = format;
+    resource.extent = extent;
+    resource.aspect = aspect;
+    resource.initial = initial;
+    resource.final = final;
+    return addResource_(resource);
+}
+
+RenderGraphResource RenderGraph::importBuffer(const std::string& name, VkBuffer buffer) {
+    auto resource = Resource{};
+    resource.name = name;
+    resource.isImage = false;
+    resource.imported = true;
+    resource.buffer = buffer;
+    return addResource_(resource);
+}
+
+RenderGraphResource RenderGraph::createImage(const std::string& name, const TransientImageDescription& description) {
+    auto resource = Resource{};
+    resource.name = name;
+    resource.isImage = true;
+    resource.imported = false;
+    resource.format = description.format;
+    resource.extent = description.extent;
+    resource.aspect = description.aspect;
+    return addResource_(resource);
+}
+
+void RenderGraph::addGraphicsPass(const std::string& name, const std::function<void(PassBuilder&)>& setup, Execute execute) {
+    addPass_(name, true, setup, std::move(execute));
+}
+
+void RenderGraph::addComputePass(const std::string& name, const std::function<void(PassBuilder&)>& setup, Execute execute) {
+    addPass_(name, false, setup, std::move(execute));
+}
+
+void RenderGraph::compile() {
+    cull_();
+
+    // lifetimes and usage of the transient images, in positions among the live passes
+    uint32_t position = 0;
+    for (auto& pass : passes_) {
+        if (!pass.live)
+            continue;
+
+        for (auto& use : pass.uses) {
+            auto& resource = resources_[use.resource];
+            resource.firstUse = std::min(resource.firstUse, position);
+            resource.lastUse = std::max(resource.lastUse, position);
+            if (!resource.imported)
+                resource.usage |= usageFor(use.state);
+        }
+        position++;
+    }
+
+    // the images and their memory are only rebuilt when the frame changes shape, say on a resize
+    std::vector<uint32_t> transientResources;
+    auto shape = Utilities::hashBytes(nullptr, 0);
+    for (uint32_t i = 0; i < resources_.size(); i++) {
+        auto& resource = resources_[i];
+        if (resource.imported || resource.firstUse == UINT32_MAX)
+            continue;
+
+        transientResources.push_back(i);
+        uint32_t description[] = {
+            static_cast<uint32_t>(resource.format), resource.extent.width, resource.extent.height,
+            resource.aspect, resource.usage, resource.firstUse, resource.lastUse,
+        };
+        shape = Utilities::hashBytes(description, sizeof(description), shape);
+    }
+
+    if (shape != transientShape_ || transientResources.size() != transients_.size()) {
+        releaseTransients_();
+
+        transients_.resize(transientResources.size());
+        for (uint32_t i = 0; i < transientResources.size(); i++) {
+            auto& resource = resources_[transientResources[i]];
+            transients_[i].firstUse = resource.firstUse;
+            transients_[i].lastUse = resource.lastUse;
+
+            auto imageInfo = VkImageCreateInfo{};
+            imageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+            imageInfo.imageType = VK_IMAGE_TYPE_2D;
+            imageInfo.format = resource.format;
+            imageInfo.extent = {resource.extent.width, resource.extent.height, 1};
+            imageInfo.mipLevels = 1;
+            imageInfo.arrayLayers = 1;
+            imageInfo.samples = VK_SAMPLE_COUNT_1_BIT;
+            imageInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+            imageInfo.usage = resource.usage;
+            imageInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+            imageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+
+            if (vkCreateImage(device_, &imageInfo, nullptr, &transients_[i].image) != VK_SUCCESS)
+                throw std::runtime_error("Failed to create transient image " + resource.name + ".");
+
+            vkGetImageMemoryRequirements(device_, transients_[i].image, &transients_[i].requirements);
+        }
+
+        allocateTransients_();
+
+        for (uint32_t i = 0; i < transientResources.size(); i++) {
+            auto& resource = resources_[transientResources[i]];
+
+            auto imageViewInfo = VkImageViewCreateInfo{};
+            imageViewInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+            imageViewInfo.image = transients_[i].image;
+            imageViewInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
+            imageViewInfo.format = resource.format;
+            imageViewInfo.subresourceRange = {resource.aspect, 0, 1, 0, 1};
+
+            if (vkCreateImageView(device_, &imageViewInfo, nullptr, &transients_[i].view) != VK_SUCCESS)
+                throw std::runtime_error("Failed to create transient image view " + resource.name + ".");
+        }
+
+        transientShape_ = shape;
+    }
+
+    for (uint32_t i = 0; i < transientResources.size(); i++) {
+        auto& resource = resources_[transientResources[i]];
+        resource.transient = i;
+        resource.image = transients_[i].image;
+        resource.view = transients_[i].view;
+
+        transients_[i].stages = 0;
+        transients_[i].writeAccess = 0;
+    }
+
+    for (auto& pass : passes_)
+        if (pass.live)
+            for (auto& use : pass.uses)
+                if (resources_[use.resource].transient != UINT32_MAX) {
+                    auto& transient = transients_[resources_[use.resource].transient];
+                    transient.stages |= use.state.stages;
+                    transient.writeAccess |= use.state.access & writeAccessMask;
+                }
+
+    planBarriers_();
+}
+
+void RenderGraph::execute(VkCommandBuffer commandBuffer) {
+    for (auto& pass : passes_) {
+        if (!pass.live)
+            continue;
+
+        recordBarriers_(commandBuffer, pass.barriers);
+
+        if (!pass.graphics) {
+            pass.execute(commandBuffer, pass.context);
+            continue;
+        }
+
+        auto renderPassBeginInfo = VkRenderPassBeginInfo{};
+        renderPassBeginInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
+        renderPassBeginInfo.renderPass = pass.context.renderPass;
+        renderPassBeginInfo.framebuffer = pass.context.framebuffer;
+        renderPassBeginInfo.renderArea.offset = {0, 0};
+        renderPassBeginInfo.renderArea.extent = pass.context.extent;
+        renderPassBeginInfo.clearValueCount = static_cast<uint32_t>(pass.clearValues.size());
+        renderPassBeginInfo.pClearValues = pass.clearValues.data();
+
+        vkCmdBeginRenderPass(commandBuffer, &renderPassBeginInfo,
+            pass.secondaryCommandBuffers ? VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS : VK_SUBPASS_CONTENTS_INLINE);
+        pass.execute(commandBuffer, pass.context);
+        vkCmdEndRenderPass(commandBuffer);
+    }
+
+    recordBarriers_(commandBuffer, finalBarriers_);
+}
+
+VkImageView RenderGraph::getImageView(RenderGraphResource image) const {
+    return resources_[image].view;
+}
+
+VkRenderPass RenderGraph::getRenderPass(const std::string& pass) const {
+    for (const auto& candidate : passes_)
+        if (candidate.name == pass && candidate.live)
+            return candidate.context.renderPass;
+
+    return VK_NULL_HANDLE;
+}
+
+void RenderGraph::releaseFramebuffers() {
+    if (framebuffers_.empty())
+        return;
+
+    std::vector<VkFramebuffer> framebuffers;
+    for (auto& [key, framebuffer] : framebuffers_)
+        framebuffers.push_back(framebuffer);
+    framebuffers_.clear();
+
+    retire_([device = device_, framebuffers] {
+        for (auto framebuffer : framebuffers)
+            vkDestroyFramebuffer(device, framebuffer, nullptr);
+    });
+}
+
+RenderGraphResource RenderGraph::addResource_(Resource resource) {
+    resources_.push_back(std::move(resource));
+    return static_cast<RenderGraphResource>(resources_.size() - 1);
+}
+
+void RenderGraph::addPass_(const std::string& name, bool graphics, const std::function<void(PassBuilder&)>& setup, Execute execute) {
+    auto pass = Pass{};
+    pass.name = name;
+    pass.graphics = graphics;
+    pass.execute = std::move(execute);
+    passes_.push_back(std::move(pass));
+
+    auto builder = PassBuilder(*this, static_cast<uint32_t>(passes_.size() - 1));
+    setup(builder);
+}
+
+void RenderGraph::cull_() {
+    // walking backwards, a pass lives when it has side effects or writes something external or read by a live pass
+    std::vector<bool> needed(resources_.size(), false);
+    stats_ = {};
+    stats_.passCount = static_cast<uint32_t>(passes_.size());
+
+    for (auto i = passes_.size(); i-- > 0;) {
+        auto& pass = passes_[i];
+        pass.live = pass.sideEffects;
+
+        for (const auto& use : pass.uses)
+            if (use.write && (resources_[use.resource].imported || needed[use.resource]))
+                pass.live = true;
+
+        if (!pass.live) {
+            stats_.culledPassCount++;
+            continue;
+        }
+
+        for (const auto& use : pass.uses)
+            if (!use.cleared && (!use.write || (use.state.access & ~writeAccessMask)))
+                needed[use.resource] = true;
+    }
+}
+
+void RenderGraph::allocateTransients_() {
+    // largest first, each image takes the first slot whose occupants are all done before it starts or start after it ends
+    std::vector<uint32_t> order(transients_.size());
+    std::iota(order.begin(), order.end(), 0);
+    std::sort(order.begin(), order.end(), [&](uint32_t a, uint32_t b) {
+        return transients_[a].requirements.size > transients_[b].requirements.size;
+    });
+
+    std::vector<VkMemoryRequirements> slotRequirements;
+    std::vector<std::vector<uint32_t>> slotOccupants;
+
+    for (auto index : order) {
+        auto& transient = transients_[index];
+
+        auto slot = 0u;
+        for (; slot < slotRequirements.size(); slot++) {
+            if (!(slotRequirements[slot].memoryTypeBits & transient.requirements.memoryTypeBits))
+                continue;
+
+            auto overlaps = std::any_of(slotOccupants[slot].begin(), slotOccupants[slot].end(), [&](uint32_t occupant) {
+                return transients_[occupant].firstUse <= transient.lastUse && transient.firstUse <= transients_[occupant].lastUse;
+            });
+            if (!overlaps)
+                break;
+        }
+
+        if (slot == slotRequirements.size()) {
+            slotRequirements.push_back(transient.requirements);
+            slotOccupants.emplace_back();
+        }
+
+        auto& requirements = slotRequirements[slot];
+        requirements.size = std::max(requirements.size, transient.requirements.size);
+        requirements.alignment = std::max(requirements.alignment, transient.requirements.alignment);
+        requirements.memoryTypeBits &= transient.requirements.memoryTypeBits;
+
+        slotOccupants[slot].push_back(index);
+        transient.slot = slot;
+    }
+
+    for (const auto& requirements : slotRequirements)
+        slots_.push_back(allocator_.allocate(requirements, MemoryUsage::GpuOnly, false));
+
+    for (auto& transient : transients_) {
+        auto& slot = slots_[transient.slot];
+        if (vkBindImageMemory(device_, transient.image, slot.memory, slot.offset) != VK_SUCCESS)
+            throw std::runtime_error("Failed to bind transient image memory.");
+    }
+}
+
+void RenderGraph::releaseTransients_() {
+    // cached framebuffers may reference the transient views
+    releaseFramebuffers();
+
+    if (!transients_.empty() || !slots_.empty())
+        retire_([device = device_, allocator = &allocator_, transients = transients_, slots = slots_]() mutable {
+            for (auto& transient : transients) {
+                vkDestroyImageView(device, transient.view, nullptr);
+                vkDestroyImage(device, transient.image, nullptr);
+            }
+
+            for (auto& slot : slots)
+                allocator->free(slot);
+        });
+
+    transients_.clear();
+    slots_.clear();
+    transientShape_ = 0;
+}
+
+void RenderGraph::planBarriers_() {
+    std::vector<TrackedState> tracked(resources_.size());
+
+    for (uint32_t i = 0; i < resources_.size(); i++) {
+        auto& resource = resources_[i];
+        auto& state = tracked[i];
+
+        if (resource.imported) {
+            state.layout = resource.initial.layout;
+            state.writeStages = resource.initial.stages;
+            state.writeAccess = resource.initial.access & writeAccessMask;
+            state.readStages = resource.initial.stages;
+            state.hasContents = !resource.isImage || resource.initial.layout != VK_IMAGE_LAYOUT_UNDEFINED;
+            continue;
+        }
+
+        if (resource.transient == UINT32_MAX)
+            continue;
+
+        // the image takes over its slot from the occupant that last used it, in this frame or else in the previous one
+        auto& transient = transients_[resource.transient];
+        const TransientImage* previous = nullptr;
+        const TransientImage* last = nullptr;
+        for (auto& occupant : transients_) {
+            if (occupant.slot != transient.slot)
+                continue;
+            if (occupant.lastUse < transient.firstUse && (!previous || occupant.lastUse > previous->lastUse))
+                previous = &occupant;
+            if (!last || occupant.lastUse > last->lastUse)
+                last = &occupant;
+        }
+        if (!previous)
+            previous = last;
+
+        state.writeStages = previous->stages;
+        state.writeAccess = previous->writeAccess;
+        state.readStages = previous->stages;
+    }
+
+    uint32_t position = 0;
+    for (auto& pass : passes_) {
+        if (!pass.live)
+            continue;
+
+        pass.barriers = {};
+
+        // attachments load what earlier passes left unless cleared, and store it for later passes and the outside
+        std::vector<bool> keepContents;
+        std::vector<bool> storeContents;
+        for (const auto& attachment : pass.attachments) {
+            auto& resource = resources_[attachment.resource];
+            keepContents.push_back(!attachment.clear && tracked[attachment.resource].hasContents);
+            storeContents.push_back(resource.imported || resource.lastUse > position);
+        }
+
+        auto& barriers = pass.barriers;
+        for (const auto& use : pass.uses) {
+            auto& resource = resources_[use.resource];
+            track(barriers.imageBarriers, barriers.srcStages, barriers.dstStages, barriers.srcAccess, barriers.dstAccess,
+                tracked[use.resource], resource.isImage ? resource.image : VK_NULL_HANDLE, resource.aspect, use.state, use.write);
+        }
+
+        if (barriers.srcStages) {
+            stats_.barrierCount++;
+            stats_.imageBarrierCount += static_cast<uint32_t>(barriers.imageBarriers.size());
+        }
+
+        if (pass.graphics)
+            createRenderPass_(pass, keepContents, storeContents);
+
+        position++;
+    }
+
+    // imported images are left the way their owner expects them
+    for (uint32_t i = 0; i < resources_.size(); i++) {
+        auto& resource = resources_[i];
+        if (!resource.imported || !resource.isImage || resource.final.layout == VK_IMAGE_LAYOUT_UNDEFINED)
+            continue;
+
+        auto state = resource.final;
+        if (!state.stages)
+            state.stages = VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT;
+
+        // an image the frame never touched is still in its initial layout, and kept as it is
+        tracked[i].hasContents = true;
+        track(finalBarriers_.imageBarriers, finalBarriers_.srcStages, finalBarriers_.dstStages, finalBarriers_.srcAccess, finalBarriers_.dstAccess,
+            tracked[i], resource.image, resource.aspect, state, false);
+    }
+
+    if (finalBarriers_.srcStages) {
+        stats_.barrierCount++;
+        stats_.imageBarrierCount += static_cast<uint32_t>(finalBarriers_.imageBarriers.size());
+    }
+
+    stats_.transientImageCount = static_cast<uint32_t>(transients_.size());
+    for (const auto& transient : transients_)
+        stats_.unaliasedBytes += transient.requirements.size;
+    for (const auto& slot : slots_)
+        stats_.transientBytes += slot.size;
+}
+
+void RenderGraph::createRenderPass_(Pass& pass, const std::vector<bool>& keepContents, const std::vector<bool>& storeContents) {
+    std::vector<VkAttachmentDescription> attachments;
+    std::vector<VkAttachmentReference> colorReferences;
+    auto depthReference = VkAttachmentReference{VK_ATTACHMENT_UNUSED, VK_IMAGE_LAYOUT_UNDEFINED};
+    std::vector<VkImageView> views;
+    pass.clearValues.clear();
+
+    // the graph's barriers do every transition, so the render pass keeps each attachment in one layout throughout
+    for (uint32_t i = 0; i < pass.attachments.size(); i++) {
+        const auto& attachment = pass.attachments[i];
+        const auto& resource = resources_[attachment.resource];
+        auto layout = attachment.depth ? VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL : VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+
+        auto description = VkAttachmentDescription{};
+        description.format = resource.format;
+        description.samples = VK_SAMPLE_COUNT_1_BIT;
+        description.loadOp = attachment.clear ? VK_ATTACHMENT_LOAD_OP_CLEAR : keepContents[i] ? VK_ATTACHMENT_LOAD_OP_LOAD : VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+        description.storeOp = storeContents[i] ? VK_ATTACHMENT_STORE_OP_STORE : VK_ATTACHMENT_STORE_OP_DONT_CARE;
+        description.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+        description.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+        description.initialLayout = layout;
+        description.finalLayout = layout;
+        attachments.push_back(description);
+
+        if (attachment.depth)
+            depthReference = {i, layout};
+        else
+            colorReferences.push_back({i, layout});
+
+        views.push_back(resource.view);
+        pass.clearValues.push_back(attachment.clearValue);
+        if (i == 0)
+            pass.context.extent = resource.extent;
+    }
+
+    auto renderPassKey = Utilities::hashBytes(attachments.data(), attachments.size() * sizeof(VkAttachmentDescription));
+    renderPassKey = Utilities::hashBytes(&depthReference, sizeof(depthReference), renderPassKey);
+
+    auto& renderPass = renderPasses_[renderPassKey];
+    if (renderPass == VK_NULL_HANDLE) {
+        auto subpass = VkSubpassDescription{};
+        subpass.pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
+        subpass.colorAttachmentCount = static_cast<uint32_t>(colorReferences.size());
+        subpass.pColorAttachments = colorReferences.data();
+        subpass.pDepthStencilAttachment = depthReference.attachment == VK_ATTACHMENT_UNUSED ? nullptr : &depthReference;
+
+        auto renderPassInfo = VkRenderPassCreateInfo{};
+        renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO;
+        renderPassInfo.attachmentCount = static_cast<uint32_t>(attachments.size());
+        renderPassInfo.pAttachments = attachments.data();
+        renderPassInfo.subpassCount = 1;
+        renderPassInfo.pSubpasses = &subpass;
+
+        if (vkCreateRenderPass(device_, &renderPassInfo, nullptr, &renderPass) != VK_SUCCESS) {
+            renderPasses_.erase(renderPassKey);
+            throw std::runtime_error("Failed to create render pass for " + pass.name + ".");
+        }
+    }
+    pass.context.renderPass = renderPass;
+
+    auto framebufferKey = Utilities::hashBytes(&renderPass, sizeof(renderPass));
+    framebufferKey = Utilities::hashBytes(views.data(), views.size() * sizeof(VkImageView), framebufferKey);
+    framebufferKey = Utilities::hashBytes(&pass.context.extent, sizeof(pass.context.extent), framebufferKey);
+
+    auto& framebuffer = framebuffers_[framebufferKey];
+    if (framebuffer == VK_NULL_HANDLE) {
+        auto framebufferInfo = VkFramebufferCreateInfo{};
+        framebufferInfo.sType = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO;
+        framebufferInfo.renderPass = renderPass;
+        framebufferInfo.attachmentCount = static_cast<uint32_t>(views.size());
+        framebufferInfo.pAttachments = views.data();
+        framebufferInfo.width = pass.context.extent.width;
+        framebufferInfo.height = pass.context.extent.height;
+        framebufferInfo.layers = 1;
+
+        if (vkCreateFramebuffer(device_, &framebufferInfo, nullptr, &framebuffer) != VK_SUCCESS) {
+            framebuffers_.erase(framebufferKey);
+            throw std::runtime_error("Failed to create framebuffer for " + pass.name + ".");
+        }
+    }
+    pass.context.framebuffer = framebuffer;
+}
+
+void RenderGraph::recordBarriers_(VkCommandBuffer commandBuffer, const Barriers& barriers) {
+    if (!barriers.srcStages)
+        return;
+
+    auto memoryBarrier = VkMemoryBarrier{};
+    memoryBarrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+    memoryBarrier.srcAccessMask = barriers.srcAccess;
+    memoryBarrier.dstAccessMask = barriers.dstAccess;
+    auto memoryBarrierCount = barriers.srcAccess || barriers.dstAccess ? 1u : 0u;
+
+    vkCmdPipelineBarrier(commandBuffer, barriers.srcStages, barriers.dstStages, 0, memoryBarrierCount, &memoryBarrier, 0, nullptr,
+        static_cast<uint32_t>(barriers.imageBarriers.size()), barriers.imageBarriers.data());
+}
\ No newline at end of file
@@ -0,0 +1,206 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include <functional>
+#include <optional>
+#include <vulkan/vulkan.h>
+#include "memoryAllocator.hpp"
+
+using RenderGraphResource = uint32_t;
+
+// where and how a pass touches a resource, and for imported resources where the graph finds and leaves them
+struct ResourceState {
+    VkPipelineStageFlags stages = 0;
+    VkAccessFlags access = 0;
+    VkImageLayout layout = VK_IMAGE_LAYOUT_UNDEFINED;
+};
+
+// created and owned by the graph, the contents only live from the first to the last pass using the image
+struct TransientImageDescription {
+    VkFormat format = VK_FORMAT_UNDEFINED;
+    VkExtent2D extent = {};
+    VkImageAspectFlags aspect = VK_IMAGE_ASPECT_COLOR_BIT;
+};
+
+// handed to a pass while it records, the render pass and framebuffer are only set for graphics passes
+struct RenderPassContext {
+    VkRenderPass renderPass = VK_NULL_HANDLE;
+    VkFramebuffer framebuffer = VK_NULL_HANDLE;
+    VkExtent2D extent = {};
+};
+
+struct RenderGraphStats {
+    uint32_t passCount = 0;
+    uint32_t culledPassCount = 0;
+    // vkCmdPipelineBarrier calls, and the layout transitions among them
+    uint32_t barrierCount = 0;
+    uint32_t imageBarrierCount = 0;
+    uint32_t transientImageCount = 0;
+    // bound to transient images, and what they would take without sharing memory
+    VkDeviceSize transientBytes = 0;
+    VkDeviceSize unaliasedBytes = 0;
+};
+
+// declared anew every frame: passes state what they read and write, and the graph culls passes nothing
+// depends on, batches one barrier per pass from the accesses, and lets transient images whose
+// lifetimes do not overlap share memory; render passes and framebuffers are cached across frames
+class RenderGraph {
+public:
+
+    using Retire = std::function<void(std::function<void()>)>;
+    using Execute = std::function<void(VkCommandBuffer commandBuffer, const RenderPassContext& context)>;
+
+    class PassBuilder {
+    public:
+
+        // graphics passes only, bound in declaration order, the previous contents are kept unless a clear value is given
+        void colorAttachment(RenderGraphResource image, std::optional<VkClearColorValue> clear = std::nullopt);
+        void depthAttachment(RenderGraphResource image, std::optional<VkClearDepthStencilValue> clear = std::nullopt);
+        // the pass executes secondary command buffers inside its render pass
+        void secondaryCommandBuffers();
+
+        void read(RenderGraphResource resource, const ResourceState& state);
+        void write(RenderGraphResource resource, const ResourceState& state);
+
+        // keeps the pass even though nothing the graph tracks depends on it
+        void sideEffects();
+
+    private:
+
+        friend class RenderGraph;
+        PassBuilder(RenderGraph& graph, uint32_t pass) : graph_(graph), pass_(pass) {}
+
+        RenderGraph& graph_;
+        uint32_t pass_;
+    };
+
+    RenderGraph(VkDevice device, MemoryAllocator& allocator, Retire retire);
+    ~RenderGraph();
+
+    // starts declaring a frame, transient images are kept for as long as the frame keeps its shape
+    void reset();
+
+    // initial is how the frame finds the image, final how it must leave it, say for presentation
+    RenderGraphResource importImage(const std::string& name, VkImage image, VkImageView view, VkFormat format, VkExtent2D extent,
+        VkImageAspectFlags aspect, const ResourceState& initial, const ResourceState& final);
+    // imported buffers are assumed ready, the frame fences and queue submission cover their host writes
+    RenderGraphResource importBuffer(const std::string& name, VkBuffer buffer);
+    RenderGraphResource createImage(const std::string& name, const TransientImageDescription& description);
+
+    // passes run in declaration order, which is always a valid one since a pass can only use what was declared before it
+    void addGraphicsPass(const std::string& name, const std::function<void(PassBuilder&)>& setup, Execute execute);
+    void addComputePass(const std::string& name, const std::function<void(PassBuilder&)>& setup, Execute execute);
+
+    void compile();
+    void execute(VkCommandBuffer commandBuffer);
+
+    // valid after compile
+    VkImageView getImageView(RenderGraphResource image) const;
+    // null when the pass was culled
+    VkRenderPass getRenderPass(const std::string& pass) const;
+    const RenderGraphStats& getStats() const { return stats_; }
+
+    // retires the cached framebuffers, call before retiring any imported view they may reference
+    void releaseFramebuffers();
+
+private:
+
+    struct Use {
+        RenderGraphResource resource;
+        ResourceState state;
+        bool write;
+        // attachments cleared on load never see what earlier passes left
+        bool cleared = false;
+    };
+
+    struct Attachment {
+        RenderGraphResource resource;
+        bool depth;
+        bool clear;
+        VkClearValue clearValue;
+    };
+
+    // everything a pass waits on before it starts, merged into a single vkCmdPipelineBarrier
+    struct Barriers {
+        VkPipelineStageFlags srcStages = 0;
+        VkPipelineStageFlags dstStages = 0;
+        VkAccessFlags srcAccess = 0;
+        VkAccessFlags dstAccess = 0;
+        std::vector<VkImageMemoryBarrier> imageBarriers;
+    };
+
+    struct Pass {
+        std::string name;
+        bool graphics;
+        bool secondaryCommandBuffers = false;
+        bool sideEffects = false;
+        std::vector<Use> uses;
+        std::vector<Attachment> attachments;
+        Execute execute;
+
+        bool live = false;
+        Barriers barriers;
+        RenderPassContext context;
+        std::vector<VkClearValue> clearValues;
+    };
+
+    struct Resource {
+        std::string name;
+        bool isImage;
+        bool imported;
+        VkImage image = VK_NULL_HANDLE;
+        VkImageView view = VK_NULL_HANDLE;
+        VkBuffer buffer = VK_NULL_HANDLE;
+        VkFormat format = VK_FORMAT_UNDEFINED;
+        VkExtent2D extent = {};
+        VkImageAspectFlags aspect = 0;
+        ResourceState initial;
+        ResourceState final;
+
+        // transient images only, lifetime in positions of live passes
+        VkImageUsageFlags usage = 0;
+        uint32_t firstUse = UINT32_MAX;
+        uint32_t lastUse = 0;
+        uint32_t transient = UINT32_MAX;
+    };
+
+    // a transient image and the memory slot it shares with images whose lifetimes do not overlap its own
+    struct TransientImage {
+        VkImage image = VK_NULL_HANDLE;
+        VkImageView view = VK_NULL_HANDLE;
+        VkMemoryRequirements requirements;
+        uint32_t slot = 0;
+        uint32_t firstUse = 0;
+        uint32_t lastUse = 0;
+        // every stage and write of the image, what the next occupant of the slot has to wait for
+        VkPipelineStageFlags stages = 0;
+        VkAccessFlags writeAccess = 0;
+    };
+
+    VkDevice device_;
+    MemoryAllocator& allocator_;
+    Retire retire_;
+
+    std::vector<Pass> passes_;
+    std::vector<Resource> resources_;
+    Barriers finalBarriers_;
+    RenderGraphStats stats_;
+
+    uint64_t transientShape_ = 0;
+    std::vector<TransientImage> transients_;
+    std::vector<Allocation> slots_;
+
+    std::unordered_map<uint64_t, VkRenderPass> renderPasses_;
+    std::unordered_map<uint64_t, VkFramebuffer> framebuffers_;
+
+    RenderGraphResource addResource_(Resource resource);
+    void addPass_(const std::string& name, bool graphics, const std::function<void(PassBuilder&)>& setup, Execute execute);
+    void cull_();
+    void allocateTransients_();
+    void releaseTransients_();
+    void planBarriers_();
+    void createRenderPass_(Pass& pass, const std::vector<bool>& keepContents, const std::vector<bool>& storeContents);
+    void recordBarriers_(VkCommandBuffer commandBuffer, const Barriers& barriers);
+};
\ No newline at end of file
@@ -0,0 +1,211 @@
+#include "shaderCompiler.hpp"
+#include "utilities.hpp"
+#include <filesystem>
+#include <fstream>
+#include <sstream>
+#include <iomanip>
+#include <memory>
+#include <thread>
+#include <cstring>
+
+namespace {
+    // resolves #include "file" relative to the including file and #include <file> relative to shaders/
+    class FileIncluder : public shaderc::CompileOptions::IncluderInterface {
+    public:
+
+        shaderc_include_result* GetInclude(const char* requestedSource, shaderc_include_type type, const char* requestingSource, size_t includeDepth) override {
+            auto path = type == shaderc_include_type_relative
+                ? std::filesystem::path(requestingSource).parent_path() / requestedSource
+                : std::filesystem::path("shaders") / requestedSource;
+
+            auto include = new Include{};
+            include->name = path.generic_string();
+
+            std::ifstream file(path, std::ios::binary);
+            if (file.is_open()) {
+                include->content.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+            }
+            else {
+                // an empty name tells shaderc the include failed, the content holds the message
+                include->content = "Failed to open " + include->name + ".";
+                include->name.clear();
+            }
+
+            include->result.source_name = include->name.c_str();
+            include->result.source_name_length = include->name.size();
+            include->result.content = include->content.c_str();
+            include->result.content_length = include->content.size();
+            include->result.user_data = include;
+
+            return &include->result;
+        }
+
+        void ReleaseInclude(shaderc_include_result* data) override {
+            delete static_cast<Include*>(data->user_data);
+        }
+
+    private:
+
+        struct Include {
+            shaderc_include_result result;
+            std::string name;
+            std::string content;
+        };
+    };
+
+    shaderc_shader_kind shaderKind(const std::string& filename) {
+        auto extension = std::filesystem::path(filename).extension().string();
+
+        if (extension == ".vert") return shaderc_glsl_vertex_shader;
+        if (extension == ".frag") return shaderc_glsl_fragment_shader;
+        if (extension == ".comp") return shaderc_glsl_compute_shader;
+        if (extension == ".geom") return shaderc_glsl_geometry_shader;
+        if (extension == ".tesc") return shaderc_glsl_tess_control_shader;
+        if (extension == ".tese") return shaderc_glsl_tess_evaluation_shader;
+
+        throw std::runtime_error("Failed to deduce the shader stage of " + filename + ".");
+    }
+
+    const uint32_t spirvMagic = 0x07230203;
+}
+
+ShaderCompiler::ShaderCompiler(const std::string& cacheDirectory, const AssetArchive* archive)
+    : cacheDirectory_(cacheDirectory), archive_(archive), useArchive_(archive != nullptr) {
+    if (!compiler_.IsValid())
+        throw std::runtime_error("Failed to initialize the shader compiler.");
+
+    if (!cacheDirectory_.empty())
+        std::filesystem::create_directories(cacheDirectory_);
+}
+
+shaderc::CompileOptions ShaderCompiler::createOptions_() const {
+    shaderc::CompileOptions options;
+    options.SetTargetEnvironment(shaderc_target_env_vulkan, shaderc_env_version_vulkan_1_0);
+    options.SetIncluder(std::make_unique<FileIncluder>());
+    #ifdef DEBUG_MODE
+        options.SetGenerateDebugInfo();
+        options.SetOptimizationLevel(shaderc_optimization_level_zero);
+    #else
+        options.SetOptimizationLevel(shaderc_optimization_level_performance);
+    #endif
+
+    return options;
+}
+
+// must change whenever createOptions_ does, so stale cache entries are never picked up
+std::string ShaderCompiler::optionsSignature_() const {
+    #ifdef DEBUG_MODE
+        return "vulkan1.0;debug;O0";
+    #else
+        return "vulkan1.0;O";
+    #endif
+}
+
+SpirvCode ShaderCompiler::compile(const std::string& filename) {
+    auto entry = useArchive_ ? archive_->find(filename) : nullptr;
+    if (entry && entry->type == AssetType::Shader && entry->uncompressedSize >= sizeof(uint32_t) && entry->uncompressedSize % sizeof(uint32_t) == 0) {
+        auto wordCount = entry->uncompressedSize / sizeof(uint32_t);
+
+        // blobs are aligned well past a word, so an uncompressed one goes to the driver straight from the mapping
+        if (entry->compression == AssetCompression::None)
+            return SpirvCode(reinterpret_cast<const uint32_t*>(archive_->data(*entry)), wordCount);
+
+        std::vector<uint32_t> spirv(wordCount);
+        archive_->read(*entry, spirv.data());
+        return spirv;
+    }
+
+    auto sourceFile = Utilities::readFile(filename);
+    auto source = std::string(sourceFile.begin(), sourceFile.end());
+    auto kind = shaderKind(filename);
+
+    // preprocessing is cheap next to a full compile and pulls every include into the hashed text
+    auto preprocessed = compiler_.PreprocessGlsl(source, kind, filename.c_str(), createOptions_());
+    if (preprocessed.GetCompilationStatus() != shaderc_compilation_status_success)
+        throw std::runtime_error("Failed to preprocess " + filename + ":\n" + preprocessed.GetErrorMessage());
+
+    auto signature = optionsSignature_();
+    auto key = Utilities::hashBytes(preprocessed.cbegin(), preprocessed.cend() - preprocessed.cbegin());
+    key = Utilities::hashBytes(&kind, sizeof(kind), key);
+    key = Utilities::hashBytes(signature.data(), signature.size(), key);
+
+    std::vector<uint32_t> spirv;
+    if (loadCached_(key, spirv))
+        return spirv;
+
+    auto result = compiler_.CompileGlslToSpv(source, kind, filename.c_str(), createOptions_());
+    if (result.GetCompilationStatus() != shaderc_compilation_status_success)
+        throw std::runtime_error("Failed to compile " + filename + ":\n" + result.GetErrorMessage());
+
+    spirv.assign(result.cbegin(), result.cend());
+    storeCached_(key, spirv);
+
+    return spirv;
+}
+
+std::filesystem::path ShaderCompiler::cachePath_(uint64_t key) const {
+    std::stringstream name;
+    name << std::hex << std::setw(16) << std::setfill('0') << key << ".spv";
+
+    return std::filesystem::path(cacheDirectory_) / name.str();
+}
+
+bool ShaderCompiler::loadCached_(uint64_t key, std::vector<uint32_t>& spirv) {
+    {
+        std::lock_guard<std::mutex> lock(cacheMutex_);
+        auto cached = cache_.find(key);
+        if (cached != cache_.end()) {
+            spirv = cached->second;
+            return true;
+        }
+    }
+
+    if (cacheDirectory_.empty())
+        return false;
+
+    auto path = cachePath_(key);
+    if (!std::filesystem::exists(path))
+        return false;
+
+    auto file = Utilities::readFile(path.string());
+    if (file.size() < sizeof(uint32_t) || file.size() % sizeof(uint32_t) != 0)
+        return false;
+
+    spirv.resize(file.size() / sizeof(uint32_t));
+    memcpy(spirv.data(), file.data(), file.size());
+
+    if (spirv[0] != spirvMagic)
+        return false;
+
+    std::lock_guard<std::mutex> lock(cacheMutex_);
+    cache_[key] = spirv;
+
+    return true;
+}
+
+void ShaderCompiler::storeCached_(uint64_t key, const std::vector<uint32_t>& spirv) {
+    {
+        std::lock_guard<std::mutex> lock(cacheMutex_);
+        cache_[key] = spirv;
+    }
+
+    if (cacheDirectory_.empty())
+        return;
+
+    auto path = cachePath_(key);
+
+    // another thread may be writing the same entry, the rename keeps readers from seeing half a file
+    auto temporaryPath = path;
+    temporaryPath += "." + std::to_string(std::hash<std::thread::id>()(std::this_thread::get_id())) + ".tmp";
+
+    {
+        std::ofstream file(temporaryPath, std::ios::binary | std::ios::trunc);
+        if (!file.is_open())
+            return;
+
+        file.write(reinterpret_cast<const char*>(spirv.data()), spirv.size() * sizeof(uint32_t));
+    }
+
+    std::error_code error;
+    std::filesystem::rename(temporaryPath, path, error);
+}
\ No newline at end of file
@@ -0,0 +1,58 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include <mutex>
+#include <atomic>
+#include <filesystem>
+#include <shaderc/shaderc.hpp>
+#include "assetArchive.hpp"
+
+// SPIR-V words, either borrowed from a mapped asset archive, which outlives every shader module, or owned
+class SpirvCode {
+public:
+
+    SpirvCode(std::vector<uint32_t> code) : owned_(std::move(code)) {}
+    SpirvCode(const uint32_t* code, size_t size) : borrowed_(code), borrowedSize_(size) {}
+
+    const uint32_t* data() const { return borrowed_ ? borrowed_ : owned_.data(); }
+    size_t size() const { return borrowed_ ? borrowedSize_ : owned_.size(); }
+
+private:
+
+    std::vector<uint32_t> owned_;
+    const uint32_t* borrowed_ = nullptr;
+    size_t borrowedSize_ = 0;
+};
+
+// compiles GLSL to SPIR-V in-process, results are keyed by a hash of the preprocessed
+// source (so includes are covered) and the compile options, and kept in memory and on disk
+class ShaderCompiler {
+public:
+
+    // shaders found in the archive, if any, are used from its mapping without touching the sources
+    ShaderCompiler(const std::string& cacheDirectory, const AssetArchive* archive = nullptr);
+
+    // the stage is deduced from the extension (.vert, .frag, .comp, ...)
+    SpirvCode compile(const std::string& filename);
+    // a source was edited, from now on everything compiles from source, as any shader may include the file
+    void sourcesChanged() { useArchive_ = false; }
+
+private:
+
+    shaderc::Compiler compiler_;
+    std::string cacheDirectory_;
+    const AssetArchive* archive_;
+    std::atomic<bool> useArchive_;
+
+    std::mutex cacheMutex_;
+    std::unordered_map<uint64_t, std::vector<uint32_t>> cache_;
+
+    shaderc::CompileOptions createOptions_() const;
+    std::string optionsSignature_() const;
+
+    std::filesystem::path cachePath_(uint64_t key) const;
+    bool loadCached_(uint64_t key, std::vector<uint32_t>& spirv);
+    void storeCached_(uint64_t key, const std::vector<uint32_t>& spirv);
+};
\ No newline at end of file
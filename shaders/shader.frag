@@ -1,9 +1,20 @@
 #version 450
 
+// sized by the bindless table, see BindlessDescriptors
+layout(constant_id = 0) const uint textureCapacity = 1;
+
+layout(set = 0, binding = 0) uniform sampler2D textures[textureCapacity];
+
+layout(push_constant) uniform DrawConstants {
+    mat4 viewProjection;
+    uint textureIndex;
+};
+
 layout(location = 0) in vec3 fragColor;
+layout(location = 1) in vec2 fragTexCoord;
 
 layout(location = 0) out vec4 outColor;
 
 void main() {
-    outColor = vec4(fragColor, 1.0);
+    outColor = vec4(fragColor * texture(textures[textureIndex], fragTexCoord).rgb, 1.0);
 }
\ No newline at end of file
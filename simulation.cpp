@@ -0,0 +1,136 @@
+#include "simulation.hpp"
+#include "profiler.hpp"
+#include <cmath>
+#include <algorithm>
+
+namespace {
+    const float pi = 3.14159265358979f;
+}
+
+Simulation::Simulation(Utilities::JobSystem& jobSystem, uint32_t objectCount, double tickRate)
+    : tickDuration_(std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(1.0 / std::max(tickRate, 1.0)))),
+      jobSystem_(jobSystem) {
+    // a square grid just large enough for every object, a single object fills the whole frame
+    auto columns = static_cast<uint32_t>(std::ceil(std::sqrt(static_cast<double>(objectCount))));
+    auto scale = 1.0f / std::max(columns, 1u);
+
+    // the test scene: each object spins and circles its grid cell at its own pace
+    for (uint32_t i = 0; i < objectCount; i++) {
+        auto entity = world_.create();
+        auto speed = 0.5f + 0.25f * static_cast<float>(i % 5);
+
+        auto orbit = Orbit{};
+        orbit.center[0] = -1.0f + scale * (2 * (i % columns) + 1);
+        orbit.center[1] = -1.0f + scale * (2 * (i / columns) + 1);
+        orbit.radius = 0.25f * scale;
+        orbit.speed = speed;
+
+        auto transform = Transform{};
+        transform.position[0] = orbit.center[0] + orbit.radius;
+        transform.position[1] = orbit.center[1];
+        transform.scale = scale;
+
+        world_.add(entity, transform);
+        world_.add(entity, PreviousTransform{transform});
+        world_.add(entity, Spin{speed});
+        world_.add(entity, orbit);
+    }
+
+    // every slot starts at rest, so the render thread has a state before the first tick
+    publish_(Clock::now());
+    snapshots_.update();
+}
+
+Simulation::~Simulation() {
+    stop();
+}
+
+void Simulation::start() {
+    if (thread_.joinable())
+        return;
+
+    running_ = true;
+    thread_ = std::thread(&Simulation::run_, this);
+}
+
+void Simulation::stop() {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        running_ = false;
+    }
+    stopCondition_.notify_all();
+
+    if (thread_.joinable())
+        thread_.join();
+}
+
+void Simulation::run_() {
+    PROFILE_THREAD("Simulation");
+    auto next = Clock::now();
+    auto seconds = std::chrono::duration<float>(tickDuration_).count();
+
+    std::unique_lock<std::mutex> lock(mutex_);
+    while (running_) {
+        lock.unlock();
+
+        auto now = Clock::now();
+        if (now - next > maxCatchUpTicks_ * tickDuration_)
+            next = now;
+
+        // ticks always advance by the fixed step, a late wake-up runs several back to back
+        while (next <= now) {
+            step_(seconds);
+            publish_(next);
+            next += tickDuration_;
+        }
+
+        lock.lock();
+        stopCondition_.wait_until(lock, next, [this] { return !running_; });
+    }
+}
+
+void Simulation::step_(float seconds) {
+    PROFILE_SCOPE("Simulation::step");
+    world_.parallelEach<Transform, PreviousTransform>(jobSystem_, [](Transform& transform, PreviousTransform& previous) {
+        previous.value = transform;
+    });
+
+    world_.parallelEach<Spin, Transform>(jobSystem_, [seconds](Spin& spin, Transform& transform) {
+        transform.angle = std::fmod(transform.angle + spin.speed * seconds, 2 * pi);
+    });
+
+    world_.parallelEach<Orbit, Transform>(jobSystem_, [seconds](Orbit& orbit, Transform& transform) {
+        orbit.phase = std::fmod(orbit.phase + orbit.speed * seconds, 2 * pi);
+        transform.position[0] = orbit.center[0] + orbit.radius * std::cos(orbit.phase);
+        transform.position[1] = orbit.center[1] + orbit.radius * std::sin(orbit.phase);
+    });
+
+    tick_.store(tick_.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+}
+
+void Simulation::publish_(Clock::time_point time) {
+    PROFILE_SCOPE("Simulation::publish");
+    auto& transforms = world_.pool<Transform>();
+    auto& previousTransforms = world_.pool<PreviousTransform>();
+
+    // assigning into the slot's vectors reuses their storage, so a tick allocates nothing once sizes settle
+    auto& snapshot = snapshots_.writeSlot();
+    snapshot.time = time;
+    snapshot.current.assign(transforms.data(), transforms.data() + transforms.size());
+    snapshot.previous.resize(transforms.size());
+    for (uint32_t i = 0; i < transforms.size(); i++) {
+        auto previous = previousTransforms.find(transforms.entities()[i]);
+        snapshot.previous[i] = previous ? previous->value : transforms.data()[i];
+    }
+    snapshots_.publish();
+}
+
+Simulation::RenderState Simulation::acquire(Clock::time_point now) {
+    snapshots_.update();
+    const auto& snapshot = snapshots_.read();
+
+    // previous held at time - tick and current at time, drawing at now - tick puts the blend factor at (now - time) / tick
+    auto alpha = static_cast<float>(std::chrono::duration<double>(now - snapshot.time) / std::chrono::duration<double>(tickDuration_));
+
+    return {snapshot.previous.data(), snapshot.current.data(), static_cast<uint32_t>(snapshot.current.size()), std::clamp(alpha, 0.0f, 1.0f)};
+}
\ No newline at end of file
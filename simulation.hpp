@@ -0,0 +1,89 @@
+#pragma once
+
+#include <vector>
+#include <thread>
+#include <atomic>
+#include <mutex>
+#include <condition_variable>
+#include <chrono>
+#include <cstdint>
+#include "utilities.hpp"
+#include "ecs.hpp"
+
+struct Transform {
+    float position[2];
+    float angle;
+    float scale;
+};
+
+// the transform as of the tick before, what the render thread blends from
+struct PreviousTransform {
+    Transform value;
+};
+
+struct Spin {
+    float speed;
+};
+
+struct Orbit {
+    float center[2];
+    float radius;
+    float speed;
+    float phase;
+};
+
+// runs the scene's logic on its own thread at a fixed rate, whatever the frame rate, and hands each tick's
+// result to the render thread through a triple buffer, so neither a slow frame nor a slow tick blocks the other
+class Simulation {
+public:
+
+    using Clock = std::chrono::steady_clock;
+
+    // the two newest ticks' transforms, index for index, and how far the render time is from the first to the second
+    struct RenderState {
+        const Transform* previous;
+        const Transform* current;
+        uint32_t count;
+        float alpha;
+    };
+
+    // the tick thread only keeps time, each system's work is spread over the job system
+    Simulation(Utilities::JobSystem& jobSystem, uint32_t objectCount, double tickRate);
+    ~Simulation();
+
+    void start();
+    void stop();
+
+    // render thread only, drawing the blend one tick late keeps motion smooth at any frame rate; valid until the next call
+    RenderState acquire(Clock::time_point now);
+
+    uint64_t getTick() const { return tick_.load(std::memory_order_relaxed); }
+
+private:
+
+    struct Snapshot {
+        // the tick's scheduled time, when current became the newest state
+        Clock::time_point time;
+        std::vector<Transform> previous;
+        std::vector<Transform> current;
+    };
+
+    Clock::duration tickDuration_;
+    // a stall longer than this many ticks is skipped rather than caught up, as catching up would only stall longer
+    const uint32_t maxCatchUpTicks_ = 8;
+
+    // simulation thread only
+    World world_;
+    Utilities::JobSystem& jobSystem_;
+    std::atomic<uint64_t> tick_ = 0;
+    void step_(float seconds);
+    void publish_(Clock::time_point time);
+
+    Utilities::TripleBuffer<Snapshot> snapshots_;
+
+    std::thread thread_;
+    bool running_ = false;
+    std::mutex mutex_;
+    std::condition_variable stopCondition_;
+    void run_();
+};
\ No newline at end of file
@@ -0,0 +1,502 @@
+#include "textureStreamer.hpp"
+#include "profiler.hpp"
+#include <stdexcept>
+#include <iostream>
+#include <algorithm>
+#include <cstring>
+#include <cmath>
+#include <thread>
+
+namespace {
+
+    const uint8_t ktx2Identifier[12] = {0xAB, 'K', 'T', 'X', ' ', '2', '0', 0xBB, '\r', '\n', 0x1A, '\n'};
+
+    struct Ktx2Header {
+        uint8_t identifier[12];
+        uint32_t vkFormat;
+        uint32_t typeSize;
+        uint32_t pixelWidth;
+        uint32_t pixelHeight;
+        uint32_t pixelDepth;
+        uint32_t layerCount;
+        uint32_t faceCount;
+        uint32_t levelCount;
+        uint32_t supercompressionScheme;
+        uint32_t dfdByteOffset;
+        uint32_t dfdByteLength;
+        uint32_t kvdByteOffset;
+        uint32_t kvdByteLength;
+        uint64_t sgdByteOffset;
+        uint64_t sgdByteLength;
+    };
+
+    struct Ktx2Level {
+        uint64_t byteOffset;
+        uint64_t byteLength;
+        uint64_t uncompressedByteLength;
+    };
+
+    struct TexelBlock {
+        uint32_t width;
+        uint32_t height;
+        uint32_t size;
+    };
+
+    // the formats textures are stored in, block compressed ones above all; a size of 0 for the rest
+    TexelBlock texelBlock(VkFormat format) {
+        switch (format) {
+            case VK_FORMAT_R8_UNORM:
+            case VK_FORMAT_R8_SRGB:
+                return {1, 1, 1};
+            case VK_FORMAT_R8G8_UNORM:
+            case VK_FORMAT_R8G8_SRGB:
+                return {1, 1, 2};
+            case VK_FORMAT_R8G8B8A8_UNORM:
+            case VK_FORMAT_R8G8B8A8_SRGB:
+            case VK_FORMAT_B8G8R8A8_UNORM:
+            case VK_FORMAT_B8G8R8A8_SRGB:
+            case VK_FORMAT_A2B10G10R10_UNORM_PACK32:
+                return {1, 1, 4};
+            case VK_FORMAT_R16G16B16A16_SFLOAT:
+                return {1, 1, 8};
+            case VK_FORMAT_R32G32B32A32_SFLOAT:
+                return {1, 1, 16};
+            case VK_FORMAT_BC1_RGB_UNORM_BLOCK:
+            case VK_FORMAT_BC1_RGB_SRGB_BLOCK:
+            case VK_FORMAT_BC1_RGBA_UNORM_BLOCK:
+            case VK_FORMAT_BC1_RGBA_SRGB_BLOCK:
+            case VK_FORMAT_BC4_UNORM_BLOCK:
+            case VK_FORMAT_BC4_SNORM_BLOCK:
+                return {4, 4, 8};
+            case VK_FORMAT_BC2_UNORM_BLOCK:
+            case VK_FORMAT_BC2_SRGB_BLOCK:
+            case VK_FORMAT_BC3_UNORM_BLOCK:
+            case VK_FORMAT_BC3_SRGB_BLOCK:
+            case VK_FORMAT_BC5_UNORM_BLOCK:
+            case VK_FORMAT_BC5_SNORM_BLOCK:
+            case VK_FORMAT_BC6H_UFLOAT_BLOCK:
+            case VK_FORMAT_BC6H_SFLOAT_BLOCK:
+            case VK_FORMAT_BC7_UNORM_BLOCK:
+            case VK_FORMAT_BC7_SRGB_BLOCK:
+                return {4, 4, 16};
+            default:
+                return {1, 1, 0};
+        }
+    }
+
+    VkExtent2D levelExtent(VkExtent2D extent, uint32_t level) {
+        return {std::max(extent.width >> level, 1u), std::max(extent.height >> level, 1u)};
+    }
+}
+
+TextureStreamer::TextureStreamer(VkDevice device, VkPhysicalDevice physicalDevice, MemoryAllocator& allocator, UploadManager& uploadManager, BindlessDescriptors& bindless,
+    Utilities::JobSystem& jobSystem, Utilities::AsyncFileReader& fileReader, const AssetArchive* archive, uint32_t fallbackIndex, VkDeviceSize budget, Retire retire)
+    : device_(device), physicalDevice_(physicalDevice), allocator_(allocator), uploadManager_(uploadManager), bindless_(bindless), jobSystem_(jobSystem),
+      fileReader_(fileReader), archive_(archive), fallbackIndex_(fallbackIndex), budget_(budget), retire_(std::move(retire)) {
+    // the images only ever hold the levels that are resident, so sampling needs no clamp of its own
+    auto samplerInfo = VkSamplerCreateInfo{};
+    samplerInfo.sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO;
+    samplerInfo.magFilter = VK_FILTER_LINEAR;
+    samplerInfo.minFilter = VK_FILTER_LINEAR;
+    samplerInfo.mipmapMode = VK_SAMPLER_MIPMAP_MODE_LINEAR;
+    samplerInfo.addressModeU = VK_SAMPLER_ADDRESS_MODE_REPEAT;
+    samplerInfo.addressModeV = VK_SAMPLER_ADDRESS_MODE_REPEAT;
+    samplerInfo.addressModeW = VK_SAMPLER_ADDRESS_MODE_REPEAT;
+    samplerInfo.maxLod = VK_LOD_CLAMP_NONE;
+
+    if (vkCreateSampler(device_, &samplerInfo, nullptr, &sampler_) != VK_SUCCESS)
+        throw std::runtime_error("Failed to create texture streaming sampler.");
+}
+
+TextureStreamer::~TextureStreamer() {
+    wait();
+
+    for (auto& result : results_)
+        destroy_(result.image, result.view);
+    for (auto& texture : textures_)
+        destroy_(texture.image, texture.view);
+
+    vkDestroySampler(device_, sampler_, nullptr);
+}
+
+void TextureStreamer::wait() {
+    // reads finish on the reader's thread before their uploads become jobs, so the counter alone may read zero too early
+    std::unique_lock<std::mutex> lock(mutex_);
+    while (inFlight_ > 0) {
+        lock.unlock();
+        jobSystem_.wait(jobs_);
+        std::this_thread::yield();
+        lock.lock();
+    }
+}
+
+TextureHandle TextureStreamer::load(const std::string& name) {
+    auto handle = static_cast<TextureHandle>(textures_.size());
+
+    auto texture = Texture{};
+    texture.name = name;
+    texture.entry = archive_ ? archive_->find(name) : nullptr;
+    texture.index = fallbackIndex_;
+    textures_.push_back(texture);
+
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        inFlight_++;
+    }
+
+    if (auto entry = texture.entry) {
+        jobSystem_.submitBackground([this, handle, name, entry] {
+            auto result = Result{handle, true};
+            try {
+                std::vector<uint8_t> unpacked;
+                auto file = archive_->data(*entry);
+                if (entry->compression != AssetCompression::None) {
+                    unpacked.resize(entry->uncompressedSize);
+                    archive_->read(*entry, unpacked.data());
+                    file = unpacked.data();
+                }
+
+                result.layout = parseKtx2(name, file, entry->uncompressedSize);
+                for (const auto& level : result.layout.levels)
+                    if (level.offset > entry->uncompressedSize || level.size > entry->uncompressedSize - level.offset)
+                        throw std::runtime_error("Failed to load " + name + ", its levels run past the end of the file.");
+            }
+            catch (const std::exception& exception) {
+                result.error = exception.what();
+            }
+            finish_(std::move(result));
+        }, &jobs_);
+        return handle;
+    }
+
+    auto header = std::make_shared<std::vector<uint8_t>>(headerReadSize);
+    fileReader_.submit({{name, 0, header->size(), header->data(), [this, handle, name, header](size_t bytesRead, std::exception_ptr exception) {
+        auto result = Result{handle, true};
+        try {
+            if (exception)
+                std::rethrow_exception(exception);
+            result.layout = parseKtx2(name, header->data(), bytesRead);
+        }
+        catch (const std::exception& error) {
+            result.error = error.what();
+        }
+        finish_(std::move(result));
+    }}});
+
+    return handle;
+}
+
+void TextureStreamer::requestSize(TextureHandle handle, float pixels) {
+    auto& texture = textures_[handle];
+    if (texture.requestedFrame != frame_) {
+        texture.requestedFrame = frame_;
+        texture.requestedPixels = pixels;
+    }
+    else
+        texture.requestedPixels = std::max(texture.requestedPixels, pixels);
+}
+
+void TextureStreamer::update() {
+    PROFILE_SCOPE("TextureStreamer::update");
+    std::vector<Result> results;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        std::swap(results, results_);
+    }
+    for (auto& result : results)
+        publish_(result);
+
+    std::vector<TextureHandle> growing;
+    std::vector<TextureHandle> shrinking;
+    for (TextureHandle handle = 0; handle < textures_.size(); handle++) {
+        const auto& texture = textures_[handle];
+        if (!texture.loaded || texture.failed || texture.building)
+            continue;
+
+        auto wanted = wantedLevel_(texture);
+        if (wanted < texture.residentLevel)
+            growing.push_back(handle);
+        else if (wanted > texture.residentLevel)
+            shrinking.push_back(handle);
+    }
+
+    // the furthest below their wanted resolution gain a level first, the least recently drawn give theirs back first
+    std::sort(growing.begin(), growing.end(), [this](TextureHandle a, TextureHandle b) {
+        return textures_[a].residentLevel - wantedLevel_(textures_[a]) > textures_[b].residentLevel - wantedLevel_(textures_[b]);
+    });
+    std::sort(shrinking.begin(), shrinking.end(), [this](TextureHandle a, TextureHandle b) {
+        return textures_[a].requestedFrame < textures_[b].requestedFrame;
+    });
+
+    auto shrink = shrinking.begin();
+    for (auto handle : growing) {
+        auto& texture = textures_[handle];
+        auto added = levelBytes_(texture, texture.residentLevel - 1);
+        auto fits = [&] { return residentBytes_ + buildingBytes_ - replacedBytes_ + added - texture.image.allocation.size <= budget_; };
+
+        // evicted levels only free their memory once the smaller image lands, until then growth waits
+        while (!fits() && shrink != shrinking.end() && buildCount_ < maxBuilds) {
+            build_(*shrink, wantedLevel_(textures_[*shrink]));
+            ++shrink;
+        }
+        if (!fits() || buildCount_ >= maxBuilds)
+            break;
+
+        build_(handle, texture.residentLevel - 1);
+    }
+
+    frame_++;
+}
+
+TextureLayout TextureStreamer::parseKtx2(const std::string& name, const uint8_t* data, size_t size) {
+    auto header = Ktx2Header{};
+    if (size < sizeof(header))
+        throw std::runtime_error("Failed to load " + name + ", it is too small for a KTX2 file.");
+    memcpy(&header, data, sizeof(header));
+
+    if (memcmp(header.identifier, ktx2Identifier, sizeof(ktx2Identifier)) != 0)
+        throw std::runtime_error("Failed to load " + name + ", it is not a KTX2 file.");
+    if (header.supercompressionScheme != 0)
+        throw std::runtime_error("Failed to load " + name + ", supercompressed KTX2 files are not supported.");
+    if (header.pixelWidth == 0 || header.pixelDepth > 1 || header.layerCount > 1 || header.faceCount != 1)
+        throw std::runtime_error("Failed to load " + name + ", only single 2D textures are supported.");
+
+    auto layout = TextureLayout{};
+    layout.format = static_cast<VkFormat>(header.vkFormat);
+    layout.extent = {header.pixelWidth, std::max(header.pixelHeight, 1u)};
+
+    auto block = texelBlock(layout.format);
+    if (block.size == 0)
+        throw std::runtime_error("Failed to load " + name + ", its format " + std::to_string(header.vkFormat) + " is not supported.");
+
+    // a level count of 0 asks the loader to generate the mips, which streaming has no use for
+    auto levelCount = std::max(header.levelCount, 1u);
+    auto maxLevels = 1u;
+    for (auto size = std::max(layout.extent.width, layout.extent.height); size > 1; size >>= 1)
+        maxLevels++;
+    if (levelCount > maxLevels || size < sizeof(header) + levelCount * sizeof(Ktx2Level))
+        throw std::runtime_error("Failed to load " + name + ", its level index is broken.");
+
+    for (uint32_t i = 0; i < levelCount; i++) {
+        auto level = Ktx2Level{};
+        memcpy(&level, data + sizeof(header) + i * sizeof(Ktx2Level), sizeof(level));
+
+        // without supercompression a level holds exactly its blocks, which is what the upload copies
+        auto extent = levelExtent(layout.extent, i);
+        auto expected = static_cast<uint64_t>((extent.width + block.width - 1) / block.width) * ((extent.height + block.height - 1) / block.height) * block.size;
+        if (level.byteLength != expected)
+            throw std::runtime_error("Failed to load " + name + ", level " + std::to_string(i) + " is not the size its extent and format make.");
+
+        layout.levels.push_back({level.byteOffset, level.byteLength});
+    }
+
+    return layout;
+}
+
+void TextureStreamer::build_(TextureHandle handle, uint32_t firstLevel) {
+    auto& texture = textures_[handle];
+    texture.building = true;
+    texture.buildBytes = levelBytes_(texture, firstLevel);
+    buildingBytes_ += texture.buildBytes;
+    replacedBytes_ += texture.image.allocation.size;
+    buildCount_++;
+
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        inFlight_++;
+    }
+
+    if (auto entry = texture.entry) {
+        jobSystem_.submitBackground([this, handle, firstLevel, layout = texture.layout, entry] {
+            if (entry->compression == AssetCompression::None) {
+                upload_(handle, firstLevel, layout, archive_->data(*entry), nullptr);
+                return;
+            }
+
+            std::vector<uint8_t> unpacked;
+            auto exception = std::exception_ptr{};
+            try {
+                unpacked.resize(entry->uncompressedSize);
+                archive_->read(*entry, unpacked.data());
+            }
+            catch (...) {
+                exception = std::current_exception();
+            }
+            upload_(handle, firstLevel, layout, unpacked.data(), exception);
+        }, &jobs_);
+        return;
+    }
+
+    // the levels lie back to back, so one read covers them, which the reader splits up again for the drive
+    auto layout = texture.layout;
+    auto begin = UINT64_MAX;
+    auto end = uint64_t(0);
+    for (auto level = firstLevel; level < layout.levels.size(); level++) {
+        begin = std::min(begin, layout.levels[level].offset);
+        end = std::max(end, layout.levels[level].offset + layout.levels[level].size);
+    }
+    for (auto level = firstLevel; level < layout.levels.size(); level++)
+        layout.levels[level].offset -= begin;
+
+    auto levels = std::make_shared<std::vector<uint8_t>>(end - begin);
+    fileReader_.submit({{texture.name, begin, levels->size(), levels->data(),
+        [this, handle, firstLevel, layout, levels, name = texture.name](size_t bytesRead, std::exception_ptr exception) {
+            if (!exception && bytesRead < levels->size())
+                exception = std::make_exception_ptr(std::runtime_error("Failed to read " + name + ", it ends before its levels do."));
+
+            // uploads may wait for staging space, which the reader's thread should not
+            jobSystem_.submitBackground([this, handle, firstLevel, layout, levels, exception] {
+                upload_(handle, firstLevel, layout, levels->data(), exception);
+            }, &jobs_);
+        }}});
+}
+
+void TextureStreamer::upload_(TextureHandle texture, uint32_t firstLevel, const TextureLayout& layout, const uint8_t* file, std::exception_ptr exception) {
+    PROFILE_SCOPE("TextureStreamer::upload");
+    auto result = Result{texture};
+    result.firstLevel = firstLevel;
+
+    try {
+        if (exception)
+            std::rethrow_exception(exception);
+
+        auto extent = levelExtent(layout.extent, firstLevel);
+        auto levelCount = static_cast<uint32_t>(layout.levels.size()) - firstLevel;
+
+        auto imageInfo = VkImageCreateInfo{};
+        imageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+        imageInfo.imageType = VK_IMAGE_TYPE_2D;
+        imageInfo.format = layout.format;
+        imageInfo.extent = {extent.width, extent.height, 1};
+        imageInfo.mipLevels = levelCount;
+        imageInfo.arrayLayers = 1;
+        imageInfo.samples = VK_SAMPLE_COUNT_1_BIT;
+        imageInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+        imageInfo.usage = VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT;
+        imageInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+        imageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+
+        result.image = allocator_.createImage(imageInfo, MemoryUsage::GpuOnly);
+
+        // coarsest first, the same order they lie in the file
+        for (auto level = static_cast<uint32_t>(layout.levels.size()); level-- > firstLevel;) {
+            auto levelExtent2D = levelExtent(layout.extent, level);
+            uploadManager_.uploadImage(result.image.image, VK_IMAGE_ASPECT_COLOR_BIT, level - firstLevel, {levelExtent2D.width, levelExtent2D.height, 1},
+                file + layout.levels[level].offset, layout.levels[level].size,
+                VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT, texelBlock(layout.format).height);
+        }
+
+        auto viewInfo = VkImageViewCreateInfo{};
+        viewInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+        viewInfo.image = result.image.image;
+        viewInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
+        viewInfo.format = layout.format;
+        viewInfo.subresourceRange = {VK_IMAGE_ASPECT_COLOR_BIT, 0, levelCount, 0, 1};
+
+        if (vkCreateImageView(device_, &viewInfo, nullptr, &result.view) != VK_SUCCESS)
+            throw std::runtime_error("Failed to create streamed texture view.");
+    }
+    catch (const std::exception& exception) {
+        result.error = exception.what();
+    }
+
+    finish_(std::move(result));
+}
+
+void TextureStreamer::finish_(Result result) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    results_.push_back(std::move(result));
+    inFlight_--;
+}
+
+void TextureStreamer::publish_(Result& result) {
+    auto& texture = textures_[result.texture];
+
+    if (result.header) {
+        if (result.error.empty()) {
+            auto formatProperties = VkFormatProperties{};
+            vkGetPhysicalDeviceFormatProperties(physicalDevice_, result.layout.format, &formatProperties);
+            if (!(formatProperties.optimalTilingFeatures & VK_FORMAT_FEATURE_SAMPLED_IMAGE_BIT))
+                result.error = "Failed to load " + texture.name + ", the device cannot sample its format.";
+        }
+        if (!result.error.empty()) {
+            std::cerr << result.error << std::endl;
+            texture.failed = true;
+            return;
+        }
+
+        texture.layout = std::move(result.layout);
+        texture.loaded = true;
+
+        auto levelCount = static_cast<uint32_t>(texture.layout.levels.size());
+        texture.residentLevel = levelCount;
+        texture.tailLevel = levelCount - 1;
+        while (texture.tailLevel > 0) {
+            auto extent = levelExtent(texture.layout.extent, texture.tailLevel - 1);
+            if (std::max(extent.width, extent.height) > tailSize)
+                break;
+            texture.tailLevel--;
+        }
+
+        // the smallest levels come in straight away, whatever the budget, so the texture shows up in a frame or two
+        build_(result.texture, texture.tailLevel);
+        return;
+    }
+
+    buildCount_--;
+    buildingBytes_ -= texture.buildBytes;
+    replacedBytes_ -= texture.image.allocation.size;
+    texture.building = false;
+
+    if (!result.error.empty()) {
+        std::cerr << "Failed to stream " << texture.name << " from level " << result.firstLevel << ": " << result.error << std::endl;
+        // copies may have been recorded into it, which the frames after this one wait for
+        if (result.image.image != VK_NULL_HANDLE)
+            retire_([this, image = result.image, view = result.view]() mutable { destroy_(image, view); });
+
+        // it keeps what it has and stops growing, a texture that never showed up is given up on
+        if (texture.residentLevel == texture.layout.levels.size())
+            texture.failed = true;
+        else if (result.firstLevel < texture.residentLevel)
+            texture.finestLevel = result.firstLevel + 1;
+        return;
+    }
+
+    // the index is replaced rather than rewritten, as the frames in flight still sample through the old one
+    auto index = bindless_.addTexture(result.view, sampler_);
+    if (texture.view != VK_NULL_HANDLE) {
+        bindless_.removeTexture(texture.index);
+        residentBytes_ -= texture.image.allocation.size;
+        retire_([this, image = texture.image, view = texture.view]() mutable { destroy_(image, view); });
+    }
+
+    texture.index = index;
+    texture.image = result.image;
+    texture.view = result.view;
+    texture.residentLevel = result.firstLevel;
+    residentBytes_ += texture.image.allocation.size;
+}
+
+void TextureStreamer::destroy_(Image& image, VkImageView view) {
+    if (view != VK_NULL_HANDLE)
+        vkDestroyImageView(device_, view, nullptr);
+    if (image.image != VK_NULL_HANDLE)
+        allocator_.destroyImage(image);
+}
+
+VkDeviceSize TextureStreamer::levelBytes_(const Texture& texture, uint32_t firstLevel) const {
+    auto bytes = VkDeviceSize(0);
+    for (auto level = firstLevel; level < texture.layout.levels.size(); level++)
+        bytes += texture.layout.levels[level].size;
+    return bytes;
+}
+
+uint32_t TextureStreamer::wantedLevel_(const Texture& texture) const {
+    if (texture.requestedFrame != frame_ || texture.requestedPixels <= 0)
+        return texture.tailLevel;
+
+    // the finest level the texture needs is the smallest one still at least as large as it is drawn
+    auto size = static_cast<float>(std::max(texture.layout.extent.width, texture.layout.extent.height));
+    auto level = texture.requestedPixels >= size ? 0u : static_cast<uint32_t>(std::floor(std::log2(size / texture.requestedPixels)));
+    return std::clamp(level, texture.finestLevel, texture.tailLevel);
+}
\ No newline at end of file
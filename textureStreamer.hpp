@@ -0,0 +1,147 @@
+#pragma once
+
+#include <vector>
+#include <string>
+#include <memory>
+#include <mutex>
+#include <functional>
+#include <vulkan/vulkan.h>
+#include "memoryAllocator.hpp"
+#include "uploadManager.hpp"
+#include "bindlessDescriptors.hpp"
+#include "assetArchive.hpp"
+#include "utilities.hpp"
+
+using TextureHandle = uint32_t;
+
+// where each mip level sits in a KTX2 file, level 0 being the full resolution one
+struct TextureLayout {
+    struct Level {
+        uint64_t offset;
+        uint64_t size;
+    };
+
+    VkFormat format;
+    VkExtent2D extent;
+    std::vector<Level> levels;
+};
+
+// loads KTX2 textures coarsest mip first and pages finer mips in and out on the fly: callers report how
+// large each texture appears on screen, and every frame the textures furthest below that resolution gain
+// a level, while textures finer than they are needed give theirs back once the budget runs out. a texture
+// always holds a contiguous run of its smallest levels in one image; a level is gained or given back by
+// building the next image from the file and swapping it in once its uploads are recorded, its smaller
+// levels come along, which adds a third at most. not thread safe, use it from the render thread
+class TextureStreamer {
+public:
+
+    using Retire = std::function<void(std::function<void()>)>;
+
+    // textures read fallbackIndex until their first levels arrive; budget is device memory in bytes, which
+    // the smallest levels of every texture count towards but are never evicted for
+    TextureStreamer(VkDevice device, VkPhysicalDevice physicalDevice, MemoryAllocator& allocator, UploadManager& uploadManager, BindlessDescriptors& bindless,
+        Utilities::JobSystem& jobSystem, Utilities::AsyncFileReader& fileReader, const AssetArchive* archive, uint32_t fallbackIndex, VkDeviceSize budget, Retire retire);
+    // the device must be idle, so call wait before idling it
+    ~TextureStreamer();
+
+    // from the archive when it has the name, otherwise from a loose file; errors are printed and leave the texture on the fallback
+    TextureHandle load(const std::string& name);
+
+    // the largest size in pixels the texture is drawn at this frame, unreported textures only want their smallest levels
+    void requestSize(TextureHandle texture, float pixels);
+    // the bindless index to sample the texture through this frame, changes whenever a level comes or goes
+    uint32_t getIndex(TextureHandle texture) const { return textures_[texture].index; }
+
+    // swaps in the textures whose uploads were recorded and starts streaming towards the requested sizes;
+    // call once per frame before the upload manager submits, so the frame waits for what it swapped in
+    void update();
+
+    VkDeviceSize getResidentBytes() const { return residentBytes_; }
+
+    // waits for the reads and uploads in flight, whose transfers may already be submitted
+    void wait();
+
+    // parses the header and level index at the start of a KTX2 file, throws if it is not one this can stream:
+    // a single 2D image without supercompression in a format with a known block size
+    static TextureLayout parseKtx2(const std::string& name, const uint8_t* data, size_t size);
+
+private:
+
+    // at most this many builds at once, so uploads of a burst of requests spread over frames
+    static constexpr uint32_t maxBuilds = 8;
+    // levels this size and smaller come first and stay
+    static constexpr uint32_t tailSize = 64;
+    // the header and the level index of the most levels a 32-bit extent allows
+    static constexpr size_t headerReadSize = 80 + 32 * 3 * sizeof(uint64_t);
+
+    struct Texture {
+        std::string name;
+        // null when loading from a loose file
+        const AssetArchiveEntry* entry = nullptr;
+        TextureLayout layout;
+        bool loaded = false;
+        bool failed = false;
+
+        uint32_t index;
+        Image image;
+        VkImageView view = VK_NULL_HANDLE;
+        // the finest level held, levels.size() while nothing is; never finer than finestLevel
+        uint32_t residentLevel = 0;
+        uint32_t tailLevel = 0;
+        uint32_t finestLevel = 0;
+
+        bool building = false;
+        VkDeviceSize buildBytes = 0;
+
+        float requestedPixels = 0;
+        uint64_t requestedFrame = 0;
+    };
+
+    // a header parsed or an image built, handed from the jobs to update
+    struct Result {
+        TextureHandle texture;
+        bool header = false;
+        TextureLayout layout;
+        Image image;
+        VkImageView view = VK_NULL_HANDLE;
+        uint32_t firstLevel = 0;
+        std::string error;
+    };
+
+    VkDevice device_;
+    VkPhysicalDevice physicalDevice_;
+    MemoryAllocator& allocator_;
+    UploadManager& uploadManager_;
+    BindlessDescriptors& bindless_;
+    Utilities::JobSystem& jobSystem_;
+    Utilities::AsyncFileReader& fileReader_;
+    const AssetArchive* archive_;
+    uint32_t fallbackIndex_;
+    VkDeviceSize budget_;
+    Retire retire_;
+
+    VkSampler sampler_;
+    std::vector<Texture> textures_;
+    uint64_t frame_ = 1;
+    VkDeviceSize residentBytes_ = 0;
+    // what the builds will hold and what they replace once they land, so residentBytes_ + buildingBytes_ -
+    // replacedBytes_ is what the textures hold after them
+    VkDeviceSize buildingBytes_ = 0;
+    VkDeviceSize replacedBytes_ = 0;
+    uint32_t buildCount_ = 0;
+
+    Utilities::JobSystem::Counter jobs_;
+    std::mutex mutex_;
+    std::vector<Result> results_;
+    // headers and builds not yet in results_, some of them waiting on reads rather than jobs
+    uint32_t inFlight_ = 0;
+
+    void build_(TextureHandle texture, uint32_t firstLevel);
+    // file holds the levels at the layout's offsets, or exception tells why it could not be read
+    void upload_(TextureHandle texture, uint32_t firstLevel, const TextureLayout& layout, const uint8_t* file, std::exception_ptr exception);
+    void finish_(Result result);
+    void publish_(Result& result);
+    void destroy_(Image& image, VkImageView view);
+    VkDeviceSize levelBytes_(const Texture& texture, uint32_t firstLevel) const;
+    uint32_t wantedLevel_(const Texture& texture) const;
+};
\ No newline at end of file
@@ -0,0 +1,96 @@
+#include "../assetArchive.hpp"
+#include "../shaderCompiler.hpp"
+#include "../utilities.hpp"
+#include <iostream>
+#include <filesystem>
+#include <algorithm>
+#include <cstring>
+
+// packs files into the archive the engine maps at startup; GLSL sources are stored compiled, under their
+// source name, so the engine never runs the compiler for them; run from the directory the engine runs from
+// usage: assetPacker <output.pak> [--compress] <file or directory>...
+namespace {
+    bool isShaderSource(const std::filesystem::path& path) {
+        auto extension = path.extension().string();
+        return extension == ".vert" || extension == ".frag" || extension == ".comp" ||
+            extension == ".geom" || extension == ".tesc" || extension == ".tese";
+    }
+
+    AssetType assetType(const std::filesystem::path& path) {
+        auto extension = path.extension().string();
+        if (extension == ".spv" || isShaderSource(path))
+            return AssetType::Shader;
+        if (extension == ".mesh")
+            return AssetType::Mesh;
+        if (extension == ".ktx2")
+            return AssetType::Texture;
+        return AssetType::Raw;
+    }
+}
+
+int main(int argc, char** argv) {
+    if (argc < 3) {
+        std::cerr << "usage: assetPacker <output.pak> [--compress] <file or directory>..." << std::endl;
+        return 1;
+    }
+
+    auto compress = false;
+    std::vector<std::filesystem::path> files;
+    for (auto i = 2; i < argc; i++) {
+        if (strcmp(argv[i], "--compress") == 0) {
+            compress = true;
+            continue;
+        }
+
+        auto path = std::filesystem::path(argv[i]).lexically_normal();
+        if (std::filesystem::is_directory(path)) {
+            for (const auto& entry : std::filesystem::recursive_directory_iterator(path))
+                if (entry.is_regular_file())
+                    files.push_back(entry.path().lexically_normal());
+        }
+        else {
+            files.push_back(path);
+        }
+    }
+
+    // the same archive for the same inputs, whatever order the directories list them in
+    std::sort(files.begin(), files.end());
+    files.erase(std::unique(files.begin(), files.end()), files.end());
+
+    try {
+        // no disk cache, the archive is the cache
+        ShaderCompiler shaderCompiler("");
+
+        std::vector<PackedAsset> assets;
+        uint64_t totalSize = 0;
+        for (const auto& file : files) {
+            auto asset = PackedAsset{};
+            asset.name = file.generic_string();
+            asset.type = assetType(file);
+            // textures stream a few levels at a time straight from the mapping, which compression would rule out
+            asset.compress = compress && asset.type != AssetType::Texture;
+
+            if (isShaderSource(file)) {
+                auto spirv = shaderCompiler.compile(asset.name);
+                auto bytes = reinterpret_cast<const uint8_t*>(spirv.data());
+                asset.data.assign(bytes, bytes + spirv.size() * sizeof(uint32_t));
+            }
+            else {
+                auto contents = Utilities::readFile(asset.name);
+                asset.data.assign(contents.begin(), contents.end());
+            }
+
+            totalSize += asset.data.size();
+            assets.push_back(std::move(asset));
+        }
+
+        AssetArchive::write(argv[1], assets);
+        std::cout << "Packed " << assets.size() << " assets, " << totalSize << " bytes, into " << argv[1] << std::endl;
+    }
+    catch (const std::exception& exception) {
+        std::cerr << exception.what() << std::endl;
+        return 1;
+    }
+
+    return 0;
+}
\ No newline at end of file
@@ -0,0 +1,392 @@
+#include "uploadManager.hpp"
+#include "profiler.hpp"
+#include <stdexcept>
+#include <algorithm>
+#include <cstring>
+
+namespace {
+
+    // keeps every staged region valid as a buffer to image copy source, for texel blocks up to 16 bytes
+    const VkDeviceSize copyAlignment = 16;
+
+    VkDeviceSize alignUp(VkDeviceSize value, VkDeviceSize alignment) {
+        return (value + alignment - 1) / alignment * alignment;
+    }
+}
+
+UploadManager::UploadManager(VkDevice device, MemoryAllocator& allocator, uint32_t transferQueueFamily, VkQueue transferQueue, uint32_t graphicsQueueFamily,
+    std::mutex* queueMutex, VkDeviceSize ringSize)
+    : device_(device), allocator_(allocator), transferQueueFamily_(transferQueueFamily), graphicsQueueFamily_(graphicsQueueFamily),
+      transferQueue_(transferQueue), queueMutex_(queueMutex), ringSize_(ringSize) {
+    auto commandPoolInfo = VkCommandPoolCreateInfo{};
+    commandPoolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+    commandPoolInfo.flags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT | VK_COMMAND_POOL_CREATE_TRANSIENT_BIT;
+    commandPoolInfo.queueFamilyIndex = transferQueueFamily_;
+
+    if (vkCreateCommandPool(device_, &commandPoolInfo, nullptr, &commandPool_) != VK_SUCCESS)
+        throw std::runtime_error("Failed to create upload command pool.");
+
+    auto bufferInfo = VkBufferCreateInfo{};
+    bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+    bufferInfo.size = ringSize_;
+    bufferInfo.usage = VK_BUFFER_USAGE_TRANSFER_SRC_BIT;
+    bufferInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+
+    ring_ = allocator_.createBuffer(bufferInfo, MemoryUsage::CpuToGpu);
+}
+
+UploadManager::~UploadManager() {
+    auto destroyBatch = [this](Batch& batch) {
+        vkDestroySemaphore(device_, batch.semaphore, nullptr);
+        vkDestroyFence(device_, batch.fence, nullptr);
+    };
+
+    for (auto& batch : submitted_) {
+        vkWaitForFences(device_, 1, &batch.fence, VK_TRUE, UINT64_MAX);
+        destroyBatch(batch);
+    }
+    for (auto& batch : freeBatches_)
+        destroyBatch(batch);
+
+    vkDestroyCommandPool(device_, commandPool_, nullptr);
+    allocator_.destroyBuffer(ring_);
+}
+
+void UploadManager::uploadBuffer(VkBuffer buffer, VkDeviceSize offset, const void* data, VkDeviceSize size, VkPipelineStageFlags dstStage, VkAccessFlags dstAccess) {
+    std::unique_lock<std::mutex> lock(mutex_);
+
+    // large buffers go through in pieces so they never need more than half the ring at once
+    auto source = static_cast<const char*>(data);
+    for (VkDeviceSize copied = 0; copied < size;) {
+        auto chunkSize = std::min(size - copied, ringSize_ / 2);
+
+        auto copy = PendingCopy{};
+        copy.buffer = buffer;
+        copy.bufferRegion.srcOffset = stage_(lock, source + copied, chunkSize);
+        copy.bufferRegion.dstOffset = offset + copied;
+        copy.bufferRegion.size = chunkSize;
+        copy.dstStage = dstStage;
+        copy.dstAccess = dstAccess;
+        pending_.push_back(copy);
+
+        copied += chunkSize;
+    }
+}
+
+void UploadManager::uploadImage(VkImage image, VkImageAspectFlags aspect, uint32_t mipLevel, VkExtent3D extent, const void* data, VkDeviceSize size,
+    VkImageLayout finalLayout, VkPipelineStageFlags dstStage, VkAccessFlags dstAccess, uint32_t blockHeight) {
+    std::unique_lock<std::mutex> lock(mutex_);
+
+    // like buffers, large levels go through in bands of at most half the ring; rows are tightly packed, so a band
+    // of whole block rows is one run of bytes
+    auto blockRows = (extent.height + blockHeight - 1) / blockHeight;
+    auto bandRows = blockRows;
+    if (size > ringSize_ / 2) {
+        if (extent.depth != 1 || blockRows == 0 || size % blockRows != 0)
+            throw std::runtime_error("Failed to stage upload, the image does not fit in half the staging ring and cannot be split into rows.");
+        bandRows = static_cast<uint32_t>(std::max<VkDeviceSize>(ringSize_ / 2 / (size / blockRows), 1));
+    }
+
+    auto source = static_cast<const char*>(data);
+    for (uint32_t row = 0; row < blockRows; row += bandRows) {
+        auto rows = std::min(bandRows, blockRows - row);
+        auto top = row * blockHeight;
+        auto bandSize = rows == blockRows ? size : size / blockRows * rows;
+
+        auto copy = PendingCopy{};
+        copy.image = image;
+        copy.imageRegion.bufferOffset = stage_(lock, source + size / blockRows * row, bandSize);
+        copy.imageRegion.imageSubresource = {aspect, mipLevel, 0, 1};
+        copy.imageRegion.imageOffset = {0, static_cast<int32_t>(top), 0};
+        copy.imageRegion.imageExtent = {extent.width, std::min(rows * blockHeight, extent.height - top), extent.depth};
+        copy.subresourceRange = {aspect, mipLevel, 1, 0, 1};
+        copy.finalLayout = finalLayout;
+        copy.dstStage = dstStage;
+        copy.dstAccess = dstAccess;
+        copy.firstBand = row == 0;
+        copy.lastBand = row + rows == blockRows;
+        pending_.push_back(copy);
+    }
+}
+
+void UploadManager::submit() {
+    PROFILE_SCOPE("UploadManager::submit");
+    std::lock_guard<std::mutex> lock(mutex_);
+    submitLocked_();
+}
+
+void UploadManager::acquire(VkCommandBuffer commandBuffer, uint64_t frame, std::vector<VkSemaphore>& waitSemaphores, std::vector<VkPipelineStageFlags>& waitStages) {
+    std::lock_guard<std::mutex> lock(mutex_);
+
+    for (auto& batch : submitted_) {
+        if (batch.consumingFrame != 0)
+            continue;
+
+        // the barrier starts at the stages the semaphore wait blocks, so the two chain together
+        if (!batch.bufferAcquires.empty() || !batch.imageAcquires.empty())
+            vkCmdPipelineBarrier(commandBuffer, batch.dstStages, batch.dstStages, 0, 0, nullptr,
+                static_cast<uint32_t>(batch.bufferAcquires.size()), batch.bufferAcquires.data(),
+                static_cast<uint32_t>(batch.imageAcquires.size()), batch.imageAcquires.data());
+
+        waitSemaphores.push_back(batch.semaphore);
+        waitStages.push_back(batch.dstStages);
+        batch.consumingFrame = frame;
+    }
+}
+
+void UploadManager::collect(uint64_t completedFrame) {
+    std::lock_guard<std::mutex> lock(mutex_);
+
+    releaseFinished_();
+    if (fenceWaiters_ > 0)
+        return;
+
+    // a binary semaphore may only be signaled again once the wait on it has completed
+    while (!submitted_.empty()) {
+        auto& batch = submitted_.front();
+        if (!batch.copiesDone || batch.consumingFrame == 0 || batch.consumingFrame > completedFrame)
+            break;
+
+        freeBatches_.push_back(std::move(batch));
+        submitted_.pop_front();
+    }
+}
+
+VkDeviceSize UploadManager::stage_(std::unique_lock<std::mutex>& lock, const void* data, VkDeviceSize size) {
+    VkDeviceSize offset;
+
+    while (!tryAllocate_(size, offset)) {
+        releaseFinished_();
+        if (tryAllocate_(size, offset))
+            break;
+
+        // copies still waiting to be recorded hold ring space no fence will ever release
+        if (!pending_.empty()) {
+            submitLocked_();
+            continue;
+        }
+
+        auto busy = std::find_if(submitted_.begin(), submitted_.end(), [](const Batch& batch) { return !batch.copiesDone; });
+        if (busy == submitted_.end())
+            throw std::runtime_error("Failed to stage upload, it does not fit in the staging ring.");
+
+        auto fence = busy->fence;
+        fenceWaiters_++;
+        lock.unlock();
+        vkWaitForFences(device_, 1, &fence, VK_TRUE, UINT64_MAX);
+        lock.lock();
+        fenceWaiters_--;
+    }
+
+    memcpy(static_cast<char*>(ring_.allocation.mapped) + offset, data, size);
+    return offset;
+}
+
+bool UploadManager::tryAllocate_(VkDeviceSize size, VkDeviceSize& offset) {
+    if (head_ == tail_)
+        head_ = tail_ = 0;
+
+    auto aligned = alignUp(head_, copyAlignment);
+
+    if (head_ >= tail_) {
+        if (aligned + size <= ringSize_) {
+            offset = aligned;
+            head_ = aligned + size;
+            return true;
+        }
+
+        // wrap around, strictly below tail_ so a full ring never looks empty
+        if (size < tail_) {
+            offset = 0;
+            head_ = size;
+            return true;
+        }
+
+        return false;
+    }
+
+    if (aligned + size < tail_) {
+        offset = aligned;
+        head_ = aligned + size;
+        return true;
+    }
+
+    return false;
+}
+
+void UploadManager::releaseFinished_() {
+    // batches go to a single queue, so their fences signal in submission order
+    for (auto& batch : submitted_) {
+        if (batch.copiesDone)
+            continue;
+        if (vkGetFenceStatus(device_, batch.fence) != VK_SUCCESS)
+            break;
+
+        batch.copiesDone = true;
+        tail_ = batch.ringEnd;
+    }
+}
+
+void UploadManager::submitLocked_() {
+    if (pending_.empty())
+        return;
+
+    auto batch = Batch{};
+    if (!freeBatches_.empty()) {
+        batch = std::move(freeBatches_.back());
+        freeBatches_.pop_back();
+    }
+    else
+        batch = createBatch_();
+
+    vkResetFences(device_, 1, &batch.fence);
+    if (vkResetCommandBuffer(batch.commandBuffer, 0) != VK_SUCCESS)
+        throw std::runtime_error("Failed to reset upload command buffer.");
+
+    auto beginInfo = VkCommandBufferBeginInfo{};
+    beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+    beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+
+    if (vkBeginCommandBuffer(batch.commandBuffer, &beginInfo) != VK_SUCCESS)
+        throw std::runtime_error("Failed to begin upload command buffer.");
+
+    // images are overwritten entirely, so whatever they held before can be discarded
+    std::vector<VkImageMemoryBarrier> transferBarriers;
+    for (const auto& copy : pending_) {
+        if (copy.image == VK_NULL_HANDLE || !copy.firstBand)
+            continue;
+
+        auto barrier = VkImageMemoryBarrier{};
+        barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+        barrier.srcAccessMask = 0;
+        barrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+        barrier.oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+        barrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+        barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        barrier.image = copy.image;
+        barrier.subresourceRange = copy.subresourceRange;
+        transferBarriers.push_back(barrier);
+    }
+
+    if (!transferBarriers.empty())
+        vkCmdPipelineBarrier(batch.commandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, nullptr, 0, nullptr,
+            static_cast<uint32_t>(transferBarriers.size()), transferBarriers.data());
+
+    for (const auto& copy : pending_)
+        if (copy.image == VK_NULL_HANDLE)
+            vkCmdCopyBuffer(batch.commandBuffer, ring_.buffer, copy.buffer, 1, &copy.bufferRegion);
+        else
+            vkCmdCopyBufferToImage(batch.commandBuffer, ring_.buffer, copy.image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &copy.imageRegion);
+
+    // on a separate family every destination is released here and acquired by the graphics queue with a
+    // matching barrier, otherwise the semaphore wait alone makes the writes visible
+    const auto transferOwnership = transferQueueFamily_ != graphicsQueueFamily_;
+    std::vector<VkBufferMemoryBarrier> bufferReleases;
+    std::vector<VkImageMemoryBarrier> imageReleases;
+    batch.dstStages = 0;
+    batch.bufferAcquires.clear();
+    batch.imageAcquires.clear();
+
+    for (const auto& copy : pending_) {
+        batch.dstStages |= copy.dstStage;
+
+        if (copy.image == VK_NULL_HANDLE) {
+            if (!transferOwnership)
+                continue;
+
+            auto barrier = VkBufferMemoryBarrier{};
+            barrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+            barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+            barrier.dstAccessMask = 0;
+            barrier.srcQueueFamilyIndex = transferQueueFamily_;
+            barrier.dstQueueFamilyIndex = graphicsQueueFamily_;
+            barrier.buffer = copy.buffer;
+            barrier.offset = copy.bufferRegion.dstOffset;
+            barrier.size = copy.bufferRegion.size;
+            bufferReleases.push_back(barrier);
+
+            barrier.srcAccessMask = 0;
+            barrier.dstAccessMask = copy.dstAccess;
+            batch.bufferAcquires.push_back(barrier);
+            continue;
+        }
+
+        // earlier bands of a level stay in the transfer layout for the batches holding the rest
+        if (!copy.lastBand)
+            continue;
+
+        auto barrier = VkImageMemoryBarrier{};
+        barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+        barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+        barrier.dstAccessMask = 0;
+        barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+        barrier.newLayout = copy.finalLayout;
+        barrier.srcQueueFamilyIndex = transferOwnership ? transferQueueFamily_ : VK_QUEUE_FAMILY_IGNORED;
+        barrier.dstQueueFamilyIndex = transferOwnership ? graphicsQueueFamily_ : VK_QUEUE_FAMILY_IGNORED;
+        barrier.image = copy.image;
+        barrier.subresourceRange = copy.subresourceRange;
+        imageReleases.push_back(barrier);
+
+        if (transferOwnership) {
+            barrier.srcAccessMask = 0;
+            barrier.dstAccessMask = copy.dstAccess;
+            batch.imageAcquires.push_back(barrier);
+        }
+    }
+
+    if (!bufferReleases.empty() || !imageReleases.empty())
+        vkCmdPipelineBarrier(batch.commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, 0, 0, nullptr,
+            static_cast<uint32_t>(bufferReleases.size()), bufferReleases.data(),
+            static_cast<uint32_t>(imageReleases.size()), imageReleases.data());
+
+    if (vkEndCommandBuffer(batch.commandBuffer) != VK_SUCCESS)
+        throw std::runtime_error("Failed to end upload command buffer.");
+
+    auto submitInfo = VkSubmitInfo{};
+    submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+    submitInfo.commandBufferCount = 1;
+    submitInfo.pCommandBuffers = &batch.commandBuffer;
+    submitInfo.signalSemaphoreCount = 1;
+    submitInfo.pSignalSemaphores = &batch.semaphore;
+
+    {
+        std::unique_lock<std::mutex> queueLock;
+        if (queueMutex_)
+            queueLock = std::unique_lock<std::mutex>(*queueMutex_);
+
+        if (vkQueueSubmit(transferQueue_, 1, &submitInfo, batch.fence) != VK_SUCCESS)
+            throw std::runtime_error("Failed to submit uploads.");
+    }
+
+    batch.ringEnd = head_;
+    batch.copiesDone = false;
+    batch.consumingFrame = 0;
+    submitted_.push_back(std::move(batch));
+    pending_.clear();
+}
+
+UploadManager::Batch UploadManager::createBatch_() {
+    auto batch = Batch{};
+
+    auto allocateInfo = VkCommandBufferAllocateInfo{};
+    allocateInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+    allocateInfo.commandPool = commandPool_;
+    allocateInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+    allocateInfo.commandBufferCount = 1;
+
+    if (vkAllocateCommandBuffers(device_, &allocateInfo, &batch.commandBuffer) != VK_SUCCESS)
+        throw std::runtime_error("Failed to allocate upload command buffer.");
+
+    auto semaphoreInfo = VkSemaphoreCreateInfo{};
+    semaphoreInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+
+    auto fenceInfo = VkFenceCreateInfo{};
+    fenceInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+
+    if (vkCreateSemaphore(device_, &semaphoreInfo, nullptr, &batch.semaphore) != VK_SUCCESS ||
+        vkCreateFence(device_, &fenceInfo, nullptr, &batch.fence) != VK_SUCCESS)
+        throw std::runtime_error("Failed to create upload sync objects.");
+
+    return batch;
+}
\ No newline at end of file
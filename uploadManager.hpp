@@ -0,0 +1,98 @@
+#pragma once
+
+#include <vector>
+#include <deque>
+#include <mutex>
+#include <vulkan/vulkan.h>
+#include "memoryAllocator.hpp"
+
+// streams data to the gpu through a persistently mapped staging ring and the transfer queue.
+// upload calls are thread safe and only block when the ring is full; the render thread submits the
+// recorded copies once per frame and makes its next graphics submit wait for them, so copies overlap
+// rendering instead of stalling it. destinations must use VK_SHARING_MODE_EXCLUSIVE, ownership is
+// transferred to the graphics family when the transfer queue belongs to another family.
+class UploadManager {
+public:
+
+    // queueMutex guards transferQueue when it is shared with the render thread, null when it is not
+    UploadManager(VkDevice device, MemoryAllocator& allocator, uint32_t transferQueueFamily, VkQueue transferQueue, uint32_t graphicsQueueFamily,
+        std::mutex* queueMutex = nullptr, VkDeviceSize ringSize = 32ull * 1024 * 1024);
+    ~UploadManager();
+
+    // dstStage and dstAccess describe the first graphics queue use of the data
+    void uploadBuffer(VkBuffer buffer, VkDeviceSize offset, const void* data, VkDeviceSize size, VkPipelineStageFlags dstStage, VkAccessFlags dstAccess);
+
+    // fills a whole mip level from tightly packed rows, the previous contents are discarded and the image ends in finalLayout;
+    // blockHeight is the texel block height of block compressed formats, 2D levels are split on block rows to fit the ring
+    void uploadImage(VkImage image, VkImageAspectFlags aspect, uint32_t mipLevel, VkExtent3D extent, const void* data, VkDeviceSize size,
+        VkImageLayout finalLayout, VkPipelineStageFlags dstStage, VkAccessFlags dstAccess, uint32_t blockHeight = 1);
+
+    // sends the copies recorded so far to the transfer queue in a single submission
+    void submit();
+
+    // records the ownership acquires for every submitted batch into a graphics command buffer and
+    // returns the semaphores its submission must wait on; frame is the number that submission will complete
+    void acquire(VkCommandBuffer commandBuffer, uint64_t frame, std::vector<VkSemaphore>& waitSemaphores, std::vector<VkPipelineStageFlags>& waitStages);
+
+    // releases staging space of finished copies and recycles batches whose consuming frame is done
+    void collect(uint64_t completedFrame);
+
+private:
+
+    struct PendingCopy {
+        VkBuffer buffer;
+        VkBufferCopy bufferRegion;
+        VkImage image;
+        VkBufferImageCopy imageRegion;
+        VkImageSubresourceRange subresourceRange;
+        VkImageLayout finalLayout;
+        VkPipelineStageFlags dstStage;
+        VkAccessFlags dstAccess;
+        // a level split into bands is made writable before its first band and released after its last,
+        // which may land in a later batch
+        bool firstBand = true;
+        bool lastBand = true;
+    };
+
+    struct Batch {
+        VkCommandBuffer commandBuffer = VK_NULL_HANDLE;
+        VkFence fence = VK_NULL_HANDLE;
+        VkSemaphore semaphore = VK_NULL_HANDLE;
+        // ring head once the batch was recorded, everything before it is free once the copies are done
+        VkDeviceSize ringEnd = 0;
+        bool copiesDone = false;
+        // 0 until a graphics submission waits on the semaphore
+        uint64_t consumingFrame = 0;
+        VkPipelineStageFlags dstStages = 0;
+        std::vector<VkBufferMemoryBarrier> bufferAcquires;
+        std::vector<VkImageMemoryBarrier> imageAcquires;
+    };
+
+    VkDevice device_;
+    MemoryAllocator& allocator_;
+    uint32_t transferQueueFamily_;
+    uint32_t graphicsQueueFamily_;
+    VkQueue transferQueue_;
+    std::mutex* queueMutex_;
+
+    VkCommandPool commandPool_;
+
+    Buffer ring_;
+    VkDeviceSize ringSize_;
+    // allocations go at head_ and are released from tail_, head_ == tail_ only when the ring is empty
+    VkDeviceSize head_ = 0;
+    VkDeviceSize tail_ = 0;
+
+    std::mutex mutex_;
+    std::vector<PendingCopy> pending_;
+    std::deque<Batch> submitted_;
+    std::vector<Batch> freeBatches_;
+    // uploaders blocked on a batch fence, batches are not recycled meanwhile so the fence is not reset under them
+    uint32_t fenceWaiters_ = 0;
+
+    VkDeviceSize stage_(std::unique_lock<std::mutex>& lock, const void* data, VkDeviceSize size);
+    bool tryAllocate_(VkDeviceSize size, VkDeviceSize& offset);
+    void releaseFinished_();
+    void submitLocked_();
+    Batch createBatch_();
+};
\ No newline at end of file
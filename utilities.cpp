@@ -1,12 +1,32 @@
 #include "utilities.hpp"
+#include "profiler.hpp"
 #include <fstream>
 #include <ios>
+#include <algorithm>
+#include <utility>
+#include <cstring>
+
+#ifdef __linux__
+    #include <sys/inotify.h>
+    #include <sys/eventfd.h>
+    #include <sys/mman.h>
+    #include <sys/syscall.h>
+    #include <sys/uio.h>
+    #include <linux/io_uring.h>
+    #include <poll.h>
+#endif
+
+#ifndef _WIN32
+    #include <fcntl.h>
+    #include <unistd.h>
+    #include <cerrno>
+#endif
 
 std::vector<char> Utilities::readFile(const std::string& filename) {
     std::ifstream file(filename, std::ios::ate | std::ios::binary);
 
     if (!file.is_open())
-        throw std::runtime_error("Faile to open file.");
+        throw std::runtime_error("Failed to open " + filename + ".");
 
     auto fileSize = (size_t) file.tellg();
     std::vector<char> buffer(fileSize);
@@ -18,42 +38,1123 @@ std::vector<char> Utilities::readFile(const std::string& filename) {
     return buffer;
 }
 
+uint64_t Utilities::hashBytes(const void* data, size_t size, uint64_t seed) {
+    auto bytes = static_cast<const uint8_t*>(data);
+    auto hash = seed;
+
+    for (size_t i = 0; i < size; i++) {
+        hash ^= bytes[i];
+        hash *= 1099511628211ull;
+    }
+
+    return hash;
+}
+
+namespace {
+    const size_t lz4MinMatch = 4;
+    // the format ends every block with literals: the last match starts 12 bytes and ends 5 bytes before the end at the latest
+    const size_t lz4MatchStartLimit = 12;
+    const size_t lz4LastLiterals = 5;
+    const size_t lz4HashBits = 16;
+
+    uint32_t read32(const uint8_t* bytes) {
+        uint32_t value;
+        memcpy(&value, bytes, sizeof(value));
+        return value;
+    }
+
+    void writeLength(std::vector<uint8_t>& output, size_t length) {
+        for (; length >= 255; length -= 255)
+            output.push_back(255);
+        output.push_back(static_cast<uint8_t>(length));
+    }
+
+    void writeSequence(std::vector<uint8_t>& output, const uint8_t* literals, size_t literalCount, size_t offset, size_t matchLength) {
+        auto matchCode = matchLength - lz4MinMatch;
+        output.push_back(static_cast<uint8_t>((std::min<size_t>(literalCount, 15) << 4) | std::min<size_t>(matchCode, 15)));
+        if (literalCount >= 15)
+            writeLength(output, literalCount - 15);
+
+        output.insert(output.end(), literals, literals + literalCount);
+
+        output.push_back(static_cast<uint8_t>(offset));
+        output.push_back(static_cast<uint8_t>(offset >> 8));
+        if (matchCode >= 15)
+            writeLength(output, matchCode - 15);
+    }
+
+    bool readLength(const uint8_t* source, size_t size, size_t& position, size_t& length) {
+        while (true) {
+            if (position >= size)
+                return false;
+
+            auto byte = source[position++];
+            length += byte;
+            if (byte != 255)
+                return true;
+        }
+    }
+}
+
+std::vector<uint8_t> Utilities::lz4Compress(const void* data, size_t size) {
+    auto source = static_cast<const uint8_t*>(data);
+    std::vector<uint8_t> output;
+    output.reserve(size + size / 255 + 16);
+
+    // greedy matching against the last position seen for each hash of 4 bytes
+    const auto none = SIZE_MAX;
+    std::vector<size_t> table(size_t(1) << lz4HashBits, none);
+
+    size_t anchor = 0;
+    size_t position = 0;
+    while (size >= lz4MatchStartLimit && position <= size - lz4MatchStartLimit) {
+        auto sequence = read32(source + position);
+        auto& slot = table[(sequence * 2654435761u) >> (32 - lz4HashBits)];
+        auto candidate = slot;
+        slot = position;
+
+        if (candidate == none || position - candidate > 65535 || read32(source + candidate) != sequence) {
+            position++;
+            continue;
+        }
+
+        auto matchLength = lz4MinMatch;
+        while (position + matchLength < size - lz4LastLiterals && source[candidate + matchLength] == source[position + matchLength])
+            matchLength++;
+
+        writeSequence(output, source + anchor, position - anchor, position - candidate, matchLength);
+        position += matchLength;
+        anchor = position;
+    }
+
+    auto literalCount = size - anchor;
+    output.push_back(static_cast<uint8_t>(std::min<size_t>(literalCount, 15) << 4));
+    if (literalCount >= 15)
+        writeLength(output, literalCount - 15);
+    output.insert(output.end(), source + anchor, source + size);
+
+    return output;
+}
+
+bool Utilities::lz4Decompress(const void* data, size_t size, void* destination, size_t destinationSize) {
+    auto source = static_cast<const uint8_t*>(data);
+    auto output = static_cast<uint8_t*>(destination);
+    size_t in = 0;
+    size_t out = 0;
+
+    while (in < size) {
+        auto token = source[in++];
+
+        size_t literalCount = token >> 4;
+        if (literalCount == 15 && !readLength(source, size, in, literalCount))
+            return false;
+        if (literalCount > size - in || literalCount > destinationSize - out)
+            return false;
+
+        if (literalCount > 0)
+            memcpy(output + out, source + in, literalCount);
+        in += literalCount;
+        out += literalCount;
+
+        // only the last sequence has no match
+        if (in == size)
+            break;
+        if (size - in < 2)
+            return false;
+
+        size_t offset = source[in] | (source[in + 1] << 8);
+        in += 2;
+        if (offset == 0 || offset > out)
+            return false;
+
+        size_t matchLength = token & 15;
+        if (matchLength == 15 && !readLength(source, size, in, matchLength))
+            return false;
+        matchLength += lz4MinMatch;
+        if (matchLength > destinationSize - out)
+            return false;
+
+        // matches may overlap their own output, which repeats the last offset bytes
+        if (offset >= matchLength)
+            memcpy(output + out, output + out - offset, matchLength);
+        else
+            for (size_t i = 0; i < matchLength; i++)
+                output[out + i] = output[out + i - offset];
+        out += matchLength;
+    }
+
+    return out == destinationSize;
+}
+
+namespace {
+    // which job system and queue the calling thread works for, if any
+    thread_local const Utilities::JobSystem* currentJobSystem = nullptr;
+    thread_local uint32_t currentQueue = 0;
+}
+
+Utilities::JobSystem::JobSystem(uint32_t workerCount) {
+    if (workerCount == 0)
+        workerCount = std::max(std::thread::hardware_concurrency(), 2u) - 1;
+
+    for (uint32_t i = 0; i <= workerCount; i++)
+        queues_.push_back(std::make_unique<Queue>());
+
+    for (uint32_t i = 0; i < workerCount; i++)
+        workers_.emplace_back(&JobSystem::work_, this, i + 1);
+}
+
+Utilities::JobSystem::~JobSystem() {
+    {
+        std::lock_guard<std::mutex> lock(sleepMutex_);
+        stopping_ = true;
+    }
+    workCondition_.notify_all();
+
+    for (auto& worker : workers_)
+        worker.join();
+}
+
+void Utilities::JobSystem::submit(Job job, Counter* counter) {
+    if (counter)
+        counter->pending_++;
+
+    push_({std::move(job), counter}, false);
+}
+
+void Utilities::JobSystem::submitAfter(Counter& dependency, Job job, Counter* counter) {
+    if (counter)
+        counter->pending_++;
+
+    {
+        std::lock_guard<std::mutex> lock(dependency.mutex_);
+        if (dependency.pending_ != 0) {
+            dependency.continuations_.push_back({std::move(job), counter});
+            return;
+        }
+    }
+
+    push_({std::move(job), counter}, false);
+}
+
+void Utilities::JobSystem::submitBackground(Job job, Counter* counter) {
+    if (counter)
+        counter->pending_++;
+
+    push_({std::move(job), counter}, true);
+}
+
+void Utilities::JobSystem::submitToMainThread(Job job, Counter* counter) {
+    if (counter)
+        counter->pending_++;
+
+    std::lock_guard<std::mutex> lock(mainMutex_);
+    mainTasks_.push_back({std::move(job), counter});
+}
+
+void Utilities::JobSystem::runMainThreadJobs() {
+    std::deque<Task> tasks;
+    {
+        std::lock_guard<std::mutex> lock(mainMutex_);
+        tasks.swap(mainTasks_);
+    }
+
+    for (auto& task : tasks)
+        run_(task);
+}
+
+void Utilities::JobSystem::wait(Counter& counter) {
+    while (!counter.isDone()) {
+        auto task = Task{};
+        if (pop_(task, &counter)) {
+            run_(task);
+            continue;
+        }
+
+        std::unique_lock<std::mutex> lock(sleepMutex_);
+        waiters_++;
+        waitCondition_.wait(lock, [&] { return counter.isDone() || counter.queued_ > 0; });
+        waiters_--;
+    }
+
+    // the last job may still hold the counter's lock, let it leave before the counter can go away
+    std::lock_guard<std::mutex> lock(counter.mutex_);
+    if (counter.exception_)
+        std::rethrow_exception(std::exchange(counter.exception_, nullptr));
+}
+
+void Utilities::JobSystem::parallelFor(uint32_t count, const std::function<void(uint32_t)>& task) {
+    if (count == 0)
+        return;
+
+    // a few jobs pulling indices rather than a job per index, so small tasks are not swamped by scheduling
+    std::atomic<uint32_t> nextIndex = 0;
+    std::mutex exceptionMutex;
+    std::exception_ptr exception;
+    auto runTasks = [&] {
+        for (auto i = nextIndex++; i < count; i = nextIndex++) {
+            try {
+                task(i);
+            } catch (...) {
+                std::lock_guard<std::mutex> lock(exceptionMutex);
+                if (!exception)
+                    exception = std::current_exception();
+            }
+        }
+    };
+
+    auto counter = Counter{};
+    for (uint32_t i = 1; i < std::min(count, threadCount()); i++)
+        submit(runTasks, &counter);
+
+    runTasks();
+    wait(counter);
+
+    if (exception)
+        std::rethrow_exception(exception);
+}
+
+void Utilities::JobSystem::work_(uint32_t queue) {
+    currentJobSystem = this;
+    currentQueue = queue;
+    PROFILE_THREAD("Worker " + std::to_string(queue));
+
+    while (true) {
+        auto task = Task{};
+        if (pop_(task, nullptr)) {
+            run_(task);
+            continue;
+        }
+
+        std::unique_lock<std::mutex> lock(sleepMutex_);
+        idleWorkers_++;
+        workCondition_.wait(lock, [this] { return stopping_ || queued_ > 0 || backgroundQueued_ > 0; });
+        idleWorkers_--;
+
+        if (stopping_ && queued_ == 0 && backgroundQueued_ == 0)
+            return;
+    }
+}
+
+void Utilities::JobSystem::push_(Task task, bool background) {
+    auto& queue = background ? background_ : *queues_[currentJobSystem == this ? currentQueue : 0];
+    // waiters never take background jobs, so those do not count as theirs
+    auto counter = background ? nullptr : task.counter;
+    {
+        std::lock_guard<std::mutex> lock(queue.mutex);
+        queue.tasks.push_back(std::move(task));
+        if (background)
+            backgroundQueued_++;
+        else
+            queued_++;
+        if (counter)
+            counter->queued_++;
+    }
+
+    wake_(true, counter != nullptr);
+}
+
+bool Utilities::JobSystem::pop_(Task& task, const Counter* counter) {
+    if (counter && counter->queued_ == 0)
+        return false;
+
+    auto take = [&](std::deque<Task>& tasks, size_t i) {
+        task = std::move(tasks[i]);
+        tasks.erase(tasks.begin() + i);
+        queued_--;
+        if (task.counter)
+            task.counter->queued_--;
+    };
+
+    // newest first from our own deque, it is likely still in cache
+    auto self = currentJobSystem == this ? currentQueue : 0;
+    {
+        auto& queue = *queues_[self];
+        std::lock_guard<std::mutex> lock(queue.mutex);
+        for (auto i = queue.tasks.size(); i-- > 0;)
+            if (!counter || queue.tasks[i].counter == counter) {
+                take(queue.tasks, i);
+                return true;
+            }
+    }
+
+    // oldest first from everyone else's, those tend to be the biggest pieces of work left
+    for (size_t i = 1; i < queues_.size(); i++) {
+        auto& queue = *queues_[(self + i) % queues_.size()];
+        std::lock_guard<std::mutex> lock(queue.mutex);
+        for (size_t j = 0; j < queue.tasks.size(); j++)
+            if (!counter || queue.tasks[j].counter == counter) {
+                take(queue.tasks, j);
+                return true;
+            }
+    }
+
+    if (counter)
+        return false;
+
+    std::lock_guard<std::mutex> lock(background_.mutex);
+    if (background_.tasks.empty())
+        return false;
+
+    task = std::move(background_.tasks.front());
+    background_.tasks.pop_front();
+    backgroundQueued_--;
+    return true;
+}
+
+void Utilities::JobSystem::run_(Task& task) {
+    try {
+        PROFILE_SCOPE("Job");
+        task.job();
+    } catch (...) {
+        finish_(task.counter, std::current_exception());
+        return;
+    }
+
+    finish_(task.counter, nullptr);
+}
+
+void Utilities::JobSystem::finish_(Counter* counter, std::exception_ptr exception) {
+    if (!counter)
+        return;
+
+    // a waiter may destroy the counter as soon as the lock is released, so nothing touches it after
+    std::vector<Counter::Continuation> ready;
+    auto done = false;
+    {
+        std::lock_guard<std::mutex> lock(counter->mutex_);
+        if (exception && !counter->exception_)
+            counter->exception_ = exception;
+
+        done = --counter->pending_ == 0;
+        if (done)
+            ready.swap(counter->continuations_);
+    }
+
+    for (auto& continuation : ready)
+        push_({std::move(continuation.job), continuation.counter}, false);
+
+    // whoever waits on the counter may be asleep
+    if (done)
+        wake_(false, true);
+}
+
+void Utilities::JobSystem::wake_(bool worker, bool waiters) {
+    if ((!worker || idleWorkers_ == 0) && (!waiters || waiters_ == 0))
+        return;
+
+    // waiters sleep until their own counter has work or finishes, any of them may be the one this is for
+    std::lock_guard<std::mutex> lock(sleepMutex_);
+    if (worker)
+        workCondition_.notify_one();
+    if (waiters)
+        waitCondition_.notify_all();
+}
+
+namespace {
+    const size_t readChunkSize = 512 * 1024;
+
+    // a request in flight, shared by its chunks
+    struct PendingRead {
+        PendingRead(Utilities::AsyncFileReader::Request request, std::shared_ptr<int> file) : request(std::move(request)), file(std::move(file)) {}
+
+        Utilities::AsyncFileReader::Request request;
+        std::shared_ptr<int> file;
+        uint32_t chunksLeft = 0;
+        size_t bytesRead = 0;
+        std::exception_ptr exception;
+    };
+
+    std::exception_ptr readError(const std::string& filename, int error) {
+        return std::make_exception_ptr(std::runtime_error("Failed to read " + filename + ": " + std::strerror(error) + "."));
+    }
+
+    #ifndef _WIN32
+        std::shared_ptr<int> openFile(const std::string& filename) {
+            auto file = open(filename.c_str(), O_RDONLY | O_CLOEXEC);
+            if (file < 0)
+                return nullptr;
+
+            return std::shared_ptr<int>(new int(file), [](int* file) {
+                close(*file);
+                delete file;
+            });
+        }
+    #endif
+
+    size_t blockingRead(const Utilities::AsyncFileReader::Request& request) {
+        auto destination = static_cast<char*>(request.destination);
+        size_t bytesRead = 0;
+
+        #ifdef _WIN32
+            std::ifstream file(request.filename, std::ios::binary);
+            if (!file.is_open())
+                throw std::runtime_error("Failed to open " + request.filename + ".");
+
+            file.seekg(request.offset);
+            file.read(destination, request.size);
+            bytesRead = static_cast<size_t>(file.gcount());
+        #else
+            auto file = openFile(request.filename);
+            if (!file)
+                throw std::runtime_error("Failed to open " + request.filename + ".");
+
+            while (bytesRead < request.size) {
+                auto result = pread(*file, destination + bytesRead, request.size - bytesRead, request.offset + bytesRead);
+                if (result < 0 && errno == EINTR)
+                    continue;
+                if (result < 0)
+                    std::rethrow_exception(readError(request.filename, errno));
+                if (result == 0)
+                    break;
+                bytesRead += result;
+            }
+        #endif
+
+        return bytesRead;
+    }
+}
+
+#ifdef __linux__
+    // see io_uring_setup(2), the submission and completion rings are shared with the kernel through three mappings
+    struct Utilities::AsyncFileReader::Ring {
+        struct Chunk {
+            PendingRead* read;
+            uint64_t offset;
+            iovec buffer;
+        };
+
+        int fd = -1;
+        void* rings = MAP_FAILED;
+        size_t ringsSize = 0;
+        void* completionRing = MAP_FAILED;
+        size_t completionRingSize = 0;
+        io_uring_sqe* entries = static_cast<io_uring_sqe*>(MAP_FAILED);
+        size_t entriesSize = 0;
+
+        uint32_t* submissionHead;
+        uint32_t* submissionTail;
+        uint32_t submissionMask;
+        uint32_t submissionEntries;
+        uint32_t* submissionArray;
+        uint32_t* completionHead;
+        uint32_t* completionTail;
+        uint32_t completionMask;
+        uint32_t completionEntries;
+        io_uring_cqe* completions;
+
+        // submitters and the completion thread share everything below, and the chunk and read counts
+        std::mutex mutex;
+        // the completion thread sleeps on it while nothing is in flight
+        std::condition_variable wake;
+        std::deque<Chunk*> backlog;
+        uint32_t inFlight = 0;
+        uint32_t unsubmitted = 0;
+        bool stopping = false;
+        // set once io_uring_enter fails for good, after which every chunk not yet with the kernel fails with it
+        std::exception_ptr broken;
+
+        ~Ring() {
+            if (entries != MAP_FAILED)
+                munmap(entries, entriesSize);
+            if (completionRing != MAP_FAILED && completionRing != rings)
+                munmap(completionRing, completionRingSize);
+            if (rings != MAP_FAILED)
+                munmap(rings, ringsSize);
+            if (fd >= 0)
+                close(fd);
+        }
+
+        bool create(uint32_t queueDepth) {
+            auto parameters = io_uring_params{};
+            fd = static_cast<int>(syscall(__NR_io_uring_setup, queueDepth, &parameters));
+            if (fd < 0)
+                return false;
+
+            ringsSize = parameters.sq_off.array + parameters.sq_entries * sizeof(uint32_t);
+            completionRingSize = parameters.cq_off.cqes + parameters.cq_entries * sizeof(io_uring_cqe);
+            auto singleMapping = (parameters.features & IORING_FEAT_SINGLE_MMAP) != 0;
+            if (singleMapping)
+                ringsSize = completionRingSize = std::max(ringsSize, completionRingSize);
+
+            rings = mmap(nullptr, ringsSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQ_RING);
+            if (rings == MAP_FAILED)
+                return false;
+
+            completionRing = singleMapping ? rings : mmap(nullptr, completionRingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_CQ_RING);
+            if (completionRing == MAP_FAILED)
+                return false;
+
+            entriesSize = parameters.sq_entries * sizeof(io_uring_sqe);
+            entries = static_cast<io_uring_sqe*>(mmap(nullptr, entriesSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQES));
+            if (entries == MAP_FAILED)
+                return false;
+
+            auto submission = static_cast<uint8_t*>(rings);
+            submissionHead = reinterpret_cast<uint32_t*>(submission + parameters.sq_off.head);
+            submissionTail = reinterpret_cast<uint32_t*>(submission + parameters.sq_off.tail);
+            submissionMask = *reinterpret_cast<uint32_t*>(submission + parameters.sq_off.ring_mask);
+            submissionEntries = parameters.sq_entries;
+            submissionArray = reinterpret_cast<uint32_t*>(submission + parameters.sq_off.array);
+
+            auto completion = static_cast<uint8_t*>(completionRing);
+            completionHead = reinterpret_cast<uint32_t*>(completion + parameters.cq_off.head);
+            completionTail = reinterpret_cast<uint32_t*>(completion + parameters.cq_off.tail);
+            completionMask = *reinterpret_cast<uint32_t*>(completion + parameters.cq_off.ring_mask);
+            completionEntries = parameters.cq_entries;
+            completions = reinterpret_cast<io_uring_cqe*>(completion + parameters.cq_off.cqes);
+
+            return true;
+        }
+
+        // with the lock held
+        bool push(Chunk* chunk) {
+            auto tail = *submissionTail;
+            if (inFlight >= completionEntries || tail - __atomic_load_n(submissionHead, __ATOMIC_ACQUIRE) >= submissionEntries)
+                return false;
+
+            auto index = tail & submissionMask;
+            auto& entry = entries[index];
+            memset(&entry, 0, sizeof(entry));
+            // readv rather than read, which needs a 5.6 kernel
+            entry.opcode = IORING_OP_READV;
+            entry.fd = *chunk->read->file;
+            entry.addr = reinterpret_cast<uint64_t>(&chunk->buffer);
+            entry.len = 1;
+            entry.off = chunk->offset;
+            entry.user_data = reinterpret_cast<uint64_t>(chunk);
+
+            submissionArray[index] = index;
+            __atomic_store_n(submissionTail, tail + 1, __ATOMIC_RELEASE);
+            inFlight++;
+            unsubmitted++;
+            return true;
+        }
+
+        // with the lock held, reads whose last chunk is done go to finished, for their callbacks to run without it
+        void finish(Chunk* chunk, std::vector<PendingRead*>& finished) {
+            auto read = chunk->read;
+            delete chunk;
+            if (--read->chunksLeft == 0)
+                finished.push_back(read);
+        }
+
+        void fail(Chunk* chunk, std::exception_ptr exception, std::vector<PendingRead*>& finished) {
+            if (!chunk->read->exception)
+                chunk->read->exception = exception;
+            finish(chunk, finished);
+        }
+
+        // with the lock held, queues what fits and hands the new entries to the kernel in one call
+        void flush(std::vector<PendingRead*>& finished) {
+            if (broken) {
+                breakRing(broken, finished);
+                return;
+            }
+
+            while (!backlog.empty() && push(backlog.front()))
+                backlog.pop_front();
+
+            while (unsubmitted > 0) {
+                auto submitted = syscall(__NR_io_uring_enter, fd, unsubmitted, 0, 0, nullptr, 0);
+                if (submitted < 0 && (errno == EINTR || errno == EAGAIN || errno == EBUSY))
+                    return;
+                if (submitted < 0) {
+                    breakRing(std::make_exception_ptr(std::runtime_error(std::string("Failed to submit reads: ") + std::strerror(errno) + ".")), finished);
+                    return;
+                }
+                unsubmitted -= static_cast<uint32_t>(submitted);
+            }
+        }
+
+        // with the lock held, fails every chunk the kernel has not taken; the ones it has still complete and
+        // write into their buffers, so they are left to be reaped
+        void breakRing(std::exception_ptr exception, std::vector<PendingRead*>& finished) {
+            if (!broken)
+                broken = exception;
+
+            // the kernel only reads the submission ring when entered, so untaken entries can be taken back
+            auto tail = *submissionTail;
+            for (auto i = tail - unsubmitted; i != tail; i++)
+                fail(reinterpret_cast<Chunk*>(entries[i & submissionMask].user_data), broken, finished);
+            __atomic_store_n(submissionTail, tail - unsubmitted, __ATOMIC_RELEASE);
+            inFlight -= unsubmitted;
+            unsubmitted = 0;
+
+            for (auto chunk : backlog)
+                fail(chunk, broken, finished);
+            backlog.clear();
+        }
+    };
+#else
+    struct Utilities::AsyncFileReader::Ring {};
+#endif
+
+Utilities::AsyncFileReader::AsyncFileReader(JobSystem& jobSystem, uint32_t queueDepth) : jobSystem_(jobSystem) {
+    #ifdef __linux__
+        // containers and hardened kernels may refuse io_uring, the blocking fallback still works there
+        auto ring = std::make_unique<Ring>();
+        if (ring->create(queueDepth)) {
+            ring_ = std::move(ring);
+            completionThread_ = std::thread(&AsyncFileReader::complete_, this);
+        }
+    #endif
+}
+
+Utilities::AsyncFileReader::~AsyncFileReader() {
+    #ifdef __linux__
+        if (ring_) {
+            {
+                std::lock_guard<std::mutex> lock(ring_->mutex);
+                ring_->stopping = true;
+            }
+            ring_->wake.notify_one();
+            completionThread_.join();
+        }
+    #endif
+
+    jobSystem_.wait(blockingReads_);
+}
+
+void Utilities::AsyncFileReader::submit(std::vector<Request> requests) {
+    if (!ring_) {
+        submitBlocking_(requests);
+        return;
+    }
+
+    #ifdef __linux__
+        auto broken = false;
+        {
+            std::lock_guard<std::mutex> lock(ring_->mutex);
+            broken = ring_->broken != nullptr;
+        }
+        if (broken) {
+            submitBlocking_(requests);
+            return;
+        }
+
+        std::unordered_map<std::string, std::shared_ptr<int>> files;
+        std::vector<Ring::Chunk*> chunks;
+
+        for (auto& request : requests) {
+            auto& file = files[request.filename];
+            if (!file)
+                file = openFile(request.filename);
+            if (!file) {
+                request.onComplete(0, std::make_exception_ptr(std::runtime_error("Failed to open " + request.filename + ".")));
+                continue;
+            }
+            if (request.size == 0) {
+                request.onComplete(0, nullptr);
+                continue;
+            }
+
+            auto read = new PendingRead(std::move(request), file);
+            read->chunksLeft = static_cast<uint32_t>((read->request.size + readChunkSize - 1) / readChunkSize);
+            for (size_t offset = 0; offset < read->request.size; offset += readChunkSize) {
+                auto size = std::min(readChunkSize, read->request.size - offset);
+                chunks.push_back(new Ring::Chunk{read, read->request.offset + offset, {static_cast<char*>(read->request.destination) + offset, size}});
+            }
+        }
+
+        // chunks the ring fails are counted off under the lock, their reads complete outside it
+        std::vector<PendingRead*> finished;
+        {
+            std::lock_guard<std::mutex> lock(ring_->mutex);
+            ring_->backlog.insert(ring_->backlog.end(), chunks.begin(), chunks.end());
+            ring_->flush(finished);
+        }
+        ring_->wake.notify_one();
+
+        for (auto read : finished) {
+            read->request.onComplete(read->bytesRead, read->exception);
+            delete read;
+        }
+    #endif
+}
+
+void Utilities::AsyncFileReader::submitBlocking_(std::vector<Request>& requests) {
+    for (auto& request : requests)
+        jobSystem_.submitBackground([request = std::move(request)] {
+            auto bytesRead = size_t(0);
+            auto exception = std::exception_ptr{};
+            try {
+                bytesRead = blockingRead(request);
+            } catch (...) {
+                exception = std::current_exception();
+            }
+            request.onComplete(bytesRead, exception);
+        }, &blockingReads_);
+}
+
+void Utilities::AsyncFileReader::complete_() {
+    PROFILE_THREAD("File reader");
+    #ifdef __linux__
+        auto& ring = *ring_;
+        std::vector<PendingRead*> finished;
+
+        while (true) {
+            auto waitForKernel = false;
+            {
+                std::unique_lock<std::mutex> lock(ring.mutex);
+                ring.wake.wait(lock, [&] { return ring.stopping || ring.inFlight > 0; });
+                if (ring.stopping && ring.inFlight == 0)
+                    return;
+                // entries the kernel has not taken yet would never complete, those are retried by the flush below
+                waitForKernel = !ring.broken && ring.inFlight > ring.unsubmitted;
+            }
+
+            auto waitError = std::exception_ptr{};
+            if (!waitForKernel)
+                std::this_thread::sleep_for(std::chrono::milliseconds(1));
+            else if (syscall(__NR_io_uring_enter, ring.fd, 0, 1, IORING_ENTER_GETEVENTS, nullptr, 0) < 0 && errno != EINTR)
+                waitError = std::make_exception_ptr(std::runtime_error(std::string("Failed to wait for reads: ") + std::strerror(errno) + "."));
+
+            {
+                std::lock_guard<std::mutex> lock(ring.mutex);
+                // completions are still posted to the shared ring, a broken ring is polled for them instead
+                if (waitError)
+                    ring.breakRing(waitError, finished);
+
+                auto head = *ring.completionHead;
+                auto tail = __atomic_load_n(ring.completionTail, __ATOMIC_ACQUIRE);
+                ring.inFlight -= tail - head;
+
+                for (; head != tail; head++) {
+                    const auto& completion = ring.completions[head & ring.completionMask];
+                    auto chunk = reinterpret_cast<Ring::Chunk*>(completion.user_data);
+                    auto read = chunk->read;
+                    auto result = completion.res;
+                    if (result == -EINTR || result == -EAGAIN) {
+                        ring.backlog.push_back(chunk);
+                        continue;
+                    }
+
+                    if (result < 0 && !read->exception)
+                        read->exception = readError(read->request.filename, -result);
+
+                    // a short read is either the end of the file, which the retry confirms by reading nothing, or the kernel
+                    // stopping early, so the rest goes back in
+                    if (result > 0) {
+                        read->bytesRead += result;
+                        chunk->offset += result;
+                        chunk->buffer.iov_base = static_cast<char*>(chunk->buffer.iov_base) + result;
+                        chunk->buffer.iov_len -= result;
+                        if (chunk->buffer.iov_len > 0) {
+                            ring.backlog.push_back(chunk);
+                            continue;
+                        }
+                    }
+
+                    ring.finish(chunk, finished);
+                }
+                __atomic_store_n(ring.completionHead, tail, __ATOMIC_RELEASE);
+
+                ring.flush(finished);
+            }
+
+            // callbacks run without the lock, they may well submit more reads
+            for (auto read : finished) {
+                read->request.onComplete(read->bytesRead, read->exception);
+                delete read;
+            }
+            finished.clear();
+        }
+    #endif
+}
+
+std::future<size_t> Utilities::AsyncFileReader::read(const std::string& filename, uint64_t offset, size_t size, void* destination) {
+    auto promise = std::make_shared<std::promise<size_t>>();
+    auto future = promise->get_future();
+
+    submit({{filename, offset, size, destination, [promise](size_t bytesRead, std::exception_ptr exception) {
+        if (exception)
+            promise->set_exception(exception);
+        else
+            promise->set_value(bytesRead);
+    }}});
+
+    return future;
+}
+
+std::future<std::vector<char>> Utilities::AsyncFileReader::readFile(const std::string& filename) {
+    auto promise = std::make_shared<std::promise<std::vector<char>>>();
+    auto future = promise->get_future();
+
+    std::error_code error;
+    auto size = std::filesystem::file_size(filename, error);
+    if (error) {
+        promise->set_exception(std::make_exception_ptr(std::runtime_error("Failed to open " + filename + ".")));
+        return future;
+    }
+
+    auto buffer = std::make_shared<std::vector<char>>(size);
+    submit({{filename, 0, buffer->size(), buffer->data(), [promise, buffer](size_t bytesRead, std::exception_ptr exception) {
+        if (exception) {
+            promise->set_exception(exception);
+            return;
+        }
+
+        buffer->resize(bytesRead);
+        promise->set_value(std::move(*buffer));
+    }}});
+
+    return future;
+}
+
 Utilities::FileWatcher::FileWatcher(
-    const std::vector<std::string>& filenames,
-    std::function<void(const std::string&)> onChangedCallback
+    const std::vector<std::string>& paths,
+    Callback onChangedCallback,
+    std::chrono::milliseconds debounce
 ) {
-    filenames_ = filenames;
-    
-    for (const auto& filename : filenames)
-        lastModifiedTimes_[filename] = std::filesystem::last_write_time(filename);
+    for (const auto& path : paths) {
+        auto normalPath = std::filesystem::path(path).lexically_normal();
+        paths_.push_back(normalPath);
+
+        if (!std::filesystem::is_directory(normalPath))
+            files_.insert(normalPath.generic_string());
+    }
 
     onChangedCallback_ = onChangedCallback;
+    debounce_ = debounce;
+
+    #ifdef __linux__
+        inotifyFd_ = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+        wakeFd_ = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+        if (inotifyFd_ < 0 || wakeFd_ < 0)
+            throw std::runtime_error("Failed to initialize inotify.");
+
+        // files are watched through their directory, editors often replace a file instead of writing it in place
+        for (const auto& path : paths_)
+            if (std::filesystem::is_directory(path))
+                addDirectoryWatch_(path, true, nullptr);
+            else
+                addDirectoryWatch_(path.has_parent_path() ? path.parent_path() : ".", false, nullptr);
+    #else
+        lastModifiedTimes_ = scan_();
+    #endif
 }
 
 Utilities::FileWatcher::~FileWatcher() {
     stop();
-    watchingThread_.join();
+
+    #ifdef __linux__
+        close(inotifyFd_);
+        close(wakeFd_);
+    #endif
 }
 
 void Utilities::FileWatcher::start() {
-    watching_ = true;
-    watchingThread_ = std::thread(&watch_, this);
+    if (watching_.exchange(true))
+        return;
+
+    watchingThread_ = std::thread(&FileWatcher::watch_, this);
 }
 
 void Utilities::FileWatcher::stop() {
-    watching_ = false;
+    if (!watching_.exchange(false))
+        return;
+
+    #ifdef __linux__
+        uint64_t wake = 1;
+        write(wakeFd_, &wake, sizeof(wake));
+    #else
+        {
+            std::lock_guard<std::mutex> lock(stopMutex_);
+        }
+        stopCondition_.notify_all();
+    #endif
+
+    if (watchingThread_.joinable())
+        watchingThread_.join();
+}
+
+bool Utilities::FileWatcher::isWatched_(const std::filesystem::path& path) const {
+    if (files_.count(path.generic_string()))
+        return true;
+
+    #ifdef __linux__
+        for (auto parent = path.parent_path(); !parent.empty(); parent = parent.parent_path()) {
+            if (recursiveDirectories_.count(parent.generic_string()))
+                return true;
+
+            if (parent == parent.parent_path())
+                break;
+        }
+
+        return false;
+    #else
+        // the polling scan only ever visits watched paths
+        return true;
+    #endif
+}
+
+#ifdef __linux__
+
+void Utilities::FileWatcher::addDirectoryWatch_(const std::filesystem::path& directory, bool recursive, std::unordered_set<std::string>* createdFiles) {
+    const uint32_t mask = IN_CLOSE_WRITE | IN_MOVED_TO | IN_MOVED_FROM | IN_CREATE | IN_DELETE | IN_ONLYDIR;
+
+    auto watchDescriptor = inotify_add_watch(inotifyFd_, directory.c_str(), mask);
+    if (watchDescriptor < 0)
+        throw std::runtime_error("Failed to watch " + directory.string() + ".");
+
+    // a directory can be both watched for a single file and recursively, recursive wins
+    auto& watch = directoryWatches_[watchDescriptor];
+    watch.path = directory;
+    watch.recursive = watch.recursive || recursive;
+
+    if (!recursive)
+        return;
+
+    recursiveDirectories_.insert(directory.generic_string());
+
+    for (const auto& entry : std::filesystem::directory_iterator(directory)) {
+        auto entryPath = entry.path().lexically_normal();
+
+        if (entry.is_directory())
+            addDirectoryWatch_(entryPath, true, createdFiles);
+        else if (createdFiles)
+            createdFiles->insert(entryPath.generic_string());
+    }
 }
 
 void Utilities::FileWatcher::watch_() {
+    using Clock = std::chrono::steady_clock;
+
+    std::unordered_set<std::string> changes;
+    auto lastChange = Clock::now();
+
+    alignas(inotify_event) char buffer[16 * 1024];
+    PROFILE_THREAD("File watcher");
+
     while (watching_) {
-        for (const auto& filename : filenames_) {
-            auto currentModifiedTime = std::filesystem::last_write_time(filename);
-            if (lastModifiedTimes_[filename] != currentModifiedTime) {
-                lastModifiedTimes_[filename] = currentModifiedTime;
-                onChangedCallback_(filename);
+        auto timeout = -1;
+        if (!changes.empty()) {
+            auto quiet = std::chrono::duration_cast<std::chrono::milliseconds>(Clock::now() - lastChange);
+            timeout = std::max<int>(0, (debounce_ - quiet).count());
+        }
+
+        pollfd fds[] = {
+            {inotifyFd_, POLLIN, 0},
+            {wakeFd_, POLLIN, 0},
+        };
+
+        if (poll(fds, 2, timeout) < 0 && errno != EINTR)
+            break;
+
+        if (fds[1].revents & POLLIN)
+            break;
+
+        if (fds[0].revents & POLLIN) {
+            PROFILE_SCOPE("FileWatcher::readEvents");
+            ssize_t length;
+            while ((length = read(inotifyFd_, buffer, sizeof(buffer))) > 0) {
+                for (auto offset = 0; offset < length; ) {
+                    auto event = reinterpret_cast<const inotify_event*>(buffer + offset);
+                    offset += sizeof(inotify_event) + event->len;
+
+                    if (event->mask & IN_IGNORED) {
+                        directoryWatches_.erase(event->wd);
+                        continue;
+                    }
+
+                    auto watch = directoryWatches_.find(event->wd);
+                    if (watch == directoryWatches_.end() || event->len == 0)
+                        continue;
+
+                    auto path = (watch->second.path / event->name).lexically_normal();
+
+                    // new directories need their own watch, and anything written into them before it existed
+                    if ((event->mask & IN_ISDIR) && (event->mask & (IN_CREATE | IN_MOVED_TO)) && watch->second.recursive) {
+                        try {
+                            addDirectoryWatch_(path, true, &changes);
+                        }
+                        catch (const std::exception&) {
+                            // removed again before it could be watched
+                        }
+                        lastChange = Clock::now();
+                        continue;
+                    }
+
+                    if (event->mask & IN_ISDIR)
+                        continue;
+
+                    if (isWatched_(path)) {
+                        changes.insert(path.generic_string());
+                        lastChange = Clock::now();
+                    }
+                }
+            }
+        }
+
+        if (!changes.empty() && Clock::now() - lastChange >= debounce_) {
+            PROFILE_SCOPE("FileWatcher::onChanged");
+            onChangedCallback_(std::vector<std::string>(changes.begin(), changes.end()));
+            changes.clear();
+        }
+    }
+}
+
+#else
+
+std::unordered_map<std::string, std::filesystem::file_time_type> Utilities::FileWatcher::scan_() const {
+    std::unordered_map<std::string, std::filesystem::file_time_type> modifiedTimes;
+    std::error_code error;
+
+    for (const auto& path : paths_) {
+        if (std::filesystem::is_directory(path)) {
+            for (const auto& entry : std::filesystem::recursive_directory_iterator(path, error))
+                if (entry.is_regular_file(error))
+                    modifiedTimes[entry.path().lexically_normal().generic_string()] = entry.last_write_time(error);
+        }
+        else if (std::filesystem::exists(path, error))
+            modifiedTimes[path.generic_string()] = std::filesystem::last_write_time(path, error);
+    }
+
+    return modifiedTimes;
+}
+
+void Utilities::FileWatcher::watch_() {
+    const auto pollInterval = std::chrono::milliseconds(250);
+    PROFILE_THREAD("File watcher");
+
+    std::unordered_set<std::string> changes;
+
+    while (watching_) {
+        {
+            std::unique_lock<std::mutex> lock(stopMutex_);
+            stopCondition_.wait_for(lock, changes.empty() ? pollInterval : debounce_, [this] { return !watching_; });
+        }
+
+        if (!watching_)
+            break;
+
+        PROFILE_SCOPE("FileWatcher::scan");
+        auto modifiedTimes = scan_();
+        auto changedThisScan = false;
+
+        for (const auto& [filename, modifiedTime] : modifiedTimes) {
+            auto previous = lastModifiedTimes_.find(filename);
+            if (previous == lastModifiedTimes_.end() || previous->second != modifiedTime) {
+                changes.insert(filename);
+                changedThisScan = true;
             }
         }
 
-        std::this_thread::sleep_for(std::chrono::seconds(1));
+        for (const auto& [filename, modifiedTime] : lastModifiedTimes_)
+            if (!modifiedTimes.count(filename)) {
+                changes.insert(filename);
+                changedThisScan = true;
+            }
+
+        lastModifiedTimes_ = std::move(modifiedTimes);
+
+        // deliver once a scan a debounce window later saw nothing new
+        if (!changes.empty() && !changedThisScan) {
+            PROFILE_SCOPE("FileWatcher::onChanged");
+            onChangedCallback_(std::vector<std::string>(changes.begin(), changes.end()));
+            changes.clear();
+        }
     }
-}
\ No newline at end of file
+}
+
+#endif
\ No newline at end of file
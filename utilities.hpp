@@ -3,18 +3,205 @@
 #include <string>
 #include <vector>
 #include <unordered_map>
+#include <unordered_set>
+#include <atomic>
+#include <mutex>
+#include <condition_variable>
 #include <chrono>
 #include <filesystem>
 #include <thread>
 #include <functional>
+#include <exception>
+#include <deque>
+#include <memory>
+#include <future>
 
 namespace Utilities {
     std::vector<char> readFile(const std::string& filename);
 
+    // 64-bit FNV-1a, pass a previous result as seed to hash several buffers as one
+    uint64_t hashBytes(const void* data, size_t size, uint64_t seed = 14695981039346656037ull);
+
+    // LZ4 block format, without the frame around it; decompression needs the exact decompressed size and
+    // returns false on malformed input instead of reading or writing out of bounds
+    std::vector<uint8_t> lz4Compress(const void* data, size_t size);
+    bool lz4Decompress(const void* data, size_t size, void* destination, size_t destinationSize);
+
+    // work-stealing scheduler shared by every subsystem: each worker owns a deque, taking its own newest jobs
+    // and stealing the oldest from the others when it runs dry; threads outside the pool submit to a shared deque.
+    // a wait only helps with the jobs of its own counter, and background jobs are left to idle workers alone,
+    // so neither a frame nor a simulation tick ends up running someone else's long job
+    class JobSystem {
+    public:
+
+        using Job = std::function<void()>;
+
+        // unfinished jobs submitted against it, jobs submitted after it start once it reaches zero;
+        // keeps the first exception its jobs throw for wait, reuse it only after waiting on it
+        class Counter {
+        public:
+
+            bool isDone() const { return pending_.load() == 0; }
+
+        private:
+
+            friend class JobSystem;
+
+            struct Continuation {
+                Job job;
+                Counter* counter;
+            };
+
+            std::atomic<uint32_t> pending_ = 0;
+            // its jobs sitting in a deque, which its waiters may take
+            std::atomic<uint32_t> queued_ = 0;
+            std::mutex mutex_;
+            std::vector<Continuation> continuations_;
+            std::exception_ptr exception_;
+        };
+
+        // 0 picks one worker per hardware thread besides the main one
+        JobSystem(uint32_t workerCount = 0);
+        ~JobSystem();
+
+        // workers plus the calling thread
+        uint32_t threadCount() const { return static_cast<uint32_t>(workers_.size()) + 1; }
+
+        void submit(Job job, Counter* counter = nullptr);
+        void submitAfter(Counter& dependency, Job job, Counter* counter = nullptr);
+        // for long work off the critical path, such as hot reloads and streaming, run once workers have nothing else
+        void submitBackground(Job job, Counter* counter = nullptr);
+        // for work that must stay on the main thread, run only when it calls runMainThreadJobs
+        void submitToMainThread(Job job, Counter* counter = nullptr);
+        void runMainThreadJobs();
+
+        // runs the counter's own jobs until it reaches zero, rethrowing the first exception of its jobs;
+        // its background jobs are only waited for
+        void wait(Counter& counter);
+
+        // runs task(i) for every i below count and returns once all are done, rethrowing the first exception
+        void parallelFor(uint32_t count, const std::function<void(uint32_t)>& task);
+
+    private:
+
+        struct Task {
+            Job job;
+            Counter* counter;
+        };
+
+        // index 0 is shared by every thread outside the pool, index i + 1 belongs to worker i
+        struct alignas(64) Queue {
+            std::mutex mutex;
+            std::deque<Task> tasks;
+        };
+        std::vector<std::unique_ptr<Queue>> queues_;
+        std::vector<std::thread> workers_;
+        std::atomic<uint32_t> queued_ = 0;
+        Queue background_;
+        std::atomic<uint32_t> backgroundQueued_ = 0;
+
+        std::mutex mainMutex_;
+        std::deque<Task> mainTasks_;
+
+        // idle workers and blocked waiters
+        std::mutex sleepMutex_;
+        std::condition_variable workCondition_;
+        std::condition_variable waitCondition_;
+        std::atomic<uint32_t> idleWorkers_ = 0;
+        std::atomic<uint32_t> waiters_ = 0;
+        bool stopping_ = false;
+
+        void work_(uint32_t queue);
+        void push_(Task task, bool background);
+        // any job when counter is null, otherwise only the counter's jobs outside the background deque
+        bool pop_(Task& task, const Counter* counter);
+        void run_(Task& task);
+        void finish_(Counter* counter, std::exception_ptr exception);
+        void wake_(bool worker, bool waiters);
+    };
+
+    // hands the newest value from one writer thread to one reader thread without either ever waiting;
+    // the writer fills its slot and publishes it, the reader swaps in the newest published slot when it wants one
+    template <typename T>
+    class TripleBuffer {
+    public:
+
+        TripleBuffer(const T& initial = T{}) : slots_{initial, initial, initial} {}
+
+        // writer side, holds stale contents from an earlier publish, so overwrite it whole
+        T& writeSlot() { return slots_[back_]; }
+        void publish() { back_ = middle_.exchange(back_ | fresh_, std::memory_order_acq_rel) & index_; }
+
+        // reader side, returns false and keeps the current value when nothing was published since the last call
+        bool update() {
+            if ((middle_.load(std::memory_order_relaxed) & fresh_) == 0)
+                return false;
+            front_ = middle_.exchange(front_, std::memory_order_acq_rel) & index_;
+            return true;
+        }
+        const T& read() const { return slots_[front_]; }
+
+    private:
+
+        static constexpr uint32_t index_ = 3;
+        static constexpr uint32_t fresh_ = 4;
+
+        T slots_[3];
+        // each side's index on its own cache line, the shared one is the only contended word
+        alignas(64) uint32_t back_ = 0;
+        alignas(64) std::atomic<uint32_t> middle_ = 1;
+        alignas(64) uint32_t front_ = 2;
+    };
+
+    // reads files into memory the caller owns, such as mapped staging buffers, without blocking the caller;
+    // uses io_uring on linux, with large reads split so the drive sees many at once, and falls back to
+    // blocking reads on the job system elsewhere, when the kernel refuses io_uring, or once it fails later on
+    class AsyncFileReader {
+    public:
+
+        struct Request {
+            std::string filename;
+            uint64_t offset = 0;
+            // stops early at the end of the file, destination must stay valid until onComplete
+            size_t size = 0;
+            void* destination = nullptr;
+            // the bytes read or why the read failed, called on the reader's thread or a job, so keep it short
+            std::function<void(size_t, std::exception_ptr)> onComplete;
+        };
+
+        AsyncFileReader(JobSystem& jobSystem, uint32_t queueDepth = 128);
+        // waits for every read in flight
+        ~AsyncFileReader();
+
+        // queues the reads with a single submission, each file opened once however many reads it has
+        void submit(std::vector<Request> requests);
+        std::future<size_t> read(const std::string& filename, uint64_t offset, size_t size, void* destination);
+        std::future<std::vector<char>> readFile(const std::string& filename);
+
+        bool usesIoUring() const { return ring_ != nullptr; }
+
+    private:
+
+        JobSystem& jobSystem_;
+        JobSystem::Counter blockingReads_;
+
+        // the io_uring state, null when falling back
+        struct Ring;
+        std::unique_ptr<Ring> ring_;
+        std::thread completionThread_;
+        void complete_();
+        void submitBlocking_(std::vector<Request>& requests);
+    };
+
+    // watches files and directories (recursively) and reports changes in batches, once no new change
+    // arrived for the debounce window, so bursts such as an editor's save-and-rename arrive as one set;
+    // uses inotify on linux and falls back to polling modification times elsewhere
     class FileWatcher {
     public:
 
-        FileWatcher(const std::vector<std::string>& filenames, std::function<void(const std::string&)> onChangedCallback);
+        using Callback = std::function<void(const std::vector<std::string>&)>;
+
+        FileWatcher(const std::vector<std::string>& paths, Callback onChangedCallback, std::chrono::milliseconds debounce = std::chrono::milliseconds(50));
         ~FileWatcher();
 
         void start();
@@ -23,12 +210,33 @@ namespace Utilities {
     private:
         
         std::thread watchingThread_;
-        bool watching_;
+        std::atomic<bool> watching_ = false;
         void watch_();
 
-        std::vector<std::string> filenames_;
-        std::unordered_map<std::string, std::filesystem::file_time_type> lastModifiedTimes_;
+        std::vector<std::filesystem::path> paths_;
+        std::chrono::milliseconds debounce_;
+        Callback onChangedCallback_;
+
+        // files given directly rather than through a watched directory
+        std::unordered_set<std::string> files_;
+        bool isWatched_(const std::filesystem::path& path) const;
+
+        #ifdef __linux__
+            int inotifyFd_ = -1;
+            int wakeFd_ = -1;
 
-        std::function<void(const std::string&)> onChangedCallback_;
+            struct DirectoryWatch {
+                std::filesystem::path path;
+                bool recursive;
+            };
+            std::unordered_map<int, DirectoryWatch> directoryWatches_;
+            std::unordered_set<std::string> recursiveDirectories_;
+            void addDirectoryWatch_(const std::filesystem::path& directory, bool recursive, std::unordered_set<std::string>* createdFiles);
+        #else
+            std::mutex stopMutex_;
+            std::condition_variable stopCondition_;
+            std::unordered_map<std::string, std::filesystem::file_time_type> lastModifiedTimes_;
+            std::unordered_map<std::string, std::filesystem::file_time_type> scan_() const;
+        #endif
     };
 }
\ No newline at end of file
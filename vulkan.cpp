@@ -1,5 +1,8 @@
 #include "vulkan.hpp"
+#include "utilities.hpp"
 #include <iostream>
+#include <fstream>
+#include <filesystem>
 #include <cstring>
 #include <set>
 
@@ -67,6 +70,120 @@ bool Vulkan::deviceSupportsExtensions(const VkPhysicalDevice physicalDevice, std
     return requiredExtensions.empty();
 }
 
+namespace {
+    // prepended to the driver's data since its own header has no driver version
+    struct PipelineCacheFileHeader {
+        uint32_t magic;
+        uint32_t vendorID;
+        uint32_t deviceID;
+        uint32_t driverVersion;
+        uint8_t pipelineCacheUUID[VK_UUID_SIZE];
+        uint64_t dataSize;
+    };
+
+    const uint32_t pipelineCacheMagic = 0x43505646; // "FVPC"
+}
+
+std::vector<char> Vulkan::parsePipelineCacheData(const VkPhysicalDevice physicalDevice, const std::vector<char>& file) {
+    if (file.size() < sizeof(PipelineCacheFileHeader))
+        return {};
+
+    PipelineCacheFileHeader header;
+    memcpy(&header, file.data(), sizeof(header));
+
+    VkPhysicalDeviceProperties properties;
+    vkGetPhysicalDeviceProperties(physicalDevice, &properties);
+
+    if (header.magic != pipelineCacheMagic ||
+        header.vendorID != properties.vendorID ||
+        header.deviceID != properties.deviceID ||
+        header.driverVersion != properties.driverVersion ||
+        memcmp(header.pipelineCacheUUID, properties.pipelineCacheUUID, VK_UUID_SIZE) != 0 ||
+        header.dataSize != file.size() - sizeof(header))
+        return {};
+
+    // drivers validate their own header too, but a truncated one is not worth handing over
+    VkPipelineCacheHeaderVersionOne driverHeader;
+    if (header.dataSize < sizeof(driverHeader))
+        return {};
+
+    memcpy(&driverHeader, file.data() + sizeof(header), sizeof(driverHeader));
+    if (driverHeader.headerVersion != VK_PIPELINE_CACHE_HEADER_VERSION_ONE ||
+        driverHeader.vendorID != properties.vendorID ||
+        driverHeader.deviceID != properties.deviceID ||
+        memcmp(driverHeader.pipelineCacheUUID, properties.pipelineCacheUUID, VK_UUID_SIZE) != 0)
+        return {};
+
+    return std::vector<char>(file.begin() + sizeof(header), file.end());
+}
+
+void Vulkan::savePipelineCacheData(const VkPhysicalDevice physicalDevice, VkDevice device, VkPipelineCache pipelineCache, const std::string& filename) {
+    size_t dataSize;
+    if (vkGetPipelineCacheData(device, pipelineCache, &dataSize, nullptr) != VK_SUCCESS)
+        throw std::runtime_error("Failed to get pipeline cache data size.");
+
+    std::vector<char> data(dataSize);
+    if (vkGetPipelineCacheData(device, pipelineCache, &dataSize, data.data()) != VK_SUCCESS)
+        throw std::runtime_error("Failed to get pipeline cache data.");
+
+    VkPhysicalDeviceProperties properties;
+    vkGetPhysicalDeviceProperties(physicalDevice, &properties);
+
+    auto header = PipelineCacheFileHeader{};
+    header.magic = pipelineCacheMagic;
+    header.vendorID = properties.vendorID;
+    header.deviceID = properties.deviceID;
+    header.driverVersion = properties.driverVersion;
+    memcpy(header.pipelineCacheUUID, properties.pipelineCacheUUID, VK_UUID_SIZE);
+    header.dataSize = dataSize;
+
+    auto path = std::filesystem::path(filename);
+    if (path.has_parent_path())
+        std::filesystem::create_directories(path.parent_path());
+
+    // write next to the target and rename, so a crash mid-write never leaves a corrupt cache behind
+    auto temporaryPath = path;
+    temporaryPath += ".tmp";
+
+    {
+        std::ofstream file(temporaryPath, std::ios::binary | std::ios::trunc);
+        if (!file.is_open())
+            throw std::runtime_error("Failed to open " + temporaryPath.string() + " for writing.");
+
+        file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+        file.write(data.data(), dataSize);
+    }
+
+    std::filesystem::rename(temporaryPath, path);
+}
+
+namespace {
+    const std::pair<const char*, VkPresentModeKHR> presentModeNames[] = {
+        {"fifo", VK_PRESENT_MODE_FIFO_KHR},
+        {"fifo-relaxed", VK_PRESENT_MODE_FIFO_RELAXED_KHR},
+        {"mailbox", VK_PRESENT_MODE_MAILBOX_KHR},
+        {"immediate", VK_PRESENT_MODE_IMMEDIATE_KHR},
+    };
+}
+
+bool Vulkan::parsePresentMode(const std::string& name, VkPresentModeKHR& presentMode) {
+    for (const auto& [modeName, mode] : presentModeNames)
+        if (name == modeName) {
+            presentMode = mode;
+            return true;
+        }
+
+    return false;
+}
+
+std::string Vulkan::presentModeName(VkPresentModeKHR presentMode) {
+    for (const auto& [modeName, mode] : presentModeNames)
+        if (mode == presentMode)
+            return modeName;
+
+    return std::to_string(presentMode);
+}
+
 VkResult Vulkan::createDebugMessengerExtension(
     VkInstance instance,
     const VkDebugUtilsMessengerCreateInfoEXT* debugMessengerInfo,
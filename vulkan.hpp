@@ -1,6 +1,7 @@
 #pragma once
 
 #include <vector>
+#include <string>
 #include <vulkan/vulkan.h>
 
 // TODO: regroup functions under multiple files
@@ -11,6 +12,15 @@ namespace Vulkan {
     bool instanceSupportsExtensions(const std::vector<const char*> extensionNames);
     bool deviceSupportsExtensions(const VkPhysicalDevice device, std::vector<const char*> extensionNames);
 
+    // returns the cache data in the contents of a file savePipelineCacheData wrote, or nothing if it is
+    // empty or was written by another device or driver
+    std::vector<char> parsePipelineCacheData(const VkPhysicalDevice physicalDevice, const std::vector<char>& file);
+    void savePipelineCacheData(const VkPhysicalDevice physicalDevice, VkDevice device, VkPipelineCache pipelineCache, const std::string& filename);
+
+    // lowercase names as given on the command line: fifo, fifo-relaxed, mailbox, immediate
+    bool parsePresentMode(const std::string& name, VkPresentModeKHR& presentMode);
+    std::string presentModeName(VkPresentModeKHR presentMode);
+
     VkResult createDebugMessengerExtension(VkInstance instance, const VkDebugUtilsMessengerCreateInfoEXT* debugMessengerInfo, const VkAllocationCallbacks* allocator, VkDebugUtilsMessengerEXT* debugMessenger);
     void destroyDebugMessengerExtension(VkInstance instance, VkDebugUtilsMessengerEXT debugMessenger, const VkAllocationCallbacks*allocator);
 }
\ No newline at end of file